@@ -36,6 +36,8 @@
 #include <rclcpp/node_options.hpp>
 #include <rclcpp/time.hpp>
 
+#include <chrono>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -47,6 +49,11 @@
 #include "akit/failover/foros/cluster_node_publisher.hpp"
 #include "akit/failover/foros/cluster_node_service.hpp"
 #include "akit/failover/foros/command.hpp"
+#include "akit/failover/foros/command_commit_awaitable.hpp"
+#include "akit/failover/foros/command_serialization.hpp"
+#include "akit/failover/foros/kv_response.hpp"
+#include "akit/failover/foros/kv_watch.hpp"
+#include "akit/failover/foros/commit_completion_queue.hpp"
 #include "akit/failover/foros/common.hpp"
 
 
@@ -1198,6 +1205,8 @@ class ClusterNode : public std::enable_shared_from_this<ClusterNode>,
 
   /// Commit a command to cluster.
   /**
+   * The commit fails on a follower unless commit forwarding is enabled in
+   * the options, in which case the command is relayed to the leader.
    * \param[in] command A command to commit.
    * \param[in] callback The callback to receive the commit response.
    * \return Shared future of commit response.
@@ -1206,6 +1215,94 @@ class ClusterNode : public std::enable_shared_from_this<ClusterNode>,
   CommandCommitResponseSharedFuture commit_command(
       Command::SharedPtr command, CommandCommitResponseCallback callback);
 
+  /// Commit a command to cluster with a completion queue.
+  /**
+   * The completion is pushed to the queue with the tag once the command is
+   * committed or failed, instead of completing a future.
+   * \param[in] command A command to commit.
+   * \param[in] tag A tag to identify the completion.
+   * \param[in] completion_queue The queue to push the completion.
+   */
+  CLUSTER_NODE_PUBLIC
+  void commit_command(Command::SharedPtr command, uint64_t tag,
+                      CommitCompletionQueue::SharedPtr completion_queue);
+
+  /// Commit commands to cluster at once.
+  /**
+   * The commands get consecutive IDs and are replicated in one round, so they
+   * are committed or failed together.
+   * \param[in] commands Commands to commit.
+   * \param[in] callback The callback to receive each commit response.
+   * \return Shared futures of commit responses in the order of commands.
+   */
+  CLUSTER_NODE_PUBLIC
+  std::vector<CommandCommitResponseSharedFuture> commit_commands(
+      const std::vector<Command::SharedPtr> &commands,
+      CommandCommitResponseCallback callback);
+
+  /// Create an ID of a client session.
+  /**
+   * \return A random ID to commit commands of a new session.
+   */
+  CLUSTER_NODE_PUBLIC
+  uint64_t create_session_id();
+
+  /// Commit a command of a client session to cluster.
+  /**
+   * Sequences of a session should increase for each new command, and a
+   * retry should use the same sequence.
+   * A sequence already committed is not committed again, and the response
+   * has the ID of the command which committed it. A sequence older than the
+   * latest committed one of the session fails, since its command is not
+   * known anymore. If a retry is committed again anyway, e.g. across a
+   * change of the leader, the duplicate is not passed to the commit
+   * callbacks.
+   * The session and the sequence are kept in the command, not in its data.
+   * The sequences of the sessions are included in the key-value store
+   * snapshots, or rebuilt from the commands loaded on restart otherwise.
+   * \param[in] session_id ID of the session.
+   * \param[in] sequence Sequence of the command in the session.
+   * \param[in] command A command to commit.
+   * \param[in] callback The callback to receive the commit response.
+   * \return Shared future of commit response.
+   */
+  CLUSTER_NODE_PUBLIC
+  CommandCommitResponseSharedFuture commit_command(
+      uint64_t session_id, uint64_t sequence, Command::SharedPtr command,
+      CommandCommitResponseCallback callback);
+
+  /// Commit a ROS message to cluster.
+  /**
+   * The message is serialized into the command by serialize_command(), so
+   * it can be read back by register_on_committed_message() with the same
+   * type.
+   * \param[in] message A message to commit.
+   * \param[in] callback The callback to receive the commit response.
+   * \return Shared future of commit response.
+   */
+  template <typename MessageT>
+  CommandCommitResponseSharedFuture commit_message(
+      const MessageT &message, CommandCommitResponseCallback callback);
+
+  /// Commit a command to cluster in a coroutine.
+  /**
+   * The command is committed once the returned awaitable is awaited with
+   * co_await, and the coroutine is resumed by the executor spinning this node.
+   * \param[in] command A command to commit.
+   * \return Awaitable of commit response.
+   */
+  CLUSTER_NODE_PUBLIC
+  CommandCommitAwaitable commit(Command::SharedPtr command);
+
+  /// Run a task on the executor spinning this node.
+  /**
+   * This can be called from any thread, and the tasks are run in the order
+   * they are posted.
+   * \param[in] task The task to run.
+   */
+  CLUSTER_NODE_PUBLIC
+  void post(std::function<void()> task);
+
   /// Get the size of available commands
   /**
    * \return The size of commands
@@ -1221,14 +1318,67 @@ class ClusterNode : public std::enable_shared_from_this<ClusterNode>,
   CLUSTER_NODE_PUBLIC
   Command::SharedPtr get_command(uint64_t id);
 
+  /// Acknowledge that commands up to the given ID are applied
+  /**
+   * The acknowledged size is persisted, so that the commands are not passed
+   * to the committed callback again after a restart. With the key-value
+   * store, the commands after its last snapshot are still passed again.
+   *
+   * \param[in] id ID of the last applied command
+   * \return true if the command exists
+   */
+  CLUSTER_NODE_PUBLIC
+  bool acknowledge_applied(uint64_t id);
+
+  /// Get the size of commands acknowledged as applied
+  /**
+   * \return The size of applied commands
+   */
+  CLUSTER_NODE_PUBLIC
+  uint64_t get_applied_commands_size();
+
   /// Register the commited callback
   /**
+   * Commands which are not acknowledged as applied, including the ones loaded
+   * on restart, are passed to the callback on registration.
+   *
    * \param[in] callback The callback to register
    */
   CLUSTER_NODE_PUBLIC
   void register_on_committed(
       std::function<void(const uint64_t, Command::SharedPtr)> callback);
 
+  /// Register the batched commited callback
+  /**
+   * The callback receives the id of the first command and the contiguous
+   * commands committed together, such as the entries of one append entries
+   * request or one batch commit.
+   * A single commit is passed as a range of one command.
+   * Commands which are not acknowledged as applied are passed on registration
+   * in ranges of up to 256 commands.
+   *
+   * \param[in] callback The callback to register
+   */
+  CLUSTER_NODE_PUBLIC
+  void register_on_committed_batch(
+      std::function<void(const uint64_t,
+                         const std::vector<Command::SharedPtr> &)>
+          callback);
+
+  /// Register the commited callback receiving ROS messages
+  /**
+   * Commands are deserialized by deserialize_command() before they are
+   * passed to the callback, so every command must be committed as a message
+   * of the type. A command which can not be deserialized is not passed.
+   * This replaces the callback registered by register_on_committed().
+   *
+   * \param[in] callback The callback to register
+   */
+  template <typename MessageT>
+  void register_on_committed_message(
+      std::function<void(const uint64_t, std::shared_ptr<MessageT>)>
+          callback);
+
   /// Register the reverted callback
   /**
    * \param[in] callback The callback to register
@@ -1236,6 +1386,87 @@ class ClusterNode : public std::enable_shared_from_this<ClusterNode>,
   CLUSTER_NODE_PUBLIC
   void register_on_reverted(std::function<void(const uint64_t)> callback);
 
+  /// Get a value of the key-value store
+  /**
+   * The value is read from the local copy of the store without a round to
+   * the cluster. Only the leader serves reads, since the other nodes may lag
+   * behind the committed changes.
+   * The key-value store is enabled by ClusterNodeOptions::kv_store().
+   *
+   * \param[in] key The key to read.
+   * \param[out] value The value of the key.
+   * \return true if this node is the leader and the key exists, otherwise
+   * false.
+   */
+  CLUSTER_NODE_PUBLIC
+  bool kv_get(const std::string &key, std::vector<uint8_t> &value);
+
+  /// Set a value of the key-value store
+  /**
+   * \param[in] key The key to set.
+   * \param[in] value The value to set.
+   * \param[in] callback The callback to receive the response.
+   * \return Shared future of the response.
+   */
+  CLUSTER_NODE_PUBLIC
+  KVResponseSharedFuture kv_set(const std::string &key,
+                                const std::vector<uint8_t> &value,
+                                KVResponseCallback callback);
+
+  /// Delete a key of the key-value store
+  /**
+   * The result of the response is false if the key does not exist.
+   *
+   * \param[in] key The key to delete.
+   * \param[in] callback The callback to receive the response.
+   * \return Shared future of the response.
+   */
+  CLUSTER_NODE_PUBLIC
+  KVResponseSharedFuture kv_delete(const std::string &key,
+                                   KVResponseCallback callback);
+
+  /// Set a value of the key-value store if it has the expected value
+  /**
+   * The comparison is made when the command is applied, so every node
+   * decides it the same way. The result of the response is false if the key
+   * does not exist or has another value.
+   *
+   * \param[in] key The key to set.
+   * \param[in] expected The expected value of the key.
+   * \param[in] value The value to set.
+   * \param[in] callback The callback to receive the response.
+   * \return Shared future of the response.
+   */
+  CLUSTER_NODE_PUBLIC
+  KVResponseSharedFuture kv_compare_and_set(
+      const std::string &key, const std::vector<uint8_t> &expected,
+      const std::vector<uint8_t> &value, KVResponseCallback callback);
+
+  /// Watch changes of the key-value store
+  /**
+   * Only the changes of the watched key, or of the keys beginning with it if
+   * prefix is true, are passed to the callback. Only the latest change of
+   * each key is passed when it changes several times within a period.
+   * The callback is called by the executor spinning this node.
+   *
+   * \param[in] key The key or prefix to watch.
+   * \param[in] prefix true to watch the keys beginning with the key.
+   * \param[in] period The period to pass the changes, 0 to pass them as soon
+   *   as the executor runs.
+   * \param[in] callback The callback to receive the changes.
+   * \return ID of the watch, 0 if the key-value store is not enabled.
+   */
+  CLUSTER_NODE_PUBLIC
+  uint64_t kv_watch(const std::string &key, bool prefix,
+                    std::chrono::milliseconds period, KVWatchCallback callback);
+
+  /// Stop watching changes of the key-value store
+  /**
+   * \param[in] watch_id ID of the watch.
+   */
+  CLUSTER_NODE_PUBLIC
+  void kv_unwatch(uint64_t watch_id);
+
    /// insert data in entry buffer of candidate
   /**
    * \param[in] data  The callback to register
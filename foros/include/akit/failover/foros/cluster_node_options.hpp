@@ -19,6 +19,8 @@
 
 #include <rclcpp/node_options.hpp>
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 #include "akit/failover/foros/common.hpp"
@@ -27,6 +29,17 @@ namespace akit {
 namespace failover {
 namespace foros {
 
+/// Storage keeping the raft state and logs of a clustered node.
+enum class StorageType {
+  /// leveldb database in the temp directory.
+  kLevelDB,
+  /// Memory only. Nothing is written to disk and nothing survives a restart.
+  kMemory,
+  /// Write-ahead log file in the temp directory, written with io_uring where
+  /// the kernel supports it.
+  kWAL,
+};
+
 /// Options of a clustered node
 class ClusterNodeOptions : public rclcpp::NodeOptions {
  public:
@@ -56,6 +69,13 @@ class ClusterNodeOptions : public rclcpp::NodeOptions {
    * Default values for the cluster node extended options:
    *   - election_timeout_min = 150ms
    *   - election_timeout_max = 300ms
+   *   - storage_type = StorageType::kLevelDB
+   *   - delta_encoding = false
+   *   - compression_threshold = 0
+   *   - callback_queue_size = 0
+   *   - kv_store = false
+   *   - kv_snapshot_interval = 1024
+   *   - commit_forwarding = false
    *
    * \param[in] allocator allocator to use in construction of
    *   ClusterNodeOptions.
@@ -110,10 +130,154 @@ class ClusterNodeOptions : public rclcpp::NodeOptions {
   CLUSTER_NODE_PUBLIC
   ClusterNodeOptions &temp_directory(std::string &directory);
 
+  /// Return the storage type.
+  /**
+   * \return The storage type.
+   */
+  CLUSTER_NODE_PUBLIC
+  StorageType storage_type() const;
+
+  /// Set the storage type.
+  /**
+   * StorageType::kMemory removes all disk I/O from the commit path for
+   * clusters which only need failover and no persistence across reboots.
+   * StorageType::kWAL appends every change to a single file and batches
+   * concurrent writes into one sync.
+   *
+   * \param type the storage type.
+   * \return The reference of this instance.
+   */
+  CLUSTER_NODE_PUBLIC
+  ClusterNodeOptions &storage_type(StorageType type);
+
+  /// Return whether commands are encoded as deltas.
+  /**
+   * \return true if commands are encoded as deltas.
+   */
+  CLUSTER_NODE_PUBLIC
+  bool delta_encoding() const;
+
+  /// Set whether commands are encoded as deltas.
+  /**
+   * A command is replicated as the bytes differing from the previous command
+   * whenever that is smaller, which suits successive snapshots of the same
+   * message. StorageType::kWAL stores commands the same way, while the other
+   * storage types store them as they are.
+   * All nodes of a cluster must use the same value.
+   *
+   * \param enable true to encode commands as deltas.
+   * \return The reference of this instance.
+   */
+  CLUSTER_NODE_PUBLIC
+  ClusterNodeOptions &delta_encoding(bool enable);
+
+  /// Return the compression threshold.
+  /**
+   * \return The compression threshold in bytes.
+   */
+  CLUSTER_NODE_PUBLIC
+  uint32_t compression_threshold() const;
+
+  /// Set the compression threshold.
+  /**
+   * Commands of at least this size are zlib compressed when they are
+   * replicated, and when they are stored with StorageType::kWAL, if that
+   * makes them smaller. Smaller commands are not worth the compression time.
+   * All nodes of a cluster must use the same value.
+   *
+   * \param size the compression threshold in bytes, 0 to disable compression.
+   * \return The reference of this instance.
+   */
+  CLUSTER_NODE_PUBLIC
+  ClusterNodeOptions &compression_threshold(uint32_t size);
+
+  /// Return the size of the callback queue.
+  /**
+   * \return The size of the callback queue.
+   */
+  CLUSTER_NODE_PUBLIC
+  std::size_t callback_queue_size() const;
+
+  /// Set the size of the callback queue.
+  /**
+   * The committed and reverted callbacks are called in order on a dedicated
+   * thread through a queue of this size, so that a slow callback does not
+   * delay the responses to the leader. Raft waits for the callbacks only
+   * when the queue is full.
+   *
+   * \param size the size of the callback queue, 0 to call the callbacks on
+   *   the raft threads.
+   * \return The reference of this instance.
+   */
+  CLUSTER_NODE_PUBLIC
+  ClusterNodeOptions &callback_queue_size(std::size_t size);
+
+  /// Return whether the key-value store is enabled.
+  CLUSTER_NODE_PUBLIC
+  bool kv_store() const;
+
+  /// Set whether the key-value store is enabled.
+  /**
+   * The key-value store is replicated through the commands, so the
+   * application sees its requests in the committed callback as well.
+   *
+   * \param enable true to enable the key-value store.
+   * \return The reference of this instance.
+   */
+  CLUSTER_NODE_PUBLIC
+  ClusterNodeOptions &kv_store(bool enable);
+
+  /// Return the snapshot interval of the key-value store.
+  CLUSTER_NODE_PUBLIC
+  uint64_t kv_snapshot_interval() const;
+
+  /// Set the snapshot interval of the key-value store.
+  /**
+   * A snapshot of the store is written next to the logs of the storage every
+   * interval of commands by a worker thread, and the commands in it are
+   * acknowledged as applied once it is written so that they are not loaded on
+   * restart.
+   * An interval is skipped while the previous snapshot is still being
+   * written. The changes of the last interval are
+   * kept to be reverted. Nothing is written with the memory storage.
+   *
+   * \param interval the number of commands between snapshots.
+   * \return The reference of this instance.
+   */
+  CLUSTER_NODE_PUBLIC
+  ClusterNodeOptions &kv_snapshot_interval(uint64_t interval);
+
+  /// Return whether the commits of a follower are forwarded to the leader.
+  CLUSTER_NODE_PUBLIC
+  bool commit_forwarding() const;
+
+  /// Set whether the commits of a follower are forwarded to the leader.
+  /**
+   * A command committed on a follower is relayed to the leader known from
+   * its last AppendEntries request, and the response is completed with the
+   * result of the leader, even if the term changes meanwhile. The commit
+   * fails if no leader is known, or if the leader does not respond within
+   * twice the maximum election timeout unless the command of a session is
+   * found committed then. Commits with a completion queue or in a batch are
+   * not forwarded.
+   *
+   * \param enable true to forward the commits to the leader.
+   * \return The reference of this instance.
+   */
+  CLUSTER_NODE_PUBLIC
+  ClusterNodeOptions &commit_forwarding(bool enable);
+
  private:
   unsigned int election_timeout_min_;
   unsigned int election_timeout_max_;
   std::string temp_directory_;
+  StorageType storage_type_;
+  bool delta_encoding_;
+  uint32_t compression_threshold_;
+  std::size_t callback_queue_size_;
+  bool kv_store_;
+  uint64_t kv_snapshot_interval_;
+  bool commit_forwarding_;
 };
 
 }  // namespace foros
@@ -20,7 +20,9 @@
 #include <rclcpp/create_client.hpp>
 #include <rclcpp/create_publisher.hpp>
 #include <rclcpp/exceptions.hpp>
+#include <rclcpp/logging.hpp>
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -28,6 +30,7 @@
 #include <vector>
 
 #include "akit/failover/foros/cluster_node.hpp"
+#include "akit/failover/foros/command_serialization.hpp"
 #include "akit/failover/foros/common.hpp"
 
 namespace akit {
@@ -98,6 +101,34 @@ typename ClusterNodeService<ServiceT>::SharedPtr ClusterNode::create_service(
   return service;
 }
 
+template <typename MessageT>
+CommandCommitResponseSharedFuture ClusterNode::commit_message(
+    const MessageT &message, CommandCommitResponseCallback callback) {
+  return commit_command(serialize_command(message), callback);
+}
+
+template <typename MessageT>
+void ClusterNode::register_on_committed_message(
+    std::function<void(const uint64_t, std::shared_ptr<MessageT>)>
+        callback) {
+  if (callback == nullptr) {
+    register_on_committed(nullptr);
+    return;
+  }
+
+  register_on_committed(
+      [this, callback](const uint64_t id, Command::SharedPtr command) {
+        auto message = std::make_shared<MessageT>();
+        if (command == nullptr ||
+            deserialize_command(*command, *message) == false) {
+          RCLCPP_ERROR(get_logger(), "command %lu is not a message of the type",
+                       id);
+          return;
+        }
+        callback(id, message);
+      });
+}
+
 template <typename ParameterT>
 auto ClusterNode::declare_parameter(
     const std::string &name, const ParameterT &default_value,
@@ -19,23 +19,126 @@
 
 #include <rclcpp/macros.hpp>
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <future>
 #include <memory>
 #include <utility>
+#include <variant>
 #include <vector>
 
+#include "akit/failover/foros/pool_allocator.hpp"
+
 namespace akit {
 namespace failover {
 namespace foros {
 
+/// Immutable byte buffer which can be shared by commands without copying.
+using CommandBuffer = std::shared_ptr<const std::vector<uint8_t>>;
+
+/// Read-only view of the data of a command.
+/**
+ * The view is valid as long as the command it is taken from.
+ */
+class CommandData {
+ public:
+  using value_type = uint8_t;
+  using const_iterator = const uint8_t *;
+
+  /// Create a view of bytes.
+  /**
+   * \param[in] data Data in byte pointer.
+   * \param[in] size Size of the data.
+   */
+  CommandData(const uint8_t *data, std::size_t size)
+      : data_(data), size_(size) {}
+
+  /// Create a view of a byte vector.
+  /**
+   * \param[in] data Data in byte vector.
+   */
+  CommandData(const std::vector<uint8_t> &data)  // NOLINT
+      : data_(data.data()), size_(data.size()) {}
+
+  /// Get the bytes.
+  /**
+   * \return The data in byte pointer.
+   */
+  const uint8_t *data() const { return data_; }
+
+  /// Get the size.
+  /**
+   * \return The size of the data.
+   */
+  std::size_t size() const { return size_; }
+
+  /// Check if the data is empty.
+  /**
+   * \return true if the data is empty, otherwise false.
+   */
+  bool empty() const { return size_ == 0; }
+
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+  uint8_t operator[](std::size_t index) const { return data_[index]; }
+
+  /// Copy the data.
+  /**
+   * \return The data in byte vector.
+   */
+  std::vector<uint8_t> to_vector() const {
+    return std::vector<uint8_t>(begin(), end());
+  }
+
+ private:
+  const uint8_t *data_;
+  std::size_t size_;
+};
+
+/// Compare the bytes of two views.
+CLUSTER_NODE_PUBLIC
+bool operator==(const CommandData &lhs, const CommandData &rhs);
+
+/// Compare the bytes of two views.
+inline bool operator!=(const CommandData &lhs, const CommandData &rhs) {
+  return !(lhs == rhs);
+}
+
+/// Type of a command.
+/**
+ * The type is stored and replicated next to the data of a command rather than
+ * inside it, so the data of the application is never taken for a command of
+ * the cluster node itself.
+ */
+enum class CommandType : uint8_t {
+  kApplication = 0,  ///< Command of the application.
+  kKeyValue = 1,     ///< Request to the key-value store of the cluster node.
+};
+
 /// Command.
 class Command {
  public:
-  RCLCPP_SMART_PTR_DEFINITIONS(Command)
+  FOROS_POOLED_SMART_PTR_DEFINITIONS(Command)
+
+  /// Data up to this size is kept inline by the command itself instead of a
+  /// separately allocated shared buffer.
+  static constexpr std::size_t kSmallDataSize = 64;
+
+  /// Create a command sharing the data of another one.
+  /**
+   * Small data is copied inline and a buffer is shared, so this does not
+   * allocate for the data.
+   *
+   * \param[in] other The command to copy.
+   */
+  Command(const Command &other) = default;
 
   /// Create a command.
   /**
+   * The data is moved into the command if it is passed as an rvalue.
+   *
    * \param[in] data Data in byte vector.
    */
   explicit Command(std::vector<uint8_t> data);
@@ -47,20 +150,96 @@ class Command {
    */
   explicit Command(const char *data, uint64_t size);
 
+  /// Create a command sharing a buffer.
+  /**
+   * The buffer is not copied. An aliasing shared pointer can be used to wrap
+   * a vector owned by another object, e.g. a field of a ROS message.
+   *
+   * \param[in] buffer Buffer of the data.
+   */
+  explicit Command(CommandBuffer buffer);
+
   /// Get the data.
   /**
-   * \return The data in byte vector.
+   * Small data kept inline is copied into a vector by the first call, so
+   * view() is preferred if a vector is not needed.
+   *
+   * \return The data in byte vector, valid as long as this command.
    */
   const std::vector<uint8_t> &data() const;
 
+  /// Get a view of the data without copying it.
+  /**
+   * \return The view of the data, valid as long as this command.
+   */
+  CommandData view() const;
+
+  /// Get the buffer of the data.
+  /**
+   * Small data is kept by the command itself, so a copy of it is returned.
+   *
+   * \return The buffer shared with this command.
+   */
+  CommandBuffer buffer() const;
+
+  /// Get the type.
+  /**
+   * \return The type of this command.
+   */
+  CommandType type() const { return type_; }
+
+  /// Set the type.
+  /**
+   * \param[in] type The type of this command.
+   */
+  void set_type(CommandType type) { type_ = type; }
+
+  /// Get the ID of the client session.
+  /**
+   * Like the type, the session is stored and replicated next to the data.
+   *
+   * \return The ID of the session committing this command, or 0 if it is
+   * not of a session.
+   */
+  uint64_t session_id() const { return session_id_; }
+
+  /// Get the sequence in the client session.
+  /**
+   * \return The sequence of this command in its session.
+   */
+  uint64_t sequence() const { return sequence_; }
+
+  /// Set the client session.
+  /**
+   * \param[in] session_id ID of the session, or 0 if it is not of a session.
+   * \param[in] sequence Sequence of this command in the session.
+   */
+  void set_session(uint64_t session_id, uint64_t sequence) {
+    session_id_ = session_id;
+    sequence_ = sequence;
+  }
+
  private:
-  std::vector<uint8_t> data_;
+  struct SmallData {
+    SmallData() : size_(0) {}
+
+    std::array<uint8_t, kSmallDataSize> bytes_;
+    std::size_t size_;
+    // copy of the bytes made by data(), shared by the copies of the command
+    mutable CommandBuffer vector_;
+  };
+
+  // either the small data or the buffer holds the data
+  std::variant<SmallData, CommandBuffer> data_;
+  CommandType type_ = CommandType::kApplication;
+  uint64_t session_id_ = 0;
+  uint64_t sequence_ = 0;
 };
 
 /// A response of a request to commit a command to the cluster.
 class CommandCommitResponse {
  public:
-  RCLCPP_SMART_PTR_DEFINITIONS(CommandCommitResponse)
+  FOROS_POOLED_SMART_PTR_DEFINITIONS(CommandCommitResponse)
 
   /// Create a response of a request to commit.
   /**
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_COMMAND_COMMIT_AWAITABLE_HPP_
+#define AKIT_FAILOVER_FOROS_COMMAND_COMMIT_AWAITABLE_HPP_
+
+#include <functional>
+#include <utility>
+
+#include "akit/failover/foros/command.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+/// An awaitable commit of a command.
+/**
+ * A C++20 coroutine awaiting this gets the commit response without blocking
+ * a thread:
+ *
+ *   auto response = co_await cluster_node->commit(command);
+ *
+ * The coroutine is suspended until the command is committed or failed, and
+ * it is resumed by the executor spinning the cluster node, never inside the
+ * raft callback. The awaitable itself does not need C++20, so it can be
+ * declared by the library which is built as C++17.
+ */
+class CommandCommitAwaitable {
+ public:
+  /// Function which starts a commit with a callback.
+  using CommitFunction = std::function<void(CommandCommitResponseCallback)>;
+  /// Function which runs a task on the executor, or the second task on the
+  /// thread shutting the executor down if the first one is not run by then.
+  using PostFunction =
+      std::function<void(std::function<void()>, std::function<void()>)>;
+
+  /// Create an awaitable commit.
+  /**
+   * The commit is not started until the awaitable is awaited.
+   *
+   * \param[in] commit Function to start the commit.
+   * \param[in] post Function to resume the awaiting coroutine.
+   */
+  CommandCommitAwaitable(CommitFunction commit, PostFunction post)
+      : commit_(std::move(commit)), post_(std::move(post)) {}
+
+  /// Always suspend the awaiting coroutine.
+  bool await_ready() const noexcept { return false; }
+
+  /// Start the commit and resume the coroutine once it is done.
+  /**
+   * If the node is destroyed before the coroutine is resumed, it is resumed
+   * with a failed response so that its frame is not leaked.
+   *
+   * \param[in] handle Handle of the awaiting coroutine.
+   */
+  template <typename CoroutineHandle>
+  void await_suspend(CoroutineHandle handle) {
+    // The coroutine can be resumed by another executor thread before this
+    // returns, so the members are not accessed after the commit is started.
+    // They are moved out so that the frame does not keep the node alive.
+    auto commit = std::move(commit_);
+    auto post = std::move(post_);
+    commit([this, handle, post](CommandCommitResponseSharedFuture future) {
+      auto response = future.get();
+      post(
+          [this, handle, response]() mutable {
+            response_ = response;
+            handle.resume();
+          },
+          [this, handle, response]() mutable {
+            response_ = CommandCommitResponse::make_shared(
+                response->id(), response->command(), false);
+            handle.resume();
+          });
+    });
+  }
+
+  /// Get the commit response.
+  /**
+   * \return The commit response.
+   */
+  CommandCommitResponse::SharedPtr await_resume() const { return response_; }
+
+ private:
+  CommitFunction commit_;
+  PostFunction post_;
+  CommandCommitResponse::SharedPtr response_;
+};
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_COMMAND_COMMIT_AWAITABLE_HPP_
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AKIT_FAILOVER_FOROS_COMMAND_SERIALIZATION_HPP_
+#define AKIT_FAILOVER_FOROS_COMMAND_SERIALIZATION_HPP_
+
+#include <rclcpp/serialization.hpp>
+#include <rclcpp/serialized_message.hpp>
+#include <rmw/rmw.h>
+#include <rmw/serialized_message.h>
+
+#include <rosidl_typesupport_cpp/message_type_support.hpp>
+
+#include "akit/failover/foros/command.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+/// Serialize a ROS message into a command.
+/**
+ * The message is serialized in CDR by rclcpp::Serialization, and the
+ * serialized bytes are the data of the command.
+ *
+ * \param[in] message The message to serialize.
+ * \return The command of the message.
+ * \throws rcpputils::RCLError if the message can not be serialized.
+ */
+template <typename MessageT>
+Command::SharedPtr serialize_command(const MessageT &message) {
+  static rclcpp::Serialization<MessageT> serialization;
+  rclcpp::SerializedMessage serialized_message;
+  serialization.serialize_message(&message, &serialized_message);
+
+  auto &serialized = serialized_message.get_rcl_serialized_message();
+  return Command::make_shared(reinterpret_cast<const char *>(serialized.buffer),
+                              serialized.buffer_length);
+}
+
+/// Deserialize a ROS message from a command.
+/**
+ * The data of the command is read in place without copying.
+ *
+ * \param[in] command The command serialized by serialize_command().
+ * \param[out] message The deserialized message.
+ * \return true if the message is deserialized, otherwise false.
+ */
+template <typename MessageT>
+bool deserialize_command(const Command &command, MessageT &message) {
+  auto data = command.view();
+  rmw_serialized_message_t serialized =
+      rmw_get_zero_initialized_serialized_message();
+  serialized.buffer = const_cast<uint8_t *>(data.data());
+  serialized.buffer_length = data.size();
+  serialized.buffer_capacity = data.size();
+  return rmw_deserialize(
+             &serialized,
+             rosidl_typesupport_cpp::get_message_type_support_handle<
+                 MessageT>(),
+             &message) == RMW_RET_OK;
+}
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_COMMAND_SERIALIZATION_HPP_
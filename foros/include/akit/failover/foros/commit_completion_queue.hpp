@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_COMMIT_COMPLETION_QUEUE_HPP_
+#define AKIT_FAILOVER_FOROS_COMMIT_COMPLETION_QUEUE_HPP_
+
+#include <rclcpp/macros.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "akit/failover/foros/common.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+/// A completion of a commit pushed to a completion queue.
+struct CommitCompletion {
+  /// The tag given with the commit.
+  uint64_t tag;
+  /// The command ID.
+  uint64_t id;
+  /// true if the commit is successful, otherwise false.
+  bool result;
+};
+
+/// Queue of commit completions.
+/**
+ * Commits tagged by the caller push their completions to this queue from the
+ * raft threads, and the application drains them in batches from its own
+ * thread. Unlike the future API, no promise is allocated per commit and no
+ * user code is called from the raft threads.
+ */
+class CommitCompletionQueue {
+ public:
+  RCLCPP_SMART_PTR_DEFINITIONS(CommitCompletionQueue)
+
+  /// Push a completion.
+  /**
+   * This can be called from any thread.
+   *
+   * \param[in] completion The completion to push.
+   */
+  CLUSTER_NODE_PUBLIC
+  void push(const CommitCompletion &completion);
+
+  /// Take all the pushed completions.
+  /**
+   * The completions are swapped with the given vector, so the capacity of
+   * the vector is reused for the next completions.
+   *
+   * \param[out] completions The completions in the order they are pushed.
+   * \return The number of completions.
+   */
+  CLUSTER_NODE_PUBLIC
+  std::size_t drain(std::vector<CommitCompletion> &completions);
+
+  /// Wait until a completion is pushed.
+  /**
+   * \param[in] timeout Maximum time to wait.
+   * \return true if there is a completion to drain, otherwise false.
+   */
+  CLUSTER_NODE_PUBLIC
+  bool wait(std::chrono::nanoseconds timeout);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::vector<CommitCompletion> completions_;
+  unsigned int waiters_ = 0;
+};
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_COMMIT_COMPLETION_QUEUE_HPP_
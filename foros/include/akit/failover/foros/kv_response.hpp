@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AKIT_FAILOVER_FOROS_KV_RESPONSE_HPP_
+#define AKIT_FAILOVER_FOROS_KV_RESPONSE_HPP_
+
+#include <rclcpp/macros.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+
+#include "akit/failover/foros/common.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+/// A response of a request to change the replicated key-value store.
+class KVResponse {
+ public:
+  RCLCPP_SMART_PTR_DEFINITIONS(KVResponse)
+
+  /// Create a response of a request to change the key-value store.
+  /**
+   * \param[in] id The command ID of the request.
+   * \param[in] committed true if the request is committed, otherwise false.
+   * \param[in] result true if the request changed the store, otherwise false.
+   */
+  CLUSTER_NODE_PUBLIC
+  explicit KVResponse(uint64_t id, bool committed, bool result);
+
+  /// Get the ID.
+  /**
+   * \return The command ID of the request.
+   */
+  CLUSTER_NODE_PUBLIC
+  uint64_t id() const;
+
+  /// Get whether the request is committed.
+  /**
+   * \return true if the request is committed, otherwise false.
+   */
+  CLUSTER_NODE_PUBLIC
+  bool committed() const;
+
+  /// Get the result.
+  /**
+   * A committed request may not change the store, e.g. a delete of a missing
+   * key or a compare-and-set of an unexpected value.
+   *
+   * \return true if the request changed the store, otherwise false.
+   */
+  CLUSTER_NODE_PUBLIC
+  bool result() const;
+
+ private:
+  const uint64_t id_;
+  const bool committed_;
+  const bool result_;
+};
+
+using KVResponsePromise = std::promise<KVResponse::SharedPtr>;
+using KVResponseSharedPromise = std::shared_ptr<KVResponsePromise>;
+using KVResponseSharedFuture = std::shared_future<KVResponse::SharedPtr>;
+using KVResponseCallback = std::function<void(KVResponseSharedFuture)>;
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_KV_RESPONSE_HPP_
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AKIT_FAILOVER_FOROS_KV_WATCH_HPP_
+#define AKIT_FAILOVER_FOROS_KV_WATCH_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+/// A change of a key in the replicated key-value store.
+struct KVChange {
+  /// The changed key.
+  std::string key;
+  /// true if the key is deleted, otherwise false.
+  bool deleted;
+  /// The value of the key, empty if the key is deleted.
+  std::vector<uint8_t> value;
+  /// The command ID of the change, or of the first reverted command if the
+  /// change is a revert.
+  uint64_t id;
+};
+
+/// Callback receiving the latest changes of the watched keys.
+using KVWatchCallback = std::function<void(const std::vector<KVChange> &)>;
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_KV_WATCH_HPP_
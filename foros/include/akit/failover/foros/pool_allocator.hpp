@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_POOL_ALLOCATOR_HPP_
+#define AKIT_FAILOVER_FOROS_POOL_ALLOCATOR_HPP_
+
+#include <rclcpp/macros.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "akit/failover/foros/common.hpp"
+
+/// Smart pointer definitions whose make_shared allocates from BlockPool.
+#define FOROS_POOLED_SMART_PTR_DEFINITIONS(...)                      \
+  RCLCPP_SMART_PTR_ALIASES_ONLY(__VA_ARGS__)                         \
+                                                                     \
+  template <typename... Args>                                        \
+  static std::shared_ptr<__VA_ARGS__> make_shared(Args &&...args) {  \
+    return std::allocate_shared<__VA_ARGS__>(                        \
+        ::akit::failover::foros::PoolAllocator<__VA_ARGS__>(),       \
+        std::forward<Args>(args)...);                                \
+  }                                                                  \
+                                                                     \
+  template <typename... Args>                                        \
+  static std::unique_ptr<__VA_ARGS__> make_unique(Args &&...args) {  \
+    return std::make_unique<__VA_ARGS__>(std::forward<Args>(args)...); \
+  }
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+/// Pool of fixed size memory blocks.
+/**
+ * Blocks up to kMaxBlockSize bytes are carved out of large chunks and reused
+ * through per size class free lists, so objects created for every commit do
+ * not hit the system allocator. Larger blocks fall back to operator new.
+ */
+class BlockPool {
+ public:
+  /// Maximum size of a block served from the pool.
+  static constexpr std::size_t kMaxBlockSize = 256;
+
+  /// Allocate a block.
+  /**
+   * \param[in] size Size of the block in bytes.
+   * \return The block aligned for any fundamental type.
+   */
+  CLUSTER_NODE_PUBLIC
+  static void *allocate(std::size_t size);
+
+  /// Return a block to the pool.
+  /**
+   * \param[in] block The block returned by allocate().
+   * \param[in] size Size of the block given to allocate().
+   */
+  CLUSTER_NODE_PUBLIC
+  static void deallocate(void *block, std::size_t size) noexcept;
+
+  /// Enable or disable the pool.
+  /**
+   * While disabled, every block is allocated by operator new, e.g. to measure
+   * the allocations saved by the pool. Blocks are still returned to the pool.
+   *
+   * \param[in] enabled true to enable the pool, false to disable it.
+   */
+  CLUSTER_NODE_PUBLIC
+  static void set_enabled(const bool enabled);
+};
+
+/// Allocator backed by BlockPool, to be used with std::allocate_shared and
+/// node based containers.
+template <typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  PoolAllocator() noexcept = default;
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U> &) noexcept {}  // NOLINT
+
+  T *allocate(std::size_t n) {
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "over-aligned types are not supported");
+    return static_cast<T *>(BlockPool::allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T *block, std::size_t n) noexcept {
+    BlockPool::deallocate(block, n * sizeof(T));
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) noexcept {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) noexcept {
+  return false;
+}
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_POOL_ALLOCATOR_HPP_
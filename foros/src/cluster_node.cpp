@@ -31,6 +31,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "akit/failover/foros/cluster_node_options.hpp"
@@ -94,7 +95,7 @@ ClusterNode::ClusterNode(const std::string &cluster_name,
       impl_(std::make_unique<ClusterNodeImpl>(
           cluster_name, node_id, cluster_node_ids, node_base_, node_graph_,
           node_logging_, node_services_, node_topics_, node_timers_,
-          node_clock_, options)) {}
+          node_clock_, node_waitables_, options)) {}
 
 ClusterNode::~ClusterNode() {
   // release sub-interfaces in an order that allows them to consult with
@@ -382,22 +383,97 @@ CommandCommitResponseSharedFuture ClusterNode::commit_command(
   return impl_->commit_command(command, callback);
 }
 
+void ClusterNode::commit_command(
+    Command::SharedPtr command, uint64_t tag,
+    CommitCompletionQueue::SharedPtr completion_queue) {
+  impl_->commit_command(command, tag, completion_queue);
+}
+
+std::vector<CommandCommitResponseSharedFuture> ClusterNode::commit_commands(
+    const std::vector<Command::SharedPtr> &commands,
+    CommandCommitResponseCallback callback) {
+  return impl_->commit_commands(commands, callback);
+}
+
+uint64_t ClusterNode::create_session_id() {
+  return impl_->create_session_id();
+}
+
+CommandCommitResponseSharedFuture ClusterNode::commit_command(
+    uint64_t session_id, uint64_t sequence, Command::SharedPtr command,
+    CommandCommitResponseCallback callback) {
+  return impl_->commit_command(session_id, sequence, command, callback);
+}
+
+CommandCommitAwaitable ClusterNode::commit(Command::SharedPtr command) {
+  return impl_->commit(command);
+}
+
+void ClusterNode::post(std::function<void()> task) {
+  impl_->post(std::move(task));
+}
+
 uint64_t ClusterNode::get_commands_size() { return impl_->get_commands_size(); }
 
 Command::SharedPtr ClusterNode::get_command(uint64_t id) {
   return impl_->get_command(id);
 }
 
+bool ClusterNode::acknowledge_applied(uint64_t id) {
+  return impl_->acknowledge_applied(id);
+}
+
+uint64_t ClusterNode::get_applied_commands_size() {
+  return impl_->get_applied_commands_size();
+}
+
 void ClusterNode::register_on_committed(
     std::function<void(const uint64_t, Command::SharedPtr)> callback) {
   impl_->register_on_committed(callback);
 }
 
+void ClusterNode::register_on_committed_batch(
+    std::function<void(const uint64_t,
+                       const std::vector<Command::SharedPtr> &)>
+        callback) {
+  impl_->register_on_committed_batch(callback);
+}
+
 void ClusterNode::register_on_reverted(
     std::function<void(const uint64_t)> callback) {
   impl_->register_on_reverted(callback);
 }
 
+bool ClusterNode::kv_get(const std::string &key,
+                         std::vector<uint8_t> &value) {
+  return impl_->kv_get(key, value);
+}
+
+KVResponseSharedFuture ClusterNode::kv_set(const std::string &key,
+                                           const std::vector<uint8_t> &value,
+                                           KVResponseCallback callback) {
+  return impl_->kv_set(key, value, callback);
+}
+
+KVResponseSharedFuture ClusterNode::kv_delete(const std::string &key,
+                                              KVResponseCallback callback) {
+  return impl_->kv_delete(key, callback);
+}
+
+KVResponseSharedFuture ClusterNode::kv_compare_and_set(
+    const std::string &key, const std::vector<uint8_t> &expected,
+    const std::vector<uint8_t> &value, KVResponseCallback callback) {
+  return impl_->kv_compare_and_set(key, expected, value, callback);
+}
+
+uint64_t ClusterNode::kv_watch(const std::string &key, bool prefix,
+                               std::chrono::milliseconds period,
+                               KVWatchCallback callback) {
+  return impl_->kv_watch(key, prefix, period, callback);
+}
+
+void ClusterNode::kv_unwatch(uint64_t watch_id) { impl_->kv_unwatch(watch_id); }
+
 
 
 /// syc///////////////////////
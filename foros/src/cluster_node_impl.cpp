@@ -19,7 +19,9 @@
 #include <rclcpp/node_interfaces/node_base.hpp>
 
 #include <memory>
+#include <random>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "akit/failover/foros/cluster_node_options.hpp"
@@ -39,15 +41,47 @@ ClusterNodeImpl::ClusterNodeImpl(
     rclcpp::node_interfaces::NodeTopicsInterface::SharedPtr node_topics,
     rclcpp::node_interfaces::NodeTimersInterface::SharedPtr node_timers,
     rclcpp::node_interfaces::NodeClockInterface::SharedPtr node_clock,
+    rclcpp::node_interfaces::NodeWaitablesInterface::SharedPtr node_waitables,
     const ClusterNodeOptions &options)
     : logger_(node_logging->get_logger().get_child("cluster_node")),
       raft_context_(std::make_shared<raft::Context>(
           cluster_name, node_id, node_base, node_graph, node_services,
-          node_topics, node_timers, node_clock, options.election_timeout_min(),
-          options.election_timeout_max(), options.temp_directory(), logger_)),
+          node_topics, node_timers, node_clock, node_waitables,
+          options.election_timeout_min(), options.election_timeout_max(),
+          options.temp_directory(), logger_, options.storage_type(),
+          raft::EntryCodec(options.delta_encoding(),
+                           options.compression_threshold()),
+          options.callback_queue_size(), options.commit_forwarding())),
       raft_fsm_(std::make_unique<raft::StateMachine>(cluster_node_ids,
                                                      raft_context_, logger_)),
-      lifecycle_fsm_(std::make_unique<lifecycle::StateMachine>(logger_)) {
+      lifecycle_fsm_(std::make_unique<lifecycle::StateMachine>(logger_)),
+      node_base_(node_base),
+      node_timers_(node_timers),
+      node_clock_(node_clock),
+      node_waitables_(node_waitables),
+      task_queue_(std::make_shared<TaskQueue>()) {
+  node_waitables_->add_waitable(task_queue_, nullptr);
+  if (options.kv_store() == true) {
+    // the snapshot is kept with the logs it replaces, so that both of them
+    // survive or are cleared together
+    std::string snapshot_file;
+    auto &storage_directory = raft_context_->get_storage_directory();
+    if (storage_directory.empty() == false) {
+      snapshot_file = storage_directory + "/kv_snapshot";
+    }
+    // the snapshot is acknowledged apart from the applied commands of the
+    // application, so that neither of them drops the logs the other needs
+    kv_store_ = std::make_unique<KVStore>(
+        node_id, snapshot_file, options.kv_snapshot_interval(),
+        [context = raft_context_.get()](uint64_t size) {
+          return context->acknowledge_snapshot(size);
+        },
+        logger_, &raft_context_->get_session_table());
+    if (kv_store_->is_persistent() == true) {
+      raft_context_->acknowledge_snapshot(kv_store_->snapshot_size());
+    }
+    raft_context_->set_log_applier(kv_store_.get());
+  }
   lifecycle_fsm_->subscribe(this);
   raft_fsm_->subscribe(this);
   raft_fsm_->handle(raft::Event::kStarted);
@@ -56,6 +90,15 @@ ClusterNodeImpl::ClusterNodeImpl(
 ClusterNodeImpl::~ClusterNodeImpl() {
   lifecycle_fsm_->unsubscribe(this);
   raft_fsm_->unsubscribe(this);
+  node_waitables_->remove_waitable(task_queue_, nullptr);
+  // coroutines waiting for the executor are resumed instead of leaked
+  task_queue_->close();
+  for (auto &timer : kv_watch_timers_) {
+    timer.second->cancel();
+  }
+  if (kv_store_ != nullptr) {
+    raft_context_->set_log_applier(nullptr);
+  }
 }
 
 void ClusterNodeImpl::handle(const lifecycle::StateType &state) {
@@ -164,6 +207,52 @@ CommandCommitResponseSharedFuture ClusterNodeImpl::commit_command(
   return raft_context_->commit_command(command, callback);
 }
 
+void ClusterNodeImpl::commit_command(
+    Command::SharedPtr command, uint64_t tag,
+    CommitCompletionQueue::SharedPtr completion_queue) {
+  raft_context_->commit_command(command, tag, completion_queue);
+}
+
+std::vector<CommandCommitResponseSharedFuture> ClusterNodeImpl::commit_commands(
+    const std::vector<Command::SharedPtr> &commands,
+    CommandCommitResponseCallback &callback) {
+  return raft_context_->commit_commands(commands, callback);
+}
+
+uint64_t ClusterNodeImpl::create_session_id() {
+  std::random_device random_device;
+  // 0 stands for a command which is not of a session
+  uint64_t session_id = 0;
+  while (session_id == 0) {
+    session_id =
+        (static_cast<uint64_t>(random_device()) << 32) | random_device();
+  }
+  return session_id;
+}
+
+CommandCommitResponseSharedFuture ClusterNodeImpl::commit_command(
+    uint64_t session_id, uint64_t sequence, Command::SharedPtr command,
+    CommandCommitResponseCallback &callback) {
+  return raft_context_->commit_command(session_id, sequence, command,
+                                       callback);
+}
+
+CommandCommitAwaitable ClusterNodeImpl::commit(Command::SharedPtr command) {
+  return CommandCommitAwaitable(
+      [context = raft_context_, command](
+          CommandCommitResponseCallback callback) {
+        context->commit_command(command, callback);
+      },
+      [queue = task_queue_](std::function<void()> task,
+                            std::function<void()> cancel) {
+        queue->post(std::move(task), std::move(cancel));
+      });
+}
+
+void ClusterNodeImpl::post(std::function<void()> task) {
+  task_queue_->post(std::move(task));
+}
+
 void ClusterNodeImpl::register_on_activated(std::function<void()> callback) {
   set_activated_callback(callback);
 }
@@ -196,11 +285,26 @@ Command::SharedPtr ClusterNodeImpl::get_command(uint64_t id) {
   return raft_context_->get_command(id);
 }
 
+bool ClusterNodeImpl::acknowledge_applied(uint64_t id) {
+  return raft_context_->acknowledge_applied(id);
+}
+
+uint64_t ClusterNodeImpl::get_applied_commands_size() {
+  return raft_context_->get_applied_commands_size();
+}
+
 void ClusterNodeImpl::register_on_committed(
     std::function<void(const uint64_t, Command::SharedPtr)> callback) {
   raft_context_->register_on_committed(callback);
 }
 
+void ClusterNodeImpl::register_on_committed_batch(
+    std::function<void(const uint64_t,
+                       const std::vector<Command::SharedPtr> &)>
+        callback) {
+  raft_context_->register_on_committed_batch(callback);
+}
+
 void ClusterNodeImpl::register_on_reverted(
     std::function<void(const uint64_t)> callback) {
   raft_context_->register_on_reverted(callback);
@@ -227,6 +331,108 @@ void  ClusterNodeImpl::reset_entry_buffer() {
 //syc////////////////
 
 
+bool ClusterNodeImpl::kv_get(const std::string &key,
+                             std::vector<uint8_t> &value) {
+  if (kv_store_ == nullptr) {
+    RCLCPP_ERROR(logger_, "key-value store is not enabled");
+    return false;
+  }
+  // the other nodes may lag behind the committed changes
+  if (is_leader() == false) {
+    RCLCPP_ERROR(logger_, "key-value store is read on the leader only");
+    return false;
+  }
+  return kv_store_->get(key, value);
+}
+
+KVResponseSharedFuture ClusterNodeImpl::kv_set(
+    const std::string &key, const std::vector<uint8_t> &value,
+    KVResponseCallback callback) {
+  return request_kv(KVStore::Operation::kSet, key, {}, value, callback);
+}
+
+KVResponseSharedFuture ClusterNodeImpl::kv_delete(
+    const std::string &key, KVResponseCallback callback) {
+  return request_kv(KVStore::Operation::kDelete, key, {}, {}, callback);
+}
+
+KVResponseSharedFuture ClusterNodeImpl::kv_compare_and_set(
+    const std::string &key, const std::vector<uint8_t> &expected,
+    const std::vector<uint8_t> &value, KVResponseCallback callback) {
+  return request_kv(KVStore::Operation::kCompareAndSet, key, expected, value,
+                    callback);
+}
+
+uint64_t ClusterNodeImpl::kv_watch(const std::string &key, bool prefix,
+                                   std::chrono::milliseconds period,
+                                   KVWatchCallback callback) {
+  if (kv_store_ == nullptr) {
+    RCLCPP_ERROR(logger_, "key-value store is not enabled");
+    return 0;
+  }
+
+  // without a period, the changes are flushed by the executor as soon as it
+  // runs the posted task, coalescing the ones made meanwhile
+  if (period.count() <= 0) {
+    return kv_store_->add_watch(
+        key, prefix, callback,
+        [store = kv_store_.get(), queue = task_queue_](uint64_t watch_id) {
+          queue->post([store, watch_id]() { store->flush_watch(watch_id); });
+        });
+  }
+
+  auto watch_id = kv_store_->add_watch(key, prefix, callback, nullptr);
+  auto timer = rclcpp::GenericTimer<rclcpp::VoidCallbackType>::make_shared(
+      node_clock_->get_clock(), period,
+      [store = kv_store_.get(), watch_id]() { store->flush_watch(watch_id); },
+      node_base_->get_context());
+  node_timers_->add_timer(timer, nullptr);
+  kv_watch_timers_.emplace(watch_id, timer);
+  return watch_id;
+}
+
+void ClusterNodeImpl::kv_unwatch(uint64_t watch_id) {
+  if (kv_store_ == nullptr) {
+    return;
+  }
+  kv_store_->remove_watch(watch_id);
+
+  auto timer = kv_watch_timers_.find(watch_id);
+  if (timer != kv_watch_timers_.end()) {
+    timer->second->cancel();
+    kv_watch_timers_.erase(timer);
+  }
+}
+
+KVResponseSharedFuture ClusterNodeImpl::request_kv(
+    const KVStore::Operation operation, const std::string &key,
+    const std::vector<uint8_t> &expected, const std::vector<uint8_t> &value,
+    KVResponseCallback callback) {
+  if (kv_store_ == nullptr) {
+    RCLCPP_ERROR(logger_, "key-value store is not enabled");
+    auto promise = std::make_shared<KVResponsePromise>();
+    KVResponseSharedFuture future = promise->get_future();
+    promise->set_value(KVResponse::make_shared(0, false, false));
+    if (callback != nullptr) {
+      callback(future);
+    }
+    return future;
+  }
+
+  // the response is completed by the store once the command is applied
+  uint64_t request_id;
+  KVResponseSharedFuture future;
+  auto command = kv_store_->make_request(operation, key, expected, value,
+                                         callback, request_id, future);
+  raft_context_->commit_command(
+      command, [this, request_id](CommandCommitResponseSharedFuture response) {
+        if (response.get()->result() == false) {
+          kv_store_->cancel_request(request_id, response.get()->id());
+        }
+      });
+  return future;
+}
+
 }  // namespace foros
 }  // namespace failover
 }  // namespace akit
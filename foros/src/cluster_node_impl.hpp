@@ -24,8 +24,10 @@
 #include <rclcpp/node_interfaces/node_logging_interface.hpp>
 #include <rclcpp/node_interfaces/node_services_interface.hpp>
 #include <rclcpp/node_interfaces/node_timers_interface.hpp>
+#include <rclcpp/node_interfaces/node_waitables_interface.hpp>
 #include <rclcpp/node_options.hpp>
 
+#include <chrono>
 #include <functional>
 #include <list>
 #include <map>
@@ -36,7 +38,13 @@
 
 #include "akit/failover/foros/cluster_node_options.hpp"
 #include "akit/failover/foros/command.hpp"
+#include "akit/failover/foros/command_commit_awaitable.hpp"
+#include "akit/failover/foros/commit_completion_queue.hpp"
+#include "akit/failover/foros/kv_response.hpp"
+#include "akit/failover/foros/kv_watch.hpp"
 #include "common/observer.hpp"
+#include "common/task_queue.hpp"
+#include "kv_store.hpp"
 #include "lifecycle/state_machine.hpp"
 #include "lifecycle/state_type.hpp"
 #include "raft/context.hpp"
@@ -59,6 +67,8 @@ class ClusterNodeImpl final : Observer<lifecycle::StateType>,
       rclcpp::node_interfaces::NodeTopicsInterface::SharedPtr node_topics,
       rclcpp::node_interfaces::NodeTimersInterface::SharedPtr node_timers,
       rclcpp::node_interfaces::NodeClockInterface::SharedPtr node_clock,
+      rclcpp::node_interfaces::NodeWaitablesInterface::SharedPtr
+          node_waitables,
       const ClusterNodeOptions &options);
 
   ~ClusterNodeImpl();
@@ -96,13 +106,42 @@ void reset_entry_buffer();
   void register_on_standby(std::function<void()> callback);
   CommandCommitResponseSharedFuture commit_command(
       Command::SharedPtr command, CommandCommitResponseCallback &callback);
+  void commit_command(Command::SharedPtr command, uint64_t tag,
+                      CommitCompletionQueue::SharedPtr completion_queue);
+  std::vector<CommandCommitResponseSharedFuture> commit_commands(
+      const std::vector<Command::SharedPtr> &commands,
+      CommandCommitResponseCallback &callback);
+  uint64_t create_session_id();
+  CommandCommitResponseSharedFuture commit_command(
+      uint64_t session_id, uint64_t sequence, Command::SharedPtr command,
+      CommandCommitResponseCallback &callback);
+  CommandCommitAwaitable commit(Command::SharedPtr command);
+  void post(std::function<void()> task);
   uint64_t get_commands_size();
 
   Command::SharedPtr get_command(uint64_t id);
+  bool acknowledge_applied(uint64_t id);
+  uint64_t get_applied_commands_size();
 
   void register_on_committed(
       std::function<void(const uint64_t, Command::SharedPtr)> callback);
+  void register_on_committed_batch(
+      std::function<void(const uint64_t,
+                         const std::vector<Command::SharedPtr> &)>
+          callback);
   void register_on_reverted(std::function<void(const uint64_t)> callback);
+  bool kv_get(const std::string &key, std::vector<uint8_t> &value);
+  KVResponseSharedFuture kv_set(const std::string &key,
+                                const std::vector<uint8_t> &value,
+                                KVResponseCallback callback);
+  KVResponseSharedFuture kv_delete(const std::string &key,
+                                   KVResponseCallback callback);
+  KVResponseSharedFuture kv_compare_and_set(
+      const std::string &key, const std::vector<uint8_t> &expected,
+      const std::vector<uint8_t> &value, KVResponseCallback callback);
+  uint64_t kv_watch(const std::string &key, bool prefix,
+                    std::chrono::milliseconds period, KVWatchCallback callback);
+  void kv_unwatch(uint64_t watch_id);
    
  
 
@@ -113,6 +152,11 @@ void reset_entry_buffer();
   void set_deactivated_callback(std::function<void()> callback);
   void set_standby_callback(std::function<void()> callback);
   //akit::failover::foros::raft::StateType get_current_state();
+  KVResponseSharedFuture request_kv(const KVStore::Operation operation,
+                                    const std::string &key,
+                                    const std::vector<uint8_t> &expected,
+                                    const std::vector<uint8_t> &value,
+                                    KVResponseCallback callback);
 
   rclcpp::Logger logger_;
   std::shared_ptr<raft::Context> raft_context_;
@@ -121,6 +165,16 @@ void reset_entry_buffer();
   std::function<void()> activated_callback_;
   std::function<void()> deactivated_callback_;
   std::function<void()> standby_callback_;
+  rclcpp::node_interfaces::NodeBaseInterface::SharedPtr node_base_;
+  rclcpp::node_interfaces::NodeTimersInterface::SharedPtr node_timers_;
+  rclcpp::node_interfaces::NodeClockInterface::SharedPtr node_clock_;
+  rclcpp::node_interfaces::NodeWaitablesInterface::SharedPtr node_waitables_;
+  // runs tasks posted from other threads on the executor
+  std::shared_ptr<TaskQueue> task_queue_;
+  // replicated key-value store, if enabled
+  std::unique_ptr<KVStore> kv_store_;
+  // timers flushing the watches with a period
+  std::map<uint64_t, rclcpp::TimerBase::SharedPtr> kv_watch_timers_;
 
 
  
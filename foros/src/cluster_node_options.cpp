@@ -29,7 +29,14 @@ ClusterNodeOptions::ClusterNodeOptions(rcl_allocator_t allocator)
     : NodeOptions(allocator),
       election_timeout_min_(150),
       election_timeout_max_(3001),
-      temp_directory_(std::filesystem::temp_directory_path()) {}
+      temp_directory_(std::filesystem::temp_directory_path()),
+      storage_type_(StorageType::kLevelDB),
+      delta_encoding_(false),
+      compression_threshold_(0),
+      callback_queue_size_(0),
+      kv_store_(false),
+      kv_snapshot_interval_(1024),
+      commit_forwarding_(false) {}
 
 unsigned int ClusterNodeOptions::election_timeout_min() const {
   return election_timeout_min_;
@@ -58,6 +65,64 @@ ClusterNodeOptions &ClusterNodeOptions::temp_directory(std::string &directory) {
   return *this;
 }
 
+StorageType ClusterNodeOptions::storage_type() const { return storage_type_; }
+
+ClusterNodeOptions &ClusterNodeOptions::storage_type(StorageType type) {
+  storage_type_ = type;
+  return *this;
+}
+
+bool ClusterNodeOptions::delta_encoding() const { return delta_encoding_; }
+
+ClusterNodeOptions &ClusterNodeOptions::delta_encoding(bool enable) {
+  delta_encoding_ = enable;
+  return *this;
+}
+
+uint32_t ClusterNodeOptions::compression_threshold() const {
+  return compression_threshold_;
+}
+
+ClusterNodeOptions &ClusterNodeOptions::compression_threshold(uint32_t size) {
+  compression_threshold_ = size;
+  return *this;
+}
+
+std::size_t ClusterNodeOptions::callback_queue_size() const {
+  return callback_queue_size_;
+}
+
+ClusterNodeOptions &ClusterNodeOptions::callback_queue_size(std::size_t size) {
+  callback_queue_size_ = size;
+  return *this;
+}
+
+bool ClusterNodeOptions::kv_store() const { return kv_store_; }
+
+ClusterNodeOptions &ClusterNodeOptions::kv_store(bool enable) {
+  kv_store_ = enable;
+  return *this;
+}
+
+uint64_t ClusterNodeOptions::kv_snapshot_interval() const {
+  return kv_snapshot_interval_;
+}
+
+ClusterNodeOptions &ClusterNodeOptions::kv_snapshot_interval(
+    uint64_t interval) {
+  kv_snapshot_interval_ = interval;
+  return *this;
+}
+
+bool ClusterNodeOptions::commit_forwarding() const {
+  return commit_forwarding_;
+}
+
+ClusterNodeOptions &ClusterNodeOptions::commit_forwarding(bool enable) {
+  commit_forwarding_ = enable;
+  return *this;
+}
+
 }  // namespace foros
 }  // namespace failover
 }  // namespace akit
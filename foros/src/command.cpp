@@ -16,17 +16,93 @@
 
 #include "akit/failover/foros/command.hpp"
 
+#include <algorithm>
+#include <memory>
+#include <utility>
 #include <vector>
 
+#include "akit/failover/foros/pool_allocator.hpp"
+
 namespace akit {
 namespace failover {
 namespace foros {
 
-Command::Command(std::vector<uint8_t> data) : data_(data) {}
+namespace {
+
+CommandBuffer make_buffer(std::vector<uint8_t> data) {
+  return std::allocate_shared<const std::vector<uint8_t>>(
+      PoolAllocator<std::vector<uint8_t>>(), std::move(data));
+}
 
-Command::Command(const char *data, uint64_t size) : data_(data, data + size) {}
+}  // namespace
+
+bool operator==(const CommandData &lhs, const CommandData &rhs) {
+  return lhs.size() == rhs.size() &&
+         std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+Command::Command(std::vector<uint8_t> data) {
+  if (data.size() <= kSmallDataSize) {
+    auto &small = data_.emplace<SmallData>();
+    std::copy(data.begin(), data.end(), small.bytes_.begin());
+    small.size_ = data.size();
+  } else {
+    data_ = make_buffer(std::move(data));
+  }
+}
+
+Command::Command(const char *data, uint64_t size) {
+  if (size <= kSmallDataSize) {
+    auto &small = data_.emplace<SmallData>();
+    std::copy(data, data + size, small.bytes_.begin());
+    small.size_ = size;
+  } else {
+    data_ = make_buffer(std::vector<uint8_t>(data, data + size));
+  }
+}
 
-const std::vector<uint8_t> &Command::data() const { return data_; }
+Command::Command(CommandBuffer buffer) {
+  // no buffer is empty data
+  if (buffer != nullptr) {
+    data_ = std::move(buffer);
+  }
+}
+
+const std::vector<uint8_t> &Command::data() const {
+  auto small = std::get_if<SmallData>(&data_);
+  if (small == nullptr) {
+    return *std::get<CommandBuffer>(data_);
+  }
+
+  // the command may be read by several threads at once
+  auto vector = std::atomic_load(&small->vector_);
+  if (vector == nullptr) {
+    auto copied = make_buffer(std::vector<uint8_t>(
+        small->bytes_.begin(), small->bytes_.begin() + small->size_));
+    if (std::atomic_compare_exchange_strong(&small->vector_, &vector,
+                                            copied) == true) {
+      vector = copied;
+    }
+  }
+  return *vector;
+}
+
+CommandData Command::view() const {
+  auto small = std::get_if<SmallData>(&data_);
+  if (small == nullptr) {
+    return CommandData(*std::get<CommandBuffer>(data_));
+  }
+  return CommandData(small->bytes_.data(), small->size_);
+}
+
+CommandBuffer Command::buffer() const {
+  auto small = std::get_if<SmallData>(&data_);
+  if (small == nullptr) {
+    return std::get<CommandBuffer>(data_);
+  }
+  return make_buffer(std::vector<uint8_t>(
+      small->bytes_.begin(), small->bytes_.begin() + small->size_));
+}
 
 CommandCommitResponse::CommandCommitResponse(uint64_t id,
                                              Command::SharedPtr command,
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "akit/failover/foros/commit_completion_queue.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+void CommitCompletionQueue::push(const CommitCompletion &completion) {
+  bool notify;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    completions_.push_back(completion);
+    notify = waiters_ > 0;
+  }
+
+  // pushers do not pay for a notification nobody waits for
+  if (notify == true) {
+    condition_.notify_all();
+  }
+}
+
+std::size_t CommitCompletionQueue::drain(
+    std::vector<CommitCompletion> &completions) {
+  completions.clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  completions_.swap(completions);
+  return completions.size();
+}
+
+bool CommitCompletionQueue::wait(std::chrono::nanoseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  waiters_++;
+  auto result = condition_.wait_for(
+      lock, timeout, [this]() { return completions_.empty() == false; });
+  waiters_--;
+  return result;
+}
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_COMMON_BYTE_ORDER_HPP_
+#define AKIT_FAILOVER_FOROS_COMMON_BYTE_ORDER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+class ByteOrder {
+ public:
+  static void encode_big_endian64(char *buffer, uint64_t value) {
+    encode_big_endian(buffer, value, sizeof(uint64_t));
+  }
+
+  static void encode_big_endian32(char *buffer, uint32_t value) {
+    encode_big_endian(buffer, value, sizeof(uint32_t));
+  }
+
+  static uint64_t decode_big_endian64(const char *buffer) {
+    return decode_big_endian(buffer, sizeof(uint64_t));
+  }
+
+  static uint32_t decode_big_endian32(const char *buffer) {
+    return static_cast<uint32_t>(decode_big_endian(buffer, sizeof(uint32_t)));
+  }
+
+ private:
+  static void encode_big_endian(char *buffer, uint64_t value,
+                                const std::size_t size) {
+    for (std::size_t i = size; i > 0; i--) {
+      buffer[i - 1] = static_cast<char>(value & 0xff);
+      value >>= 8;
+    }
+  }
+
+  static uint64_t decode_big_endian(const char *buffer,
+                                    const std::size_t size) {
+    uint64_t value = 0;
+    for (std::size_t i = 0; i < size; i++) {
+      value = (value << 8) | static_cast<uint8_t>(buffer[i]);
+    }
+    return value;
+  }
+};
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_COMMON_BYTE_ORDER_HPP_
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/compression.hpp"
+
+#include <zlib.h>
+
+#include <vector>
+
+#include "common/byte_order.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+bool Compression::compress(const uint8_t *data, const std::size_t size,
+                           std::vector<uint8_t> &compressed) {
+  if (size > UINT32_MAX) {
+    return false;
+  }
+
+  // the fastest level, since commands are compressed on the commit path
+  auto bound = compressBound(size);
+  compressed.resize(kSizeFieldSize + bound);
+  ByteOrder::encode_big_endian32(reinterpret_cast<char *>(compressed.data()),
+                                 size);
+  auto ret = compress2(compressed.data() + kSizeFieldSize, &bound, data, size,
+                       Z_BEST_SPEED);
+  if (ret != Z_OK || kSizeFieldSize + bound >= size) {
+    return false;
+  }
+  compressed.resize(kSizeFieldSize + bound);
+  return true;
+}
+
+bool Compression::decompress(const uint8_t *data, const std::size_t size,
+                             std::vector<uint8_t> &decompressed) {
+  if (size < kSizeFieldSize) {
+    return false;
+  }
+
+  uLongf original_size =
+      ByteOrder::decode_big_endian32(reinterpret_cast<const char *>(data));
+  // deflate can not shrink data further, so a larger size is corrupted
+  if (original_size / kMaxCompressionRatio > size - kSizeFieldSize) {
+    return false;
+  }
+  decompressed.resize(original_size);
+  auto expected_size = original_size;
+  auto ret = uncompress(decompressed.data(), &original_size,
+                        data + kSizeFieldSize, size - kSizeFieldSize);
+  return ret == Z_OK && original_size == expected_size;
+}
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_COMMON_COMPRESSION_HPP_
+#define AKIT_FAILOVER_FOROS_COMMON_COMPRESSION_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+// zlib block compression.
+//   original size in 4 bytes big-endian + zlib stream
+class Compression {
+ public:
+  // Compress the data. Returns false if the output is not smaller than the
+  // data, leaving the output unspecified.
+  static bool compress(const uint8_t *data, const std::size_t size,
+                       std::vector<uint8_t> &compressed);
+
+  // Decompress a block. Returns false if the block is corrupted.
+  static bool decompress(const uint8_t *data, const std::size_t size,
+                         std::vector<uint8_t> &decompressed);
+
+ private:
+  static constexpr std::size_t kSizeFieldSize = sizeof(uint32_t);
+  static constexpr std::size_t kMaxCompressionRatio = 1032;
+};
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_COMMON_COMPRESSION_HPP_
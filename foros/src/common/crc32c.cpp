@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/crc32c.hpp"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define FOROS_CRC32C_X86
+#elif defined(__aarch64__) && defined(__linux__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#define FOROS_CRC32C_ARM64
+#endif
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+namespace {
+
+using ExtendFunction = uint32_t (*)(uint32_t, const uint8_t *, std::size_t);
+
+// reversed Castagnoli polynomial
+constexpr uint32_t kPolynomial = 0x82f63b78;
+
+// tables for slicing by 8 bytes at a time
+using Table = std::array<std::array<uint32_t, 256>, 8>;
+
+Table create_table() {
+  Table table;
+  for (uint32_t i = 0; i < 256; i++) {
+    auto crc = i;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+    }
+    table[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; i++) {
+    for (std::size_t slice = 1; slice < table.size(); slice++) {
+      auto prev = table[slice - 1][i];
+      table[slice][i] = (prev >> 8) ^ table[0][prev & 0xff];
+    }
+  }
+  return table;
+}
+
+uint32_t extend_table(uint32_t crc, const uint8_t *data, std::size_t size) {
+  static const Table table = create_table();
+
+  while (size >= 8) {
+    auto low = crc ^ (static_cast<uint32_t>(data[0]) |
+                      static_cast<uint32_t>(data[1]) << 8 |
+                      static_cast<uint32_t>(data[2]) << 16 |
+                      static_cast<uint32_t>(data[3]) << 24);
+    crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^
+          table[5][(low >> 16) & 0xff] ^ table[4][low >> 24] ^
+          table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^
+          table[0][data[7]];
+    data += 8;
+    size -= 8;
+  }
+  while (size-- > 0) {
+    crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xff];
+  }
+  return crc;
+}
+
+#if defined(FOROS_CRC32C_X86)
+__attribute__((target("sse4.2"))) uint32_t extend_hardware(
+    uint32_t crc, const uint8_t *data, std::size_t size) {
+#if defined(__x86_64__)
+  uint64_t crc64 = crc;
+  while (size >= 8) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    crc64 = _mm_crc32_u64(crc64, value);
+    data += 8;
+    size -= 8;
+  }
+  crc = static_cast<uint32_t>(crc64);
+#endif
+  while (size-- > 0) {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+  return crc;
+}
+
+bool has_hardware() { return __builtin_cpu_supports("sse4.2"); }
+#elif defined(FOROS_CRC32C_ARM64)
+__attribute__((target("+crc"))) uint32_t extend_hardware(
+    uint32_t crc, const uint8_t *data, std::size_t size) {
+  while (size >= 8) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    crc = __crc32cd(crc, value);
+    data += 8;
+    size -= 8;
+  }
+  while (size-- > 0) {
+    crc = __crc32cb(crc, *data++);
+  }
+  return crc;
+}
+
+bool has_hardware() { return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0; }
+#endif
+
+ExtendFunction select_extend() {
+#if defined(FOROS_CRC32C_X86) || defined(FOROS_CRC32C_ARM64)
+  if (has_hardware() == true) {
+    return extend_hardware;
+  }
+#endif
+  return extend_table;
+}
+
+ExtendFunction get_extend() {
+  static const ExtendFunction extend = select_extend();
+  return extend;
+}
+
+}  // namespace
+
+uint32_t CRC32C::extend(const uint32_t crc, const void *data,
+                        const std::size_t size) {
+  return ~get_extend()(~crc, static_cast<const uint8_t *>(data), size);
+}
+
+bool CRC32C::is_accelerated() { return get_extend() != extend_table; }
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
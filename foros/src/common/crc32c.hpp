@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_COMMON_CRC32C_HPP_
+#define AKIT_FAILOVER_FOROS_COMMON_CRC32C_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+// CRC-32C (Castagnoli) checksum.
+// The CRC instructions of SSE4.2 or ARMv8 are used if the CPU has them,
+// otherwise a table is used.
+class CRC32C {
+ public:
+  static uint32_t value(const void *data, const std::size_t size) {
+    return extend(0, data, size);
+  }
+
+  // Extend the checksum of some data with the data following it.
+  static uint32_t extend(const uint32_t crc, const void *data,
+                         const std::size_t size);
+
+  // Return true if the checksum is computed with CPU instructions.
+  static bool is_accelerated();
+};
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_COMMON_CRC32C_HPP_
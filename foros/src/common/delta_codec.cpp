@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/delta_codec.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+bool DeltaCodec::encode(const CommandData &base, const CommandData &data,
+                        std::vector<uint8_t> &delta) {
+  auto limit = std::min(base.size(), data.size());
+
+  std::size_t prefix = 0;
+  while (prefix < limit && base[prefix] == data[prefix]) {
+    prefix++;
+  }
+
+  // the suffix must not overlap the prefix in either of them
+  std::size_t suffix = 0;
+  while (suffix < limit - prefix &&
+         base[base.size() - suffix - 1] == data[data.size() - suffix - 1]) {
+    suffix++;
+  }
+
+  auto middle = data.size() - prefix - suffix;
+  // the sizes take at least two bytes
+  if (middle + 2 >= data.size()) {
+    return false;
+  }
+
+  delta.clear();
+  delta.reserve(middle + 2 * kMaxVarintSize);
+  encode_varint(delta, prefix);
+  encode_varint(delta, suffix);
+  delta.insert(delta.end(), data.begin() + prefix,
+               data.begin() + prefix + middle);
+  return delta.size() < data.size();
+}
+
+bool DeltaCodec::decode(const CommandData &base, const uint8_t *delta,
+                        const std::size_t size, std::vector<uint8_t> &data) {
+  auto end = delta + size;
+  uint64_t prefix;
+  uint64_t suffix;
+  if (decode_varint(delta, end, prefix) == false ||
+      decode_varint(delta, end, suffix) == false ||
+      prefix > base.size() || suffix > base.size() - prefix) {
+    return false;
+  }
+
+  data.clear();
+  data.reserve(prefix + (end - delta) + suffix);
+  data.insert(data.end(), base.begin(), base.begin() + prefix);
+  data.insert(data.end(), delta, end);
+  data.insert(data.end(), base.end() - suffix, base.end());
+  return true;
+}
+
+void DeltaCodec::encode_varint(std::vector<uint8_t> &buffer, uint64_t value) {
+  while (value >= 0x80) {
+    buffer.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<uint8_t>(value));
+}
+
+bool DeltaCodec::decode_varint(const uint8_t *&buffer, const uint8_t *end,
+                               uint64_t &value) {
+  value = 0;
+  for (unsigned int shift = 0; shift < 64 && buffer < end; shift += 7) {
+    auto byte = *buffer++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_COMMON_DELTA_CODEC_HPP_
+#define AKIT_FAILOVER_FOROS_COMMON_DELTA_CODEC_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "akit/failover/foros/command.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+// Encodes data against a base sharing most of its bytes, such as successive
+// snapshots of the same message.
+// A delta keeps only the bytes between the common prefix and suffix.
+//   prefix size in varint + suffix size in varint + middle bytes
+class DeltaCodec {
+ public:
+  // Encode the data against the base. Returns false if the delta is not
+  // smaller than the data, leaving the output unspecified.
+  static bool encode(const CommandData &base, const CommandData &data,
+                     std::vector<uint8_t> &delta);
+
+  // Decode a delta against the base it was encoded with. Returns false if the
+  // delta does not fit the base.
+  static bool decode(const CommandData &base, const uint8_t *delta,
+                     const std::size_t size, std::vector<uint8_t> &data);
+
+ private:
+  static constexpr std::size_t kMaxVarintSize = 10;
+
+  static void encode_varint(std::vector<uint8_t> &buffer, uint64_t value);
+  static bool decode_varint(const uint8_t *&buffer, const uint8_t *end,
+                            uint64_t &value);
+};
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_COMMON_DELTA_CODEC_HPP_
@@ -34,6 +34,7 @@ std::string NodeUtil::get_service_name(const std::string &cluster_name,
 }
 
 const char *NodeUtil::kAppendEntriesServiceName = "/append_entries";
+const char *NodeUtil::kCommitCommandServiceName = "/commit_command";
 const char *NodeUtil::kRequestVoteServiceName = "/request_vote";
 
 }  // namespace foros
@@ -26,6 +26,7 @@ namespace foros {
 class NodeUtil {
  public:
   static const char *kAppendEntriesServiceName;
+  static const char *kCommitCommandServiceName;
   static const char *kRequestVoteServiceName;
 
   static std::string get_node_name(const std::string &cluster_name,
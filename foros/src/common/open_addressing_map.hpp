@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AKIT_FAILOVER_FOROS_COMMON_OPEN_ADDRESSING_MAP_HPP_
+#define AKIT_FAILOVER_FOROS_COMMON_OPEN_ADDRESSING_MAP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+// Hash map of string keys with linear probing over a single slot array. The
+// hash of a key is kept in its slot, so a probe compares the keys only when
+// the hashes are equal.
+template <typename Value>
+class OpenAddressingMap {
+ public:
+  OpenAddressingMap() : size_(0), used_(0) {}
+
+  Value *find(const std::string &key) {
+    auto index = find_index(key, hash(key));
+    return index == kNotFound ? nullptr : &slots_[index].value_;
+  }
+
+  const Value *find(const std::string &key) const {
+    auto index = find_index(key, hash(key));
+    return index == kNotFound ? nullptr : &slots_[index].value_;
+  }
+
+  // Set the value of a key.
+  // Returns true if the key is inserted, false if the value is replaced.
+  bool insert_or_assign(const std::string &key, Value value) {
+    auto key_hash = hash(key);
+    auto index = find_index(key, key_hash);
+    if (index != kNotFound) {
+      slots_[index].value_ = std::move(value);
+      return false;
+    }
+
+    if ((used_ + 1) * kMaxLoadDenominator >
+        slots_.size() * kMaxLoadNumerator) {
+      rehash();
+    }
+
+    // a deleted slot on the probe sequence is reused
+    auto mask = slots_.size() - 1;
+    index = key_hash & mask;
+    while (slots_[index].state_ == kFull) {
+      index = (index + 1) & mask;
+    }
+    auto &slot = slots_[index];
+    if (slot.state_ == kEmpty) {
+      used_++;
+    }
+    slot.state_ = kFull;
+    slot.hash_ = key_hash;
+    slot.key_ = key;
+    slot.value_ = std::move(value);
+    size_++;
+    return true;
+  }
+
+  // Returns true if the key is erased.
+  bool erase(const std::string &key) {
+    auto index = find_index(key, hash(key));
+    if (index == kNotFound) {
+      return false;
+    }
+
+    // the slot is left as deleted so that the probes passing it go on
+    auto &slot = slots_[index];
+    slot.state_ = kDeleted;
+    slot.key_.clear();
+    slot.value_ = Value();
+    size_--;
+    return true;
+  }
+
+  void clear() {
+    slots_.clear();
+    size_ = 0;
+    used_ = 0;
+  }
+
+  std::size_t size() const { return size_; }
+
+  template <typename Function>
+  void for_each(Function function) const {
+    for (auto &slot : slots_) {
+      if (slot.state_ == kFull) {
+        function(slot.key_, slot.value_);
+      }
+    }
+  }
+
+ private:
+  static constexpr std::size_t kInitialCapacity = 16;
+  static constexpr std::size_t kMaxLoadNumerator = 3;
+  static constexpr std::size_t kMaxLoadDenominator = 4;
+  static constexpr std::size_t kNotFound = static_cast<std::size_t>(-1);
+
+  enum SlotState : uint8_t { kEmpty, kFull, kDeleted };
+
+  struct Slot {
+    SlotState state_ = kEmpty;
+    std::size_t hash_ = 0;
+    std::string key_;
+    Value value_;
+  };
+
+  static std::size_t hash(const std::string &key) {
+    return std::hash<std::string>()(key);
+  }
+
+  std::size_t find_index(const std::string &key,
+                         const std::size_t key_hash) const {
+    if (slots_.empty() == true) {
+      return kNotFound;
+    }
+
+    // the load factor keeps an empty slot to end the probe
+    auto mask = slots_.size() - 1;
+    for (auto index = key_hash & mask;; index = (index + 1) & mask) {
+      auto &slot = slots_[index];
+      if (slot.state_ == kEmpty) {
+        return kNotFound;
+      }
+      if (slot.state_ == kFull && slot.hash_ == key_hash && slot.key_ == key) {
+        return index;
+      }
+    }
+  }
+
+  // Grow the slots, or only drop the deleted ones if they take the space.
+  void rehash() {
+    auto capacity = kInitialCapacity;
+    while ((size_ + 1) * 2 > capacity) {
+      capacity *= 2;
+    }
+
+    std::vector<Slot> slots(capacity);
+    auto mask = capacity - 1;
+    for (auto &slot : slots_) {
+      if (slot.state_ != kFull) {
+        continue;
+      }
+      auto index = slot.hash_ & mask;
+      while (slots[index].state_ == kFull) {
+        index = (index + 1) & mask;
+      }
+      slots[index] = std::move(slot);
+    }
+    slots_.swap(slots);
+    used_ = size_;
+  }
+
+  std::vector<Slot> slots_;
+  std::size_t size_;  // number of full slots
+  std::size_t used_;  // number of full and deleted slots
+};
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_COMMON_OPEN_ADDRESSING_MAP_HPP_
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/task_queue.hpp"
+
+#include <rclcpp/exceptions.hpp>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+void TaskQueue::post(Task task, Task cancel) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ == false) {
+      tasks_.emplace_back(std::move(task), std::move(cancel));
+      guard_condition_.trigger();
+      return;
+    }
+  }
+  if (cancel != nullptr) {
+    cancel();
+  }
+}
+
+void TaskQueue::close() {
+  std::vector<Entry> tasks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    tasks.swap(tasks_);
+  }
+  cancel(tasks);
+}
+
+void TaskQueue::cancel(std::vector<Entry> &entries) {
+  for (auto &entry : entries) {
+    if (entry.cancel_ != nullptr) {
+      entry.cancel_();
+    }
+  }
+}
+
+size_t TaskQueue::get_number_of_ready_guard_conditions() { return 1; }
+
+void TaskQueue::add_to_wait_set(rcl_wait_set_t *wait_set) {
+  auto ret = rcl_wait_set_add_guard_condition(
+      wait_set, &guard_condition_.get_rcl_guard_condition(), nullptr);
+  if (ret != RCL_RET_OK) {
+    rclcpp::exceptions::throw_from_rcl_error(
+        ret, "failed to add the task queue to the wait set");
+  }
+}
+
+bool TaskQueue::is_ready(rcl_wait_set_t *wait_set) {
+  auto &guard_condition = guard_condition_.get_rcl_guard_condition();
+  for (size_t i = 0; i < wait_set->size_of_guard_conditions; i++) {
+    if (wait_set->guard_conditions[i] == &guard_condition) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::shared_ptr<void> TaskQueue::take_data() {
+  auto tasks = std::make_shared<std::vector<Entry>>();
+  std::lock_guard<std::mutex> lock(mutex_);
+  tasks->swap(tasks_);
+  return tasks;
+}
+
+void TaskQueue::execute(std::shared_ptr<void> &data) {
+  // tasks posted while these are run wake the executor up again
+  auto tasks = std::static_pointer_cast<std::vector<Entry>>(data);
+  for (auto &task : *tasks) {
+    task.task_();
+  }
+}
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
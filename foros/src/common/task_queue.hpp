@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_COMMON_TASK_QUEUE_HPP_
+#define AKIT_FAILOVER_FOROS_COMMON_TASK_QUEUE_HPP_
+
+#include <rcl/wait.h>
+#include <rclcpp/guard_condition.hpp>
+#include <rclcpp/waitable.hpp>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+// Runs posted tasks on the executor spinning the node. A task can be posted
+// from any thread, and the tasks are run in the order they are posted.
+class TaskQueue final : public rclcpp::Waitable {
+ public:
+  using Task = std::function<void()>;
+
+  TaskQueue() = default;
+
+  // Post a task. If the queue is closed before the task is run, the cancel
+  // task is run instead on the thread closing the queue.
+  void post(Task task, Task cancel = nullptr);
+
+  // Run the cancel tasks of the tasks not run yet, and of the tasks posted
+  // later on the posting thread.
+  void close();
+
+  size_t get_number_of_ready_guard_conditions() override;
+  void add_to_wait_set(rcl_wait_set_t *wait_set) override;
+  bool is_ready(rcl_wait_set_t *wait_set) override;
+  std::shared_ptr<void> take_data() override;
+  void execute(std::shared_ptr<void> &data) override;
+
+ private:
+  class Entry {
+   public:
+    Entry(Task task, Task cancel)
+        : task_(std::move(task)), cancel_(std::move(cancel)) {}
+
+    Task task_;
+    Task cancel_;
+  };
+
+  static void cancel(std::vector<Entry> &entries);
+
+  rclcpp::GuardCondition guard_condition_;
+  std::mutex mutex_;
+  std::vector<Entry> tasks_;
+  bool closed_ = false;
+};
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_COMMON_TASK_QUEUE_HPP_
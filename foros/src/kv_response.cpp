@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "akit/failover/foros/kv_response.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+KVResponse::KVResponse(uint64_t id, bool committed, bool result)
+    : id_(id), committed_(committed), result_(result) {}
+
+uint64_t KVResponse::id() const { return id_; }
+
+bool KVResponse::committed() const { return committed_; }
+
+bool KVResponse::result() const { return result_; }
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
@@ -0,0 +1,702 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "kv_store.hpp"
+
+#include <fcntl.h>
+#include <rclcpp/logging.hpp>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/byte_order.hpp"
+#include "common/crc32c.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+namespace {
+
+// a command of a request begins with the operation, the node id, the request
+// id and the key size
+constexpr std::size_t kRequestHeaderSize = 1 + 4 + 8 + 4;
+
+// a snapshot is the magic, the size of the logs and the count of the entries
+// followed by the entries, the count of the sessions, the sessions and the
+// crc32c of all of them
+const char kSnapshotMagic[] = {'F', 'K', 'V', 'S'};
+constexpr std::size_t kSnapshotHeaderSize = 4 + 8 + 8;
+
+void append_bytes(std::vector<uint8_t> &buffer, const void *data,
+                  const std::size_t size) {
+  auto bytes = static_cast<const uint8_t *>(data);
+  buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void append_uint32(std::vector<uint8_t> &buffer, const uint32_t value) {
+  char bytes[sizeof(uint32_t)];
+  ByteOrder::encode_big_endian32(bytes, value);
+  append_bytes(buffer, bytes, sizeof(bytes));
+}
+
+void append_uint64(std::vector<uint8_t> &buffer, const uint64_t value) {
+  char bytes[sizeof(uint64_t)];
+  ByteOrder::encode_big_endian64(bytes, value);
+  append_bytes(buffer, bytes, sizeof(bytes));
+}
+
+// Reads the fields of a buffer, failing once a field exceeds the buffer.
+class Reader {
+ public:
+  Reader(const CommandData &buffer, const std::size_t size)
+      : data_(reinterpret_cast<const char *>(buffer.data())),
+        size_(size),
+        offset_(0) {}
+
+  bool read_uint32(uint32_t &value) {
+    if (remaining() < sizeof(uint32_t)) {
+      return false;
+    }
+    value = ByteOrder::decode_big_endian32(data_ + offset_);
+    offset_ += sizeof(uint32_t);
+    return true;
+  }
+
+  bool read_uint64(uint64_t &value) {
+    if (remaining() < sizeof(uint64_t)) {
+      return false;
+    }
+    value = ByteOrder::decode_big_endian64(data_ + offset_);
+    offset_ += sizeof(uint64_t);
+    return true;
+  }
+
+  template <typename Bytes>
+  bool read_bytes(Bytes &value, const std::size_t size) {
+    if (remaining() < size) {
+      return false;
+    }
+    value.assign(data_ + offset_, data_ + offset_ + size);
+    offset_ += size;
+    return true;
+  }
+
+  template <typename Bytes>
+  bool read_sized_bytes(Bytes &value) {
+    uint32_t size;
+    return read_uint32(size) && read_bytes(value, size);
+  }
+
+  void skip(const std::size_t size) { offset_ += size; }
+
+  std::size_t remaining() const { return size_ - offset_; }
+
+ private:
+  const char *data_;
+  const std::size_t size_;
+  std::size_t offset_;
+};
+
+bool write_all(const int fd, const std::vector<uint8_t> &data) {
+  std::size_t written = 0;
+  while (written < data.size()) {
+    auto ret = ::write(fd, data.data() + written, data.size() - written);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    written += ret;
+  }
+  return true;
+}
+
+}  // namespace
+
+KVStore::KVStore(const uint32_t node_id, const std::string &snapshot_file,
+                 const uint64_t snapshot_interval,
+                 std::function<bool(uint64_t)> acknowledge_snapshot,
+                 rclcpp::Logger &logger, raft::SessionTable *session_table)
+    : node_id_(node_id),
+      snapshot_file_(snapshot_file),
+      snapshot_interval_(snapshot_interval),
+      acknowledge_snapshot_(acknowledge_snapshot),
+      logger_(logger.get_child("kv_store")),
+      session_table_(session_table),
+      map_(std::make_shared<Map>()),
+      size_(0),
+      snapshot_size_(0),
+      compacted_size_(0),
+      undo_size_(0),
+      next_watch_id_(1),
+      snapshot_pending_(false),
+      reverts_(0) {
+  // requests of a previous run may still be in the logs, so the ids of this
+  // run start from a random point
+  std::random_device random_device;
+  next_request_id_ = static_cast<uint64_t>(random_device()) << 32;
+
+  if (is_persistent() == true && load_snapshot() == true) {
+    RCLCPP_INFO(logger_, "snapshot of %lu logs with %lu keys is loaded",
+                snapshot_size_, map_->size());
+  }
+}
+
+bool KVStore::get(const std::string &key, std::vector<uint8_t> &value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = map_->find(key);
+  if (found == nullptr) {
+    return false;
+  }
+  value = *found;
+  return true;
+}
+
+Command::SharedPtr KVStore::make_request(const Operation operation,
+                                         const std::string &key,
+                                         const std::vector<uint8_t> &expected,
+                                         const std::vector<uint8_t> &value,
+                                         KVResponseCallback callback,
+                                         uint64_t &request_id,
+                                         KVResponseSharedFuture &future) {
+  auto promise = std::make_shared<KVResponsePromise>();
+  future = promise->get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    request_id = next_request_id_++;
+    pending_requests_.emplace(request_id,
+                              PendingRequest{promise, future, callback});
+  }
+
+  std::vector<uint8_t> data;
+  data.reserve(kRequestHeaderSize + key.size() + sizeof(uint32_t) +
+               expected.size() + value.size());
+  data.push_back(static_cast<uint8_t>(operation));
+  append_uint32(data, node_id_);
+  append_uint64(data, request_id);
+  append_uint32(data, key.size());
+  append_bytes(data, key.data(), key.size());
+  if (operation == Operation::kCompareAndSet) {
+    append_uint32(data, expected.size());
+    append_bytes(data, expected.data(), expected.size());
+  }
+  append_bytes(data, value.data(), value.size());
+  auto command = Command::make_shared(std::move(data));
+  command->set_type(CommandType::kKeyValue);
+  return command;
+}
+
+void KVStore::cancel_request(const uint64_t request_id, const uint64_t id) {
+  PendingRequest pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = pending_requests_.find(request_id);
+    if (found == pending_requests_.end()) {
+      return;
+    }
+    pending = std::move(found->second);
+    pending_requests_.erase(found);
+  }
+  complete_request(pending, id, false, false);
+}
+
+uint64_t KVStore::add_watch(const std::string &key, const bool prefix,
+                            KVWatchCallback callback,
+                            std::function<void(uint64_t)> schedule) {
+  auto watch = std::make_shared<Watch>();
+  watch->key_ = key;
+  watch->prefix_ = prefix;
+  watch->callback_ = callback;
+  watch->schedule_ = schedule;
+  watch->scheduled_ = false;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  watch->id_ = next_watch_id_++;
+  watches_.emplace(watch->id_, watch);
+  return watch->id_;
+}
+
+void KVStore::remove_watch(const uint64_t watch_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  watches_.erase(watch_id);
+}
+
+void KVStore::flush_watch(const uint64_t watch_id) {
+  std::vector<KVChange> changes;
+  std::shared_ptr<Watch> watch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = watches_.find(watch_id);
+    if (found == watches_.end()) {
+      return;
+    }
+    watch = found->second;
+    watch->scheduled_ = false;
+    if (watch->changes_.empty() == true) {
+      return;
+    }
+    changes.swap(watch->changes_);
+    watch->indexes_.clear();
+  }
+  watch->callback_(changes);
+}
+
+uint64_t KVStore::snapshot_size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return snapshot_size_;
+}
+
+bool KVStore::is_persistent() const { return snapshot_file_.empty() == false; }
+
+uint64_t KVStore::applied_size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+void KVStore::apply(const uint64_t id, Command::SharedPtr command) {
+  PendingRequest pending;
+  bool result = false;
+  std::vector<std::function<void()>> schedules;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // the log is already in the loaded snapshot
+    if (id < size_) {
+      return;
+    }
+    size_ = id + 1;
+
+    // commands of the application are not requests to this store
+    Request request;
+    if (command != nullptr && command->type() == CommandType::kKeyValue &&
+        decode_request(command->view(), request) == true) {
+      result = apply_request(id, request);
+      if (result == true && watches_.empty() == false) {
+        auto value = map_->find(request.key_);
+        notify_watches(id, request.key_, value, schedules);
+      }
+      if (request.node_id_ == node_id_) {
+        auto found = pending_requests_.find(request.request_id_);
+        if (found != pending_requests_.end()) {
+          pending = std::move(found->second);
+          pending_requests_.erase(found);
+        }
+      }
+    }
+
+    if (snapshot_interval_ > 0 &&
+        size_ - compacted_size_ >= snapshot_interval_) {
+      // the changes of the last interval are kept to be reverted
+      while (undos_.empty() == false && undos_.front().id_ < compacted_size_) {
+        undos_.pop_front();
+      }
+      undo_size_ = std::max(undo_size_, compacted_size_);
+      compacted_size_ = size_;
+      // an interval is skipped while the previous snapshot is being written
+      if (is_persistent() == true && snapshot_pending_ == false) {
+        store_snapshot();
+      }
+    }
+  }
+
+  for (auto &schedule : schedules) {
+    schedule();
+  }
+  if (pending.promise_ != nullptr) {
+    complete_request(pending, id, true, result);
+  }
+}
+
+void KVStore::revert(const uint64_t id) {
+  std::vector<std::function<void()>> schedules;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id >= size_) {
+      return;
+    }
+
+    reverts_++;
+    if (is_persistent() == true && snapshot_size_ > id) {
+      remove_snapshot();
+    }
+
+    if (id < undo_size_) {
+      RCLCPP_INFO(logger_, "rebuilding to revert to %lu before %lu", id,
+                  undo_size_);
+      rebuild_map(id, schedules);
+    }
+
+    while (undos_.empty() == false && undos_.back().id_ >= id) {
+      auto &undo = undos_.back();
+      auto &map = mutable_map();
+      if (undo.existed_ == true) {
+        map.insert_or_assign(undo.key_, std::move(undo.value_));
+      } else {
+        map.erase(undo.key_);
+      }
+      if (watches_.empty() == false) {
+        notify_watches(id, undo.key_, map.find(undo.key_), schedules);
+      }
+      undos_.pop_back();
+    }
+
+    size_ = std::min(size_, id);
+    compacted_size_ = std::min(compacted_size_, id);
+    snapshot_size_ = std::min(snapshot_size_, id);
+  }
+
+  for (auto &schedule : schedules) {
+    schedule();
+  }
+}
+
+bool KVStore::decode_request(const CommandData &data, Request &request) {
+  if (data.size() < kRequestHeaderSize) {
+    return false;
+  }
+
+  request.operation_ = static_cast<Operation>(data[0]);
+  if (request.operation_ != Operation::kSet &&
+      request.operation_ != Operation::kDelete &&
+      request.operation_ != Operation::kCompareAndSet) {
+    return false;
+  }
+
+  Reader reader(data, data.size());
+  reader.skip(1);
+  if (reader.read_uint32(request.node_id_) == false ||
+      reader.read_uint64(request.request_id_) == false ||
+      reader.read_sized_bytes(request.key_) == false) {
+    return false;
+  }
+  if (request.operation_ == Operation::kCompareAndSet &&
+      reader.read_sized_bytes(request.expected_) == false) {
+    return false;
+  }
+  return reader.read_bytes(request.value_, reader.remaining());
+}
+
+bool KVStore::apply_request(const uint64_t id, Request &request) {
+  auto &map = mutable_map();
+  auto current = map.find(request.key_);
+  switch (request.operation_) {
+    case Operation::kDelete:
+      if (current == nullptr) {
+        return false;
+      }
+      break;
+    case Operation::kCompareAndSet:
+      if (current == nullptr || *current != request.expected_) {
+        return false;
+      }
+      break;
+    case Operation::kSet:
+    default:
+      break;
+  }
+
+  undos_.push_back(Undo{id, request.key_, current != nullptr,
+                        current != nullptr ? std::move(*current)
+                                           : std::vector<uint8_t>()});
+  if (request.operation_ == Operation::kDelete) {
+    map.erase(request.key_);
+  } else {
+    map.insert_or_assign(request.key_, std::move(request.value_));
+  }
+  return true;
+}
+
+void KVStore::notify_watches(const uint64_t id, const std::string &key,
+                             const std::vector<uint8_t> *value,
+                             std::vector<std::function<void()>> &schedules) {
+  for (auto &entry : watches_) {
+    auto &watch = *entry.second;
+    if (watch.prefix_ == true
+            ? key.compare(0, watch.key_.size(), watch.key_) != 0
+            : key != watch.key_) {
+      continue;
+    }
+
+    // a burst of changes of a key is coalesced into the latest one
+    auto index = watch.indexes_.find(key);
+    if (index == nullptr) {
+      watch.indexes_.insert_or_assign(key, watch.changes_.size());
+      watch.changes_.push_back(KVChange{key, false, {}, id});
+      index = watch.indexes_.find(key);
+    }
+    auto &change = watch.changes_[*index];
+    change.deleted = value == nullptr;
+    change.value = value == nullptr ? std::vector<uint8_t>() : *value;
+    change.id = id;
+
+    if (watch.scheduled_ == false && watch.schedule_ != nullptr) {
+      watch.scheduled_ = true;
+      schedules.push_back(
+          [schedule = watch.schedule_, id = watch.id_]() { schedule(id); });
+    }
+  }
+}
+
+void KVStore::complete_request(const PendingRequest &pending,
+                               const uint64_t id, const bool committed,
+                               const bool result) {
+  pending.promise_->set_value(KVResponse::make_shared(id, committed, result));
+  if (pending.callback_ != nullptr) {
+    pending.callback_(pending.future_);
+  }
+}
+
+KVStore::Map &KVStore::mutable_map() {
+  // the worker releases its reference under mutex_ once it is written
+  if (map_.use_count() > 1) {
+    map_ = std::make_shared<Map>(*map_);
+  }
+  return *map_;
+}
+
+bool KVStore::load_snapshot() {
+  uint64_t size;
+  std::vector<raft::SessionTable::Entry> sessions;
+  if (read_snapshot(*map_, size, sessions) == false) {
+    map_->clear();
+    return false;
+  }
+  if (session_table_ != nullptr) {
+    session_table_->merge(sessions);
+  }
+
+  size_ = size;
+  snapshot_size_ = size;
+  compacted_size_ = size;
+  undo_size_ = size;
+  return true;
+}
+
+bool KVStore::read_snapshot(
+    Map &map, uint64_t &size,
+    std::vector<raft::SessionTable::Entry> &sessions) {
+  std::ifstream file(snapshot_file_, std::ios::binary);
+  if (file.is_open() == false) {
+    return false;
+  }
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+
+  if (data.size() < kSnapshotHeaderSize + sizeof(uint32_t) ||
+      std::memcmp(data.data(), kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) {
+    RCLCPP_ERROR(logger_, "snapshot is invalid");
+    return false;
+  }
+  auto data_size = data.size() - sizeof(uint32_t);
+  if (CRC32C::value(data.data(), data_size) !=
+      ByteOrder::decode_big_endian32(
+          reinterpret_cast<const char *>(data.data()) + data_size)) {
+    RCLCPP_ERROR(logger_, "snapshot is corrupted");
+    return false;
+  }
+
+  Reader reader(data, data_size);
+  reader.skip(sizeof(kSnapshotMagic));
+  uint64_t count;
+  if (reader.read_uint64(size) == false ||
+      reader.read_uint64(count) == false) {
+    return false;
+  }
+
+  std::string key;
+  std::vector<uint8_t> value;
+  for (uint64_t i = 0; i < count; i++) {
+    if (reader.read_sized_bytes(key) == false ||
+        reader.read_sized_bytes(value) == false) {
+      RCLCPP_ERROR(logger_, "snapshot is truncated");
+      return false;
+    }
+    map.insert_or_assign(key, std::move(value));
+  }
+
+  // a snapshot stored without the sessions ends here
+  uint64_t session_count = 0;
+  if (reader.remaining() > 0 && reader.read_uint64(session_count) == false) {
+    RCLCPP_ERROR(logger_, "snapshot is truncated");
+    return false;
+  }
+  sessions.resize(session_count);
+  for (auto &session : sessions) {
+    if (reader.read_uint64(session.session_id_) == false ||
+        reader.read_uint64(session.sequence_) == false ||
+        reader.read_uint64(session.id_) == false) {
+      RCLCPP_ERROR(logger_, "snapshot is truncated");
+      return false;
+    }
+  }
+  return true;
+}
+
+void KVStore::rebuild_map(const uint64_t id,
+                          std::vector<std::function<void()>> &schedules) {
+  // the snapshot holding reverted logs is already removed
+  auto map = std::make_shared<Map>();
+  uint64_t size = 0;
+  std::vector<raft::SessionTable::Entry> sessions;
+  if (is_persistent() == true && read_snapshot(*map, size, sessions) == false) {
+    map->clear();
+    size = 0;
+  }
+
+  // the watches see the keys which differ from the rebuilt map, and the
+  // changes of the logs applied again later
+  if (watches_.empty() == false) {
+    map_->for_each([&](const std::string &key,
+                       const std::vector<uint8_t> &value) {
+      auto rebuilt = map->find(key);
+      if (rebuilt == nullptr || *rebuilt != value) {
+        notify_watches(id, key, rebuilt, schedules);
+      }
+    });
+    map->for_each([&](const std::string &key,
+                      const std::vector<uint8_t> &value) {
+      if (map_->find(key) == nullptr) {
+        notify_watches(id, key, &value, schedules);
+      }
+    });
+  }
+
+  map_ = map;
+  undos_.clear();
+  size_ = size;
+  snapshot_size_ = size;
+  compacted_size_ = size;
+  undo_size_ = size;
+}
+
+void KVStore::remove_snapshot() {
+  if (unlink(snapshot_file_.c_str()) != 0 && errno != ENOENT) {
+    RCLCPP_ERROR(logger_, "snapshot removal failed: %s",
+                 std::strerror(errno));
+  }
+  snapshot_size_ = 0;
+}
+
+void KVStore::store_snapshot() {
+  // the session table may be ahead of this store while it catches up
+  std::vector<raft::SessionTable::Entry> sessions;
+  if (session_table_ != nullptr) {
+    sessions = session_table_->entries();
+  }
+  sessions.erase(std::remove_if(sessions.begin(), sessions.end(),
+                                [this](const raft::SessionTable::Entry &e) {
+                                  return e.id_ >= size_;
+                                }),
+                 sessions.end());
+
+  // the map is shared with the worker instead of being copied here, so the
+  // logs are applied meanwhile and copy the map only if they change it
+  snapshot_pending_ = true;
+  snapshot_worker_.post([this, map = std::shared_ptr<const Map>(map_),
+                         size = size_, reverts = reverts_,
+                         sessions = std::move(sessions)]() mutable {
+    auto result = write_snapshot(*map, size, sessions);
+    {
+      // released under the lock, so that the map is not changed before
+      std::lock_guard<std::mutex> lock(mutex_);
+      map.reset();
+      snapshot_pending_ = false;
+      // the logs may be reverted meanwhile, and applied again since
+      if (reverts != reverts_) {
+        if (result == true) {
+          remove_snapshot();
+        }
+        result = false;
+      }
+      if (result == true) {
+        snapshot_size_ = size;
+      }
+    }
+
+    // the logs in the snapshot need not be loaded on restart
+    if (result == true && acknowledge_snapshot_ != nullptr) {
+      acknowledge_snapshot_(size);
+    }
+  });
+}
+
+bool KVStore::write_snapshot(
+    const Map &map, const uint64_t size,
+    const std::vector<raft::SessionTable::Entry> &sessions) {
+  std::vector<uint8_t> data;
+  append_bytes(data, kSnapshotMagic, sizeof(kSnapshotMagic));
+  append_uint64(data, size);
+  append_uint64(data, map.size());
+  map.for_each(
+      [&data](const std::string &key, const std::vector<uint8_t> &value) {
+        append_uint32(data, key.size());
+        append_bytes(data, key.data(), key.size());
+        append_uint32(data, value.size());
+        append_bytes(data, value.data(), value.size());
+      });
+
+  append_uint64(data, sessions.size());
+  for (auto &session : sessions) {
+    append_uint64(data, session.session_id_);
+    append_uint64(data, session.sequence_);
+    append_uint64(data, session.id_);
+  }
+  append_uint32(data, CRC32C::value(data.data(), data.size()));
+
+  auto temp_file = snapshot_file_ + ".tmp";
+  auto fd = open(temp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                 0644);
+  if (fd < 0) {
+    RCLCPP_ERROR(logger_, "snapshot failed: %s", std::strerror(errno));
+    return false;
+  }
+  auto result = write_all(fd, data) && fsync(fd) == 0;
+  close(fd);
+
+  // the old snapshot is replaced only once the new one is complete on disk
+  if (result == false ||
+      rename(temp_file.c_str(), snapshot_file_.c_str()) != 0) {
+    RCLCPP_ERROR(logger_, "snapshot failed: %s", std::strerror(errno));
+    unlink(temp_file.c_str());
+    return false;
+  }
+
+  auto directory = std::filesystem::path(snapshot_file_).parent_path();
+  fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+  return true;
+}
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AKIT_FAILOVER_FOROS_KV_STORE_HPP_
+#define AKIT_FAILOVER_FOROS_KV_STORE_HPP_
+
+#include <rclcpp/logger.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "akit/failover/foros/command.hpp"
+#include "akit/failover/foros/kv_response.hpp"
+#include "akit/failover/foros/kv_watch.hpp"
+#include "common/open_addressing_map.hpp"
+#include "raft/log_applier.hpp"
+#include "raft/session_table.hpp"
+#include "raft/storage_worker.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+// Key-value store replicated through the logs. Requests are committed as
+// commands and applied in the order of the logs on every node, so a
+// compare-and-set is decided the same way everywhere.
+class KVStore final : public raft::LogApplier {
+ public:
+  enum class Operation : uint8_t {
+    kSet = 1,
+    kDelete = 2,
+    kCompareAndSet = 3,
+  };
+
+  // The snapshot is not stored if the path is empty. It is written by a
+  // worker thread, and acknowledge_snapshot is called there with the size of
+  // the logs in each stored snapshot. The sessions of the session table are
+  // stored with the snapshot if it is given.
+  KVStore(const uint32_t node_id, const std::string &snapshot_file,
+          const uint64_t snapshot_interval,
+          std::function<bool(uint64_t)> acknowledge_snapshot,
+          rclcpp::Logger &logger,
+          raft::SessionTable *session_table = nullptr);
+
+  bool get(const std::string &key, std::vector<uint8_t> &value);
+
+  // Make the command of a request. The response is completed once the
+  // command is applied, or cancelled if the commit fails.
+  Command::SharedPtr make_request(const Operation operation,
+                                  const std::string &key,
+                                  const std::vector<uint8_t> &expected,
+                                  const std::vector<uint8_t> &value,
+                                  KVResponseCallback callback,
+                                  uint64_t &request_id,
+                                  KVResponseSharedFuture &future);
+  void cancel_request(const uint64_t request_id, const uint64_t id);
+
+  // Watch a key, or the keys beginning with it if prefix is true. The
+  // latest change of each key is kept until the watch is flushed. schedule
+  // is called with the watch id once a change is pending unless a flush is
+  // already scheduled. The ids start from 1.
+  uint64_t add_watch(const std::string &key, const bool prefix,
+                     KVWatchCallback callback,
+                     std::function<void(uint64_t)> schedule);
+  void remove_watch(const uint64_t watch_id);
+  // pass the pending changes of a watch to its callback
+  void flush_watch(const uint64_t watch_id);
+
+  // size of the logs in the stored snapshot
+  uint64_t snapshot_size();
+  bool is_persistent() const;
+
+  uint64_t applied_size() override;
+  void apply(const uint64_t id, Command::SharedPtr command) override;
+  void revert(const uint64_t id) override;
+
+ private:
+  using Map = OpenAddressingMap<std::vector<uint8_t>>;
+
+  struct Request {
+    Operation operation_;
+    uint32_t node_id_;
+    uint64_t request_id_;
+    std::string key_;
+    std::vector<uint8_t> expected_;
+    std::vector<uint8_t> value_;
+  };
+
+  struct PendingRequest {
+    KVResponseSharedPromise promise_;
+    KVResponseSharedFuture future_;
+    KVResponseCallback callback_;
+  };
+
+  struct Watch {
+    uint64_t id_;
+    std::string key_;
+    bool prefix_;
+    KVWatchCallback callback_;
+    std::function<void(uint64_t)> schedule_;
+    bool scheduled_;
+    // latest change of each key in the order of their first changes
+    std::vector<KVChange> changes_;
+    OpenAddressingMap<std::size_t> indexes_;
+  };
+
+  // previous value of a key changed by a log
+  struct Undo {
+    uint64_t id_;
+    std::string key_;
+    bool existed_;
+    std::vector<uint8_t> value_;
+  };
+
+  static bool decode_request(const CommandData &data, Request &request);
+  bool apply_request(const uint64_t id, Request &request);
+  void notify_watches(const uint64_t id, const std::string &key,
+                      const std::vector<uint8_t> *value,
+                      std::vector<std::function<void()>> &schedules);
+  void complete_request(const PendingRequest &pending, const uint64_t id,
+                        const bool committed, const bool result);
+  // Get the map to change, copied first if a snapshot being written shares
+  // it.
+  Map &mutable_map();
+  bool load_snapshot();
+  bool read_snapshot(Map &map, uint64_t &size,
+                     std::vector<raft::SessionTable::Entry> &sessions);
+  // Rebuild the map from the snapshot, or from nothing without one, for a
+  // revert beyond the undos. Guarded by mutex_.
+  void rebuild_map(const uint64_t id,
+                   std::vector<std::function<void()>> &schedules);
+  // Remove the stored snapshot, which holds reverted logs. Guarded by mutex_.
+  void remove_snapshot();
+  // Start storing a snapshot of the applied logs, guarded by mutex_.
+  void store_snapshot();
+  bool write_snapshot(const Map &map, const uint64_t size,
+                      const std::vector<raft::SessionTable::Entry> &sessions);
+
+  const uint32_t node_id_;
+  const std::string snapshot_file_;
+  const uint64_t snapshot_interval_;
+  std::function<bool(uint64_t)> acknowledge_snapshot_;
+  rclcpp::Logger logger_;
+  raft::SessionTable *session_table_;
+
+  std::mutex mutex_;
+  // shared with the snapshot being written, and copied on write meanwhile
+  std::shared_ptr<Map> map_;
+  uint64_t size_;            // size of the applied logs
+  uint64_t snapshot_size_;   // size of the logs in the stored snapshot
+  uint64_t compacted_size_;  // size of the logs when the undos were trimmed
+  std::deque<Undo> undos_;
+  uint64_t undo_size_;  // logs from this size can be reverted
+  uint64_t next_request_id_;
+  std::unordered_map<uint64_t, PendingRequest> pending_requests_;
+  std::map<uint64_t, std::shared_ptr<Watch>> watches_;
+  uint64_t next_watch_id_;
+  bool snapshot_pending_;  // a snapshot is being written
+  uint64_t reverts_;       // a snapshot written across a revert is dropped
+
+  // writes the snapshots, destroyed first to finish the pending one
+  raft::StorageWorker snapshot_worker_;
+};
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_KV_STORE_HPP_
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "akit/failover/foros/pool_allocator.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+namespace akit {
+namespace failover {
+namespace foros {
+
+namespace {
+
+constexpr std::size_t kBlockAlignment = alignof(std::max_align_t);
+constexpr std::size_t kSizeClassCount =
+    BlockPool::kMaxBlockSize / kBlockAlignment;
+constexpr std::size_t kBlocksPerChunk = 64;
+
+std::atomic<bool> pool_enabled(true);
+
+// Free list of one size class. Chunks are never returned to the system.
+class SizeClass {
+ public:
+  void *allocate(const std::size_t block_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_list_ == nullptr) {
+      auto chunk =
+          static_cast<char *>(::operator new(block_size * kBlocksPerChunk));
+      for (std::size_t i = 0; i < kBlocksPerChunk; i++) {
+        push(chunk + i * block_size);
+      }
+    }
+
+    auto block = free_list_;
+    free_list_ = block->next_;
+    return block;
+  }
+
+  void deallocate(void *block) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    push(block);
+  }
+
+ private:
+  struct FreeBlock {
+    FreeBlock *next_;
+  };
+
+  void push(void *block) {
+    auto free_block = static_cast<FreeBlock *>(block);
+    free_block->next_ = free_list_;
+    free_list_ = free_block;
+  }
+
+  std::mutex mutex_;
+  FreeBlock *free_list_ = nullptr;
+};
+
+// Never destroyed, since objects in static storage may release their blocks
+// after the pool would have been destroyed.
+SizeClass *get_size_classes() {
+  static auto size_classes = new SizeClass[kSizeClassCount];
+  return size_classes;
+}
+
+}  // namespace
+
+void *BlockPool::allocate(std::size_t size) {
+  if (size == 0 || size > kMaxBlockSize) {
+    return ::operator new(size);
+  }
+
+  auto index = (size - 1) / kBlockAlignment;
+  // a block of the full size class can be returned to the pool
+  if (pool_enabled == false) {
+    return ::operator new((index + 1) * kBlockAlignment);
+  }
+  return get_size_classes()[index].allocate((index + 1) * kBlockAlignment);
+}
+
+void BlockPool::deallocate(void *block, std::size_t size) noexcept {
+  if (block == nullptr) {
+    return;
+  }
+
+  if (size == 0 || size > kMaxBlockSize) {
+    ::operator delete(block);
+    return;
+  }
+
+  get_size_classes()[(size - 1) / kBlockAlignment].deallocate(block);
+}
+
+void BlockPool::set_enabled(const bool enabled) { pool_enabled = enabled; }
+
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
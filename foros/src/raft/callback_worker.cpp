@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raft/callback_worker.hpp"
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+CallbackWorker::CallbackWorker(std::recursive_mutex &mutex,
+                               const std::size_t capacity,
+                               CommandGetter get_command,
+                               DuplicateChecker is_duplicate)
+    : mutex_(mutex),
+      capacity_(capacity),
+      get_command_(get_command),
+      is_duplicate_(is_duplicate),
+      stopped_(false) {
+  thread_ = std::thread(&CallbackWorker::loop, this);
+}
+
+CallbackWorker::~CallbackWorker() { stop(); }
+
+void CallbackWorker::set_commit_callback(CommitCallback callback) {
+  callbacks_.commit = callback == nullptr
+                          ? nullptr
+                          : std::make_shared<const CommitCallback>(callback);
+}
+
+void CallbackWorker::set_commit_batch_callback(CommitBatchCallback callback) {
+  callbacks_.commit_batch =
+      callback == nullptr
+          ? nullptr
+          : std::make_shared<const CommitBatchCallback>(callback);
+}
+
+void CallbackWorker::set_revert_callback(RevertCallback callback) {
+  callbacks_.revert = callback == nullptr
+                          ? nullptr
+                          : std::make_shared<const RevertCallback>(callback);
+}
+
+void CallbackWorker::reserve(Lock &lock) {
+  if (std::this_thread::get_id() == thread_.get_id()) {
+    return;
+  }
+
+  not_full_.wait(lock, [this]() {
+    return stopped_ == true || events_.size() < capacity_;
+  });
+}
+
+void CallbackWorker::post_commit(const uint64_t id,
+                                 Command::SharedPtr command) {
+  post({EventType::kCommit, id, id + 1,
+        kCommitCallback | kCommitBatchCallback, std::move(command), {}});
+}
+
+void CallbackWorker::post_commits(const uint64_t first_id,
+                                  std::vector<Command::SharedPtr> commands) {
+  auto last = first_id + commands.size();
+  post({EventType::kCommitBatch, first_id, last,
+        kCommitCallback | kCommitBatchCallback, nullptr, std::move(commands)});
+}
+
+void CallbackWorker::post_revert(const uint64_t id) {
+  post({EventType::kRevert, id, id, 0, nullptr, {}});
+}
+
+void CallbackWorker::post_replay(const uint64_t first, const uint64_t last,
+                                 const uint8_t callbacks) {
+  if (first < last) {
+    post({EventType::kReplay, first, last, callbacks, nullptr, {}});
+  }
+}
+
+void CallbackWorker::post(Event event) {
+  // once stopped, events are delivered on the calling thread
+  if (stopped_ == true) {
+    deliver(event, callbacks_);
+    return;
+  }
+
+  events_.push_back(std::move(event));
+  not_empty_.notify_one();
+}
+
+void CallbackWorker::stop() {
+  {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if (stopped_ == true) {
+      return;
+    }
+    stopped_ = true;
+    not_empty_.notify_one();
+    not_full_.notify_all();
+  }
+
+  if (thread_.joinable() == true) {
+    thread_.join();
+  }
+}
+
+void CallbackWorker::loop() {
+  Lock lock(mutex_);
+  while (true) {
+    not_empty_.wait(
+        lock, [this]() { return stopped_ == true || !events_.empty(); });
+    if (events_.empty() == true) {
+      return;
+    }
+
+    auto event = std::move(events_.front());
+    events_.pop_front();
+    not_full_.notify_one();
+
+    // callbacks registered later are not called for events queued earlier
+    auto callbacks = callbacks_;
+    lock.unlock();
+    deliver(event, callbacks);
+    lock.lock();
+  }
+}
+
+void CallbackWorker::deliver(const Event &event, const Callbacks &callbacks) {
+  switch (event.type) {
+    case EventType::kCommit:
+      if (callbacks.commit != nullptr) {
+        (*callbacks.commit)(event.id, event.command);
+      }
+      if (callbacks.commit_batch != nullptr) {
+        (*callbacks.commit_batch)(event.id, {event.command});
+      }
+      break;
+    case EventType::kCommitBatch:
+      if (callbacks.commit != nullptr) {
+        for (std::size_t i = 0; i < event.commands.size(); i++) {
+          (*callbacks.commit)(event.id + i, event.commands[i]);
+        }
+      }
+      if (callbacks.commit_batch != nullptr) {
+        (*callbacks.commit_batch)(event.id, event.commands);
+      }
+      break;
+    case EventType::kRevert:
+      if (callbacks.revert != nullptr) {
+        (*callbacks.revert)(event.id);
+      }
+      break;
+    case EventType::kReplay:
+      replay(event, callbacks);
+      break;
+  }
+}
+
+void CallbackWorker::replay(const Event &event, const Callbacks &callbacks) {
+  auto commit = (event.callbacks & kCommitCallback) != 0
+                    ? callbacks.commit
+                    : nullptr;
+  auto commit_batch = (event.callbacks & kCommitBatchCallback) != 0
+                          ? callbacks.commit_batch
+                          : nullptr;
+
+  std::vector<Command::SharedPtr> commands;
+  auto first_id = event.id;
+  for (auto id = event.id; id < event.last; id++) {
+    auto command = get_command_(id);
+    if (command == nullptr) {
+      break;
+    }
+    auto duplicate = is_duplicate_ != nullptr && is_duplicate_(id);
+    if (commit != nullptr && duplicate == false) {
+      (*commit)(id, command);
+    }
+    if (commit_batch != nullptr) {
+      // a batch has consecutive ids, so it ends before a duplicate
+      if (duplicate == false) {
+        commands.push_back(command);
+      }
+      if (duplicate == true || commands.size() == kMaxReplayBatchSize) {
+        if (commands.empty() == false) {
+          (*commit_batch)(first_id, commands);
+        }
+        first_id = id + 1;
+        commands.clear();
+      }
+    }
+  }
+
+  if (commit_batch != nullptr && commands.empty() == false) {
+    (*commit_batch)(first_id, commands);
+  }
+}
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
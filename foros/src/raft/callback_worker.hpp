@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_CALLBACK_WORKER_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_CALLBACK_WORKER_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "akit/failover/foros/command.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Thread delivering commit and revert events to the application callbacks in
+// the order they are posted, so that slow callbacks do not delay raft.
+//
+// The queue is guarded by the mutex of the callbacks given by the owner, so
+// that events are queued in the same order the owner decides on them. A
+// poster holding the mutex waits for space in reserve(), which releases the
+// mutex meanwhile. The callbacks are called without the mutex.
+class CallbackWorker final {
+ public:
+  using Lock = std::unique_lock<std::recursive_mutex>;
+  using CommitCallback = std::function<void(uint64_t, Command::SharedPtr)>;
+  using CommitBatchCallback =
+      std::function<void(uint64_t, const std::vector<Command::SharedPtr> &)>;
+  using RevertCallback = std::function<void(uint64_t)>;
+  using CommandGetter = std::function<Command::SharedPtr(uint64_t)>;
+  using DuplicateChecker = std::function<bool(uint64_t)>;
+
+  // callbacks a replay is delivered to
+  static constexpr uint8_t kCommitCallback = 1;
+  static constexpr uint8_t kCommitBatchCallback = 2;
+  // maximum number of commands replayed in a batch
+  static constexpr std::size_t kMaxReplayBatchSize = 256;
+
+  // A replay skips the logs which is_duplicate is true for.
+  CallbackWorker(std::recursive_mutex &mutex, const std::size_t capacity,
+                 CommandGetter get_command, DuplicateChecker is_duplicate);
+  ~CallbackWorker();
+
+  // The methods below must be called with the mutex locked.
+
+  void set_commit_callback(CommitCallback callback);
+  void set_commit_batch_callback(CommitBatchCallback callback);
+  void set_revert_callback(RevertCallback callback);
+
+  // Wait until an event can be posted. Callbacks posting more events do not
+  // wait, since that would wait for themselves.
+  void reserve(Lock &lock);
+
+  void post_commit(const uint64_t id, Command::SharedPtr command);
+  void post_commits(const uint64_t first_id,
+                    std::vector<Command::SharedPtr> commands);
+  void post_revert(const uint64_t id);
+  // Commit events of the commands in [first, last) read once delivered, for
+  // the given callbacks.
+  void post_replay(const uint64_t first, const uint64_t last,
+                   const uint8_t callbacks);
+
+  // Deliver the remaining events and stop the thread. The mutex must not be
+  // locked.
+  void stop();
+
+ private:
+  enum class EventType { kCommit, kCommitBatch, kRevert, kReplay };
+
+  struct Event {
+    EventType type;
+    uint64_t id;
+    uint64_t last;
+    uint8_t callbacks;
+    Command::SharedPtr command;
+    std::vector<Command::SharedPtr> commands;
+  };
+
+  // callbacks copied under the mutex to deliver an event
+  struct Callbacks {
+    std::shared_ptr<const CommitCallback> commit;
+    std::shared_ptr<const CommitBatchCallback> commit_batch;
+    std::shared_ptr<const RevertCallback> revert;
+  };
+
+  void post(Event event);
+  void loop();
+  void deliver(const Event &event, const Callbacks &callbacks);
+  void replay(const Event &event, const Callbacks &callbacks);
+
+  std::recursive_mutex &mutex_;
+  const std::size_t capacity_;
+  CommandGetter get_command_;
+  DuplicateChecker is_duplicate_;
+  std::condition_variable_any not_empty_;
+  std::condition_variable_any not_full_;
+  std::deque<Event> events_;
+  Callbacks callbacks_;
+  bool stopped_;
+  std::thread thread_;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_CALLBACK_WORKER_HPP_
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raft/command_header.hpp"
+
+#include "common/byte_order.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+namespace {
+
+// Format: type in 1 byte, with the session flag set if the session id and
+// the sequence follow in 8 bytes each, big-endian.
+constexpr std::size_t kTypeSize = 1;
+constexpr std::size_t kSessionSize = sizeof(uint64_t) * 2;
+constexpr uint8_t kSessionFlag = 0x80;
+
+bool is_valid_type(const uint8_t type) {
+  return type == static_cast<uint8_t>(CommandType::kApplication) ||
+         type == static_cast<uint8_t>(CommandType::kKeyValue);
+}
+
+}  // namespace
+
+CommandHeader::CommandHeader(const Command &command)
+    : type_(command.type()),
+      session_id_(command.session_id()),
+      sequence_(command.sequence()) {}
+
+void CommandHeader::apply(Command &command) const {
+  command.set_type(type_);
+  command.set_session(session_id_, sequence_);
+}
+
+bool CommandHeader::is_default() const {
+  return type_ == CommandType::kApplication && session_id_ == 0;
+}
+
+std::size_t CommandHeader::size() const {
+  return session_id_ == 0 ? kTypeSize : kTypeSize + kSessionSize;
+}
+
+void CommandHeader::encode(uint8_t *buffer) const {
+  buffer[0] = static_cast<uint8_t>(type_);
+  if (session_id_ != 0) {
+    buffer[0] |= kSessionFlag;
+    auto session = reinterpret_cast<char *>(buffer + kTypeSize);
+    ByteOrder::encode_big_endian64(session, session_id_);
+    ByteOrder::encode_big_endian64(session + sizeof(uint64_t), sequence_);
+  }
+}
+
+std::size_t CommandHeader::decode(const uint8_t *data, std::size_t size) {
+  if (size < kTypeSize) {
+    return 0;
+  }
+  auto type = static_cast<uint8_t>(data[0] & ~kSessionFlag);
+  if (is_valid_type(type) == false) {
+    return 0;
+  }
+  type_ = static_cast<CommandType>(type);
+  session_id_ = 0;
+  sequence_ = 0;
+  if ((data[0] & kSessionFlag) == 0) {
+    return kTypeSize;
+  }
+
+  auto session = reinterpret_cast<const char *>(data + kTypeSize);
+  if (size < kTypeSize + kSessionSize ||
+      ByteOrder::decode_big_endian64(session) == 0) {
+    return 0;
+  }
+  session_id_ = ByteOrder::decode_big_endian64(session);
+  sequence_ = ByteOrder::decode_big_endian64(session + sizeof(uint64_t));
+  return kTypeSize + kSessionSize;
+}
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_COMMAND_HEADER_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_COMMAND_HEADER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "akit/failover/foros/command.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Out-of-band fields of a command, stored and replicated next to its data.
+// A header is self-delimiting, so the headers of several entries can be
+// concatenated and decoded in order.
+class CommandHeader {
+ public:
+  CommandHeader() = default;
+  explicit CommandHeader(const Command &command);
+
+  // Set the fields of the command.
+  void apply(Command &command) const;
+
+  // Whether all fields have their default value, in which case the header
+  // does not need to be stored or sent.
+  bool is_default() const;
+
+  std::size_t size() const;
+
+  // Encode the header into a buffer of at least size() bytes.
+  void encode(uint8_t *buffer) const;
+
+  // Decode a header from the data. Returns the size of the header, or 0 if
+  // the data does not start with a valid header.
+  std::size_t decode(const uint8_t *data, std::size_t size);
+
+ private:
+  CommandType type_ = CommandType::kApplication;
+  uint64_t session_id_ = 0;  // 0 if the command is not of a session
+  uint64_t sequence_ = 0;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_COMMAND_HEADER_HPP_
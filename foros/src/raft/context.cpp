@@ -18,6 +18,7 @@
 
 #include <foros_msgs/srv/request_vote.hpp>
 
+#include <algorithm>
 #include <functional>
 #include <iostream>
 #include <memory>
@@ -27,15 +28,63 @@
 #include <utility>
 #include <vector>
 
+#include "akit/failover/foros/pool_allocator.hpp"
+#include "common/crc32c.hpp"
 #include "common/node_util.hpp"
 #include "common/void_callback.hpp"
+#include "raft/command_header.hpp"
 #include "raft/state_machine_interface.hpp"
+#include "raft/storage/leveldb_storage.hpp"
+#include "raft/storage/memory_storage.hpp"
+#include "raft/storage/wal_storage.hpp"
 
 namespace akit {
 namespace failover {
 namespace foros {
 namespace raft {
 
+static_assert(EntryCodec::kDelta ==
+                  foros_msgs::srv::AppendEntries::Request::ENCODING_DELTA,
+              "entry encoding flags must match AppendEntries");
+static_assert(EntryCodec::kCompressed ==
+                  foros_msgs::srv::AppendEntries::Request::ENCODING_COMPRESSED,
+              "entry encoding flags must match AppendEntries");
+
+namespace {
+
+// Get the id of the first entry of a request. The entries end at
+// leader_commit.
+uint64_t get_first_entry_id(
+    const foros_msgs::srv::AppendEntries::Request &request) {
+  uint64_t count = std::max<std::size_t>(request.entries_sizes.size(), 1);
+  return request.leader_commit + 1 - count;
+}
+
+// Decode the headers of the entries of a request, which are sent for all the
+// entries or none of them.
+bool decode_entry_headers(
+    const foros_msgs::srv::AppendEntries::Request &request,
+    std::vector<CommandHeader> &headers) {
+  headers.assign(std::max<std::size_t>(request.entries_sizes.size(), 1),
+                 CommandHeader());
+  auto data = request.entries_headers.data();
+  auto size = request.entries_headers.size();
+  if (size == 0) {
+    return true;
+  }
+  for (auto &header : headers) {
+    auto header_size = header.decode(data, size);
+    if (header_size == 0) {
+      return false;
+    }
+    data += header_size;
+    size -= header_size;
+  }
+  return size == 0;
+}
+
+}  // namespace
+
 Context::Context(
     const std::string &cluster_name, const uint32_t node_id,
     rclcpp::node_interfaces::NodeBaseInterface::SharedPtr node_base,
@@ -44,9 +93,12 @@ Context::Context(
     rclcpp::node_interfaces::NodeTopicsInterface::SharedPtr node_topics,
     rclcpp::node_interfaces::NodeTimersInterface::SharedPtr node_timers,
     rclcpp::node_interfaces::NodeClockInterface::SharedPtr node_clock,
+    rclcpp::node_interfaces::NodeWaitablesInterface::SharedPtr node_waitables,
     const unsigned int election_timeout_min,
     const unsigned int election_timeout_max, const std::string &temp_directory,
-    rclcpp::Logger &logger)
+    rclcpp::Logger &logger, const StorageType storage_type,
+    const EntryCodec &codec, const std::size_t callback_queue_size,
+    const bool commit_forwarding)
     : cluster_name_(cluster_name),
       node_id_(node_id),
       node_base_(node_base),
@@ -54,6 +106,8 @@ Context::Context(
       node_services_(node_services),
       node_timers_(node_timers),
       node_clock_(node_clock),
+      node_waitables_(node_waitables),
+      task_queue_(std::make_shared<TaskQueue>()),
       majority_(0),
       cluster_size_(0),
       election_timeout_min_(election_timeout_min),
@@ -61,14 +115,68 @@ Context::Context(
       random_generator_(random_device_()),
       broadcast_timeout_(election_timeout_min_ / 10),
       broadcast_received_(false),
+      log_applier_(nullptr),
+      notified_size_(0),
       state_machine_interface_(nullptr),
-      logger_(logger.get_child("raft")) {
-  auto db_file = temp_directory + "/foros_" + node_base_->get_name();
-  store_ = std::make_unique<ContextStore>(db_file, logger_);
+      codec_(codec),
+      logger_(logger.get_child("raft")),
+      commit_forwarding_(commit_forwarding),
+      leader_known_(false),
+      leader_id_(0),
+      next_forward_id_(0),
+      // the leader of a forwarded commit may be replaced meanwhile
+      forward_timeout_(election_timeout_max_ * 2) {
+  node_waitables_->add_waitable(task_queue_, nullptr);
+  store_ = std::make_unique<ContextStore>(
+      create_storage(storage_type, temp_directory, codec), logger_);
+  // the sessions of the logs loaded on restart
+  auto size = store_->logs_size();
+  for (auto id = store_->applied_size(); id < size; id++) {
+    auto log = store_->log(id);
+    if (log != nullptr) {
+      session_table_.apply(id, log->command_);
+    }
+  }
   inspector_ = std::make_unique<Inspector>(
       node_base, node_topics, node_timers, node_clock,
       std::bind(&Context::inspector_message_requested, this,
                 std::placeholders::_1));
+  if (callback_queue_size > 0) {
+    callback_worker_ = std::make_unique<CallbackWorker>(
+        callback_mutex_, callback_queue_size,
+        [this](uint64_t id) { return get_command(id); },
+        [this](uint64_t id) { return session_table_.is_duplicate(id); });
+  }
+  if (commit_forwarding_ == true) {
+    forward_timer_ =
+        rclcpp::GenericTimer<rclcpp::VoidCallbackType>::make_shared(
+            node_clock_->get_clock(),
+            std::chrono::milliseconds(forward_timeout_),
+            [this]() { expire_forwarded_commits(); },
+            node_base_->get_context());
+    node_timers_->add_timer(forward_timer_, nullptr);
+  }
+}
+
+Context::~Context() {
+  // pending writes may call back into this context
+  store_->close();
+  node_waitables_->remove_waitable(task_queue_, nullptr);
+  // the completions of the writes are not run anymore, so the commits still
+  // waiting are failed rather than never answered
+  task_queue_->close();
+  auto commit = clear_pending_commit();
+  if (commit != nullptr && commit->log_ != nullptr) {
+    // the log may be durable and replicated already, so it is kept
+    respond_pending_commit(commit, false);
+  }
+  if (forward_timer_ != nullptr) {
+    forward_timer_->cancel();
+  }
+  cancel_forwarded_commits();
+  if (callback_worker_ != nullptr) {
+    callback_worker_->stop();
+  }
 }
 
 void Context::initialize(const std::vector<uint32_t> &cluster_node_ids,
@@ -79,12 +187,37 @@ void Context::initialize(const std::vector<uint32_t> &cluster_node_ids,
   set_state_machine_interface(state_machine_interface);
 }
 
+std::unique_ptr<Storage> Context::create_storage(
+    const StorageType storage_type, const std::string &temp_directory,
+    const EntryCodec &codec) {
+  switch (storage_type) {
+    case StorageType::kMemory:
+      return std::make_unique<MemoryStorage>();
+    case StorageType::kWAL:
+      storage_directory_ =
+          temp_directory + "/foros_wal_" + node_base_->get_name();
+      return std::make_unique<WALStorage>(storage_directory_, logger_, codec);
+    case StorageType::kLevelDB:
+    default:
+      break;
+  }
+
+  storage_directory_ = temp_directory + "/foros_" + node_base_->get_name();
+  return std::make_unique<LevelDBStorage>(storage_directory_, logger_);
+}
+
+const std::string &Context::get_storage_directory() const {
+  return storage_directory_;
+}
+
 void Context::initialize_node() {
   rcl_service_options_t options = rcl_service_get_default_options();
 
-  append_entries_callback_.set(std::bind(
-      &Context::on_append_entries_requested, this, std::placeholders::_1,
-      std::placeholders::_2, std::placeholders::_3));
+  // the response is deferred until the received log is persisted
+  append_entries_callback_.set(
+      [this](const std::shared_ptr<rmw_request_id_t> header,
+             const std::shared_ptr<foros_msgs::srv::AppendEntries::Request>
+                 request) { on_append_entries_requested(header, request); });
 
   append_entries_service_ =
       std::make_shared<rclcpp::Service<foros_msgs::srv::AppendEntries>>(
@@ -111,6 +244,27 @@ void Context::initialize_node() {
   node_services_->add_service(
       std::dynamic_pointer_cast<rclcpp::ServiceBase>(request_vote_service_),
       nullptr);
+
+  if (commit_forwarding_ == false) {
+    return;
+  }
+
+  // the response is deferred until the forwarded command is committed
+  commit_command_callback_.set(
+      [this](const std::shared_ptr<rmw_request_id_t> header,
+             const std::shared_ptr<foros_msgs::srv::CommitCommand::Request>
+                 request) { on_commit_command_requested(header, request); });
+
+  commit_command_service_ =
+      std::make_shared<rclcpp::Service<foros_msgs::srv::CommitCommand>>(
+          node_base_->get_shared_rcl_node_handle(),
+          NodeUtil::get_service_name(cluster_name_, node_id_,
+                                     NodeUtil::kCommitCommandServiceName),
+          commit_command_callback_, options);
+
+  node_services_->add_service(
+      std::dynamic_pointer_cast<rclcpp::ServiceBase>(commit_command_service_),
+      nullptr);
 }
 
 void Context::initialize_other_nodes(
@@ -127,6 +281,7 @@ void Context::initialize_other_nodes(
 
     other_nodes_[id] = std::make_shared<OtherNode>(
         node_base_, node_graph_, node_services_, cluster_name_, id, next_index,
+        codec_,
         std::bind(&Context::on_log_get_request, this, std::placeholders::_1));
   }
 }
@@ -146,9 +301,10 @@ bool Context::update_term(uint64_t term, bool self) {
     return false;
   }
 
-  store_->current_term(term);
-
-  reset_vote();
+  // the new term and the cleared vote are persisted at once
+  store_->hard_state(term, 0, false);
+  store_->reset_vote_received();
+  reset_leader();
   if (self == false) {
     state_machine_interface_->on_new_term_received();
   }
@@ -157,11 +313,16 @@ bool Context::update_term(uint64_t term, bool self) {
 }
 
 void Context::on_append_entries_requested(
-    const std::shared_ptr<rmw_request_id_t>,
-    const std::shared_ptr<foros_msgs::srv::AppendEntries::Request> request,
-    std::shared_ptr<foros_msgs::srv::AppendEntries::Response> response) {
+    const std::shared_ptr<rmw_request_id_t> header,
+    const std::shared_ptr<foros_msgs::srv::AppendEntries::Request> request) {
+  auto response = std::make_shared<foros_msgs::srv::AppendEntries::Response>();
+  auto send_response = [this, header, response](const bool success) {
+    response->success = success;
+    append_entries_service_->send_response(*header, *response);
+  };
+
   if (is_valid_node(request->leader_id) == false) {
-    response->success = false;
+    send_response(false);
     return;
   }
 
@@ -171,64 +332,269 @@ void Context::on_append_entries_requested(
     response->success = false;
   } else {
     update_term(request->term);
+    set_leader(request->leader_id);
     broadcast_received_ = true;
     state_machine_interface_->on_leader_discovered();
   }
 
   if (request->entries.size() == 0) {
-    response->success = false;
+    send_response(false);
     return;
   }
 
-  // commit it since it is first data
-  if (request->leader_commit == 0) {
-    response->success = request_local_commit(request);
+  if (request->entries_sizes.size() > request->leader_commit + 1) {
+    send_response(false);
     return;
   }
 
-  auto log = store_->log(request->prev_log_index);
-  if (log == nullptr) {
-    response->success = false;
-  } else {
-    if (log->term_ != request->prev_log_term) {
-      request_local_rollback(log->id_);
-      response->success = false;
-    } else {
-      response->success = request_local_commit(request);
+  // the first data has no previous log to check
+  if (get_first_entry_id(*request) != 0) {
+    if (request->prev_log_index >= store_->logs_size()) {
+      send_response(false);
+      return;
+    }
+    if (store_->log_term(request->prev_log_index) != request->prev_log_term) {
+      request_local_rollback(request->prev_log_index);
+      send_response(false);
+      return;
     }
   }
+
+  // the leader resends the same entries instead of going back a log
+  if (decode_entries(request) == false) {
+    response->corrupted = true;
+    send_response(false);
+    return;
+  }
+
+  request_local_commit(request, send_response);
 }
 
-bool Context::request_local_commit(
-    const std::shared_ptr<foros_msgs::srv::AppendEntries::Request> request) {
+void Context::request_local_commit(
+    const std::shared_ptr<foros_msgs::srv::AppendEntries::Request> request,
+    std::function<void(const bool)> callback) {
+  auto first_id = get_first_entry_id(*request);
   auto log = store_->log();
 
   if (log != nullptr) {
     if (log->command_ != nullptr && log->id_ == request->leader_commit &&
         log->term_ == request->term) {
-      return true;
+      callback(true);
+      return;
     }
 
-    if (log->id_ >= request->leader_commit) {
-      store_->revert_log(request->leader_commit);
-      invoke_revert_callback(request->leader_commit);
+    if (log->id_ >= first_id) {
+      store_->revert_log(first_id);
+      invoke_revert_callback(first_id);
     }
   }
 
-  log = LogEntry::make_shared(request->leader_commit, request->term,
-                              Command::make_shared(request->entries));
+  // the headers are already checked on decoding the entries
+  std::vector<CommandHeader> headers;
+  decode_entry_headers(*request, headers);
+
+  std::vector<LogEntry::SharedPtr> logs;
+  if (request->entries_sizes.empty() == false) {
+    // a batch is persisted with a single storage write
+    logs.reserve(request->entries_sizes.size());
+    auto data = reinterpret_cast<const char *>(request->entries.data());
+    for (auto size : request->entries_sizes) {
+      logs.push_back(LogEntry::make_shared(first_id + logs.size(),
+                                           request->term,
+                                           Command::make_shared(data, size)));
+      data += size;
+    }
+  } else {
+    // the command shares the entries of the request instead of copying them
+    logs.push_back(LogEntry::make_shared(
+        request->leader_commit, request->term,
+        Command::make_shared(CommandBuffer(request, &request->entries))));
+  }
+  for (std::size_t i = 0; i < logs.size(); i++) {
+    headers[i].apply(*logs[i]->command_);
+  }
+
+  persist_received_logs(logs, callback);
+}
+
+void Context::persist_received_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                                    std::function<void(const bool)> callback) {
+  // Logs of earlier requests still being persisted from the first id are
+  // replaced, since their writes are overwritten by this one on the storage.
+  persisting_logs_.erase(persisting_logs_.lower_bound(logs.front()->id_),
+                         persisting_logs_.end());
+  for (auto &log : logs) {
+    persisting_logs_.emplace(log->id_, log);
+  }
+
+  // the logs are appended and the response is sent on the executor once the
+  // logs are durable, so that the executor keeps serving heartbeats meanwhile
+  auto on_persisted = [this, logs, callback](bool result) {
+    task_queue_->post([this, logs, callback, result]() {
+      callback(append_persisted_logs(logs, result));
+    });
+  };
+  // a follower appends the logs as soon as they are durable, so they are
+  // stored as committed
+  store_->persist_committed_logs(logs, on_persisted);
+}
 
-  if (store_->push_log(log) == false) {
+bool Context::decode_entries(
+    const std::shared_ptr<foros_msgs::srv::AppendEntries::Request> request) {
+  auto batch = request->entries_sizes.empty() == false;
+  uint64_t size = 0;
+  for (auto entry_size : request->entries_sizes) {
+    size += entry_size;
+  }
+  if (batch == true && (size != request->entries.size() ||
+                        request->entries_crcs.size() !=
+                            request->entries_sizes.size() ||
+                        (request->entries_encodings.empty() == false &&
+                         request->entries_encodings.size() !=
+                             request->entries_sizes.size()))) {
+    RCLCPP_ERROR(logger_, "entry sizes of %lu are invalid",
+                 request->leader_commit);
     return false;
   }
 
-  invoke_commit_callback(log);
+  std::vector<CommandHeader> headers;
+  if (decode_entry_headers(*request, headers) == false) {
+    RCLCPP_ERROR(logger_, "entry headers of %lu are invalid",
+                 request->leader_commit);
+    return false;
+  }
+
+  auto encoded = request->entries_encoding != EntryCodec::kRaw;
+  for (auto encoding : request->entries_encodings) {
+    encoded = encoded || encoding != EntryCodec::kRaw;
+  }
+  if (encoded == true && decode_encoded_entries(*request) == false) {
+    RCLCPP_ERROR(logger_, "entries of %lu can not be decoded",
+                 request->leader_commit);
+    return false;
+  }
+
+  if (batch == false) {
+    if (CRC32C::value(request->entries.data(), request->entries.size()) !=
+        request->entries_crc) {
+      RCLCPP_ERROR(logger_, "entry of %lu is corrupted",
+                   request->leader_commit);
+      return false;
+    }
+    return true;
+  }
+
+  // each entry is checked so that the corrupted one is reported
+  auto data = request->entries.data();
+  auto first_id = get_first_entry_id(*request);
+  for (std::size_t i = 0; i < request->entries_sizes.size(); i++) {
+    if (CRC32C::value(data, request->entries_sizes[i]) !=
+        request->entries_crcs[i]) {
+      RCLCPP_ERROR(logger_, "entry of %lu is corrupted", first_id + i);
+      return false;
+    }
+    data += request->entries_sizes[i];
+  }
+  return true;
+}
+
+bool Context::decode_encoded_entries(
+    foros_msgs::srv::AppendEntries::Request &request) {
+  // Each entry is a delta against the previous one, and the first one against
+  // the entry at prev_log_index, which is already checked to match the
+  // leader's one.
+  LogEntry::SharedPtr prev_entry;
+  if (get_first_entry_id(request) > 0) {
+    prev_entry = store_->log(request.prev_log_index);
+  }
+  std::vector<uint8_t> base;
+  auto has_base = prev_entry != nullptr;
+  if (has_base == true) {
+    base = prev_entry->command_->view().to_vector();
+  }
 
+  auto sizes = request.entries_sizes;
+  if (sizes.empty() == true) {
+    sizes.push_back(request.entries.size());
+  }
+  std::vector<uint8_t> entries;
+  std::vector<uint8_t> decoded;
+  auto data = request.entries.data();
+  for (std::size_t i = 0; i < sizes.size(); i++) {
+    auto encoding = request.entries_sizes.empty() == true
+                        ? request.entries_encoding
+                        : request.entries_encodings.empty() == true
+                              ? EntryCodec::kRaw
+                              : request.entries_encodings[i];
+    const CommandData base_data(base);
+    if (EntryCodec::decode(encoding, has_base == true ? &base_data : nullptr,
+                           data, sizes[i], decoded) == false) {
+      return false;
+    }
+    data += sizes[i];
+    sizes[i] = decoded.size();
+    entries.insert(entries.end(), decoded.begin(), decoded.end());
+    base.swap(decoded);
+    has_base = true;
+  }
+
+  request.entries.swap(entries);
+  if (request.entries_sizes.empty() == false) {
+    request.entries_sizes.swap(sizes);
+  }
+  request.entries_encodings.clear();
+  request.entries_encoding = EntryCodec::kRaw;
   return true;
 }
 
+bool Context::append_persisted_logs(
+    const std::vector<LogEntry::SharedPtr> &logs, bool result) {
+  // Only a prefix of the logs is appended, the ones which are not replaced by
+  // a later request meanwhile.
+  std::size_t appended = 0;
+  for (auto &log : logs) {
+    auto persisting = persisting_logs_.find(log->id_);
+    auto replaced =
+        persisting == persisting_logs_.end() || persisting->second != log;
+    if (replaced == false) {
+      persisting_logs_.erase(persisting);
+    }
+    if (result == false) {
+      continue;
+    }
+
+    if (replaced == true) {
+      // the leader may resend a log while it is being persisted, in which
+      // case the same entry is durable and appended by the later request
+      result = persisting != persisting_logs_.end() &&
+               persisting->second->term_ == log->term_;
+      continue;
+    }
+
+    result = store_->append_log(log);
+    if (result == true) {
+      appended++;
+    }
+  }
+
+  // the application is notified of the logs at once
+  invoke_commit_callbacks(logs.data(), appended);
+  return result;
+}
+
 void Context::request_local_rollback(const uint64_t commit_index) {
   store_->revert_log(commit_index);
+  persisting_logs_.erase(persisting_logs_.lower_bound(commit_index),
+                         persisting_logs_.end());
+
+  std::lock_guard<std::recursive_mutex> lock(callback_mutex_);
+  notified_size_ = std::min(notified_size_, commit_index);
+  session_table_.revert(commit_index);
+  if (log_applier_ != nullptr) {
+    log_applier_->revert(commit_index);
+    // the logs before the id which the applier could not undo
+    catch_up_log_applier();
+  }
 }
 
 void Context::on_request_vote_requested(
@@ -308,35 +674,32 @@ void Context::reset_broadcast_timer() {
 }
 
 void Context::vote_for_me() {
-  store_->voted_for(node_id_);
-
-  store_->voted(true);
+  store_->vote(node_id_);
   store_->increase_vote_received();
 }
 
 std::tuple<uint64_t, bool> Context::vote(const uint64_t term, const uint32_t id,
                                          const uint64_t last_data_index,
-                                         const uint64_t) {
-  bool granted = false;
-  auto log = store_->log();
-  auto current_term = store_->current_term();
-
-  if (term >= current_term) {
-    if (store_->voted() == false &&
-        (log == nullptr || log->id_ <= last_data_index)) {
-      store_->voted_for(id);
-      store_->voted(true);
-      granted = true;
-    }
+                                         const uint64_t last_data_term) {
+  auto logs_size = store_->logs_size();
+  auto last_log_term = store_->last_log_term();
+
+  // the candidate's log must be at least as up-to-date as this node's log
+  auto up_to_date = logs_size == 0 || last_data_term > last_log_term ||
+                    (last_data_term == last_log_term &&
+                     logs_size - 1 <= last_data_index);
+  if (up_to_date == false) {
+    return std::make_tuple(store_->current_term(), false);
   }
 
+  auto current_term = term;
+  auto granted = store_->grant_vote(id, current_term);
   return std::make_tuple(current_term, granted);
 }
 
 void Context::reset_vote() {
-  store_->voted_for(0);
+  store_->reset_vote();
   store_->reset_vote_received();
-  store_->voted(false);
 }
 
 void Context::increase_term() { update_term(store_->current_term() + 1, true); }
@@ -355,12 +718,14 @@ void Context::broadcast() {
     log = store_->log();
   }
 
+  OtherNode::AppendEntriesRequestCache request_cache;
   for (auto &node : other_nodes_) {
     node.second->broadcast(
         store_->current_term(), node_id_, log,
         std::bind(&Context::on_broadcast_response, this, std::placeholders::_1,
                   std::placeholders::_2, std::placeholders::_3,
-                  std::placeholders::_4));
+                  std::placeholders::_4),
+        request_cache);
   }
 }
 
@@ -452,10 +817,16 @@ CommandCommitResponseSharedFuture Context::complete_commit(
     CommandCommitResponseSharedFuture future, LogEntry::SharedPtr log,
     bool result, CommandCommitResponseCallback callback) {
   if (result == true) {
-    store_->push_log(log);
     invoke_commit_callback(log);
   }
 
+  return respond_commit(promise, future, log, result, callback);
+}
+
+CommandCommitResponseSharedFuture Context::respond_commit(
+    CommandCommitResponseSharedPromise promise,
+    CommandCommitResponseSharedFuture future, LogEntry::SharedPtr log,
+    bool result, CommandCommitResponseCallback callback) {
   auto response =
       CommandCommitResponse::make_shared(log->id_, log->command_, result);
   promise->set_value(response);
@@ -477,13 +848,35 @@ CommandCommitResponseSharedFuture Context::cancel_commit(
   return future;
 }
 
+void Context::complete_queued_commit(LogEntry::SharedPtr log, bool result,
+                                     const uint64_t tag,
+                                     CommitCompletionQueue &completion_queue) {
+  if (result == true) {
+    invoke_commit_callback(log);
+  }
+
+  completion_queue.push({tag, log->id_, result});
+}
+
 CommandCommitResponseSharedFuture Context::commit_command(
     Command::SharedPtr command, CommandCommitResponseCallback callback) {
+  return propose_command(command, callback, commit_forwarding_);
+}
+
+CommandCommitResponseSharedFuture Context::propose_command(
+    Command::SharedPtr command, CommandCommitResponseCallback callback,
+    const bool forward) {
+  PoolAllocator<CommandCommitResponsePromise> allocator;
   CommandCommitResponseSharedPromise commit_promise =
-      std::make_shared<CommandCommitResponsePromise>();
+      std::allocate_shared<CommandCommitResponsePromise>(
+          allocator, std::allocator_arg, allocator);
   CommandCommitResponseSharedFuture commit_future =
       commit_promise->get_future();
   if (state_machine_interface_->is_leader() == false) {
+    if (forward == true && forward_commit(commit_promise, commit_future,
+                                          command, callback) == true) {
+      return commit_future;
+    }
     return cancel_commit(commit_promise, commit_future, store_->logs_size(),
                          callback);
   }
@@ -492,24 +885,257 @@ CommandCommitResponseSharedFuture Context::commit_command(
                                    command);
 
   if (cluster_size_ <= 1) {
-    return complete_commit(commit_promise, commit_future, log, true, callback);
+    return complete_commit(commit_promise, commit_future, log,
+                           store_->push_log(log), callback);
   }
 
-  if (set_pending_commit(std::make_shared<PendingCommit>(
-          log, commit_promise, commit_future, callback)) == false) {
+  auto commit =
+      PendingCommit::make_shared(log, commit_promise, commit_future, callback);
+  if (set_pending_commit(commit) == false) {
     return cancel_commit(commit_promise, commit_future, log->id_, callback);
   }
 
+  // the log is persisted while it is replicated to the other nodes
+  persist_pending_commit(commit);
+
   return commit_future;
 }
 
+CommandCommitResponseSharedFuture Context::commit_command(
+    const uint64_t session_id, const uint64_t sequence,
+    Command::SharedPtr command, CommandCommitResponseCallback callback) {
+  // the session is set on a copy sharing the data, since the command of the
+  // caller may be committed again with another sequence
+  auto session_command = Command::make_shared(*command);
+  session_command->set_session(session_id, sequence);
+
+  uint64_t id = 0;
+  auto state = SessionTable::SequenceState::kNew;
+  if (state_machine_interface_->is_leader() == true) {
+    state = session_table_.find(session_id, sequence, id);
+  }
+  if (state == SessionTable::SequenceState::kNew) {
+    return commit_command(session_command, callback);
+  }
+
+  CommandCommitResponseSharedPromise commit_promise =
+      std::make_shared<CommandCommitResponsePromise>();
+  CommandCommitResponseSharedFuture commit_future =
+      commit_promise->get_future();
+  if (state == SessionTable::SequenceState::kStale) {
+    // the log of an older sequence is not kept, so it is not known whether
+    // it is committed
+    RCLCPP_WARN(logger_, "sequence %lu of session %lu is stale", sequence,
+                session_id);
+    return cancel_commit(commit_promise, commit_future, store_->logs_size(),
+                         callback);
+  }
+
+  // a retried sequence is answered by the log which committed it
+  commit_promise->set_value(
+      CommandCommitResponse::make_shared(id, session_command, true));
+  if (callback != nullptr) {
+    callback(commit_future);
+  }
+  return commit_future;
+}
+
+void Context::commit_command(
+    Command::SharedPtr command, const uint64_t tag,
+    CommitCompletionQueue::SharedPtr completion_queue) {
+  if (state_machine_interface_->is_leader() == false) {
+    completion_queue->push({tag, store_->logs_size(), false});
+    return;
+  }
+
+  auto log = LogEntry::make_shared(store_->logs_size(), store_->current_term(),
+                                   command);
+
+  if (cluster_size_ <= 1) {
+    complete_queued_commit(log, store_->push_log(log), tag, *completion_queue);
+    return;
+  }
+
+  auto commit = PendingCommit::make_shared(log, tag, completion_queue);
+  if (set_pending_commit(commit) == false) {
+    completion_queue->push({tag, log->id_, false});
+    return;
+  }
+
+  persist_pending_commit(commit);
+}
+
+std::vector<CommandCommitResponseSharedFuture> Context::commit_commands(
+    const std::vector<Command::SharedPtr> &commands,
+    CommandCommitResponseCallback callback) {
+  std::vector<CommandCommitResponseSharedPromise> promises;
+  std::vector<CommandCommitResponseSharedFuture> futures;
+  promises.reserve(commands.size());
+  futures.reserve(commands.size());
+  for (std::size_t i = 0; i < commands.size(); i++) {
+    promises.push_back(std::make_shared<CommandCommitResponsePromise>());
+    futures.push_back(promises.back()->get_future());
+  }
+
+  if (commands.empty() == true) {
+    return futures;
+  }
+
+  auto first_id = store_->logs_size();
+  if (state_machine_interface_->is_leader() == false) {
+    for (std::size_t i = 0; i < commands.size(); i++) {
+      cancel_commit(promises[i], futures[i], first_id + i, callback);
+    }
+    return futures;
+  }
+
+  std::vector<LogEntry::SharedPtr> logs;
+  logs.reserve(commands.size());
+  auto term = store_->current_term();
+  for (auto &command : commands) {
+    logs.push_back(
+        LogEntry::make_shared(first_id + logs.size(), term, command));
+  }
+
+  if (cluster_size_ <= 1) {
+    auto result = store_->push_logs(logs);
+    if (result == true) {
+      invoke_commit_callbacks(logs.data(), logs.size());
+    }
+    for (std::size_t i = 0; i < logs.size(); i++) {
+      respond_commit(promises[i], futures[i], logs[i], result, callback);
+    }
+    return futures;
+  }
+
+  auto commit = PendingCommit::make_shared(logs, promises, futures, callback);
+  if (set_pending_commit(commit) == false) {
+    for (std::size_t i = 0; i < logs.size(); i++) {
+      cancel_commit(promises[i], futures[i], logs[i]->id_, callback);
+    }
+    return futures;
+  }
+
+  // the logs are persisted at once while they are replicated
+  persist_pending_commit(commit);
+
+  return futures;
+}
+
+void Context::persist_pending_commit(
+    const std::shared_ptr<PendingCommit> commit) {
+  // completed on the executor like the responses of the other nodes, so that
+  // the callbacks of the application are not run on the storage thread
+  auto log = commit->log_;
+  auto on_persisted = [this, log](bool result) {
+    task_queue_->post(
+        [this, log, result]() { on_pending_commit_persisted(log, result); });
+  };
+  if (commit->batch_logs_.empty() == true) {
+    store_->persist_log(log, on_persisted);
+  } else {
+    store_->persist_logs(commit->batch_logs_, on_persisted);
+  }
+}
+
+void Context::on_pending_commit_persisted(LogEntry::SharedPtr log,
+                                          bool result) {
+  std::shared_ptr<PendingCommit> commit;
+  {
+    std::lock_guard<std::mutex> lock(pending_commit_mutex_);
+    if (pending_commit_ == nullptr || pending_commit_->log_ != log) {
+      return;
+    }
+
+    commit = pending_commit_;
+    if (result == true) {
+      commit->persisted_ = true;
+      if (is_pending_commit_agreed(commit) == false) {
+        return;
+      }
+      // appended before the pending commit is cleared, so that the next
+      // commit gets the next id
+      result = append_pending_commit(commit);
+    }
+    pending_commit_ = nullptr;
+  }
+
+  finish_pending_commit(commit, result);
+}
+
+bool Context::append_pending_commit(
+    const std::shared_ptr<PendingCommit> commit) {
+  if (commit->batch_logs_.empty() == true) {
+    if (store_->append_log(commit->log_) == false) {
+      return false;
+    }
+  } else {
+    for (auto &log : commit->batch_logs_) {
+      if (store_->append_log(log) == false) {
+        return false;
+      }
+    }
+  }
+
+  // the logs were persisted before they were agreed, so they are kept on a
+  // restart only once the commit size covers them
+  store_->store_commit_size();
+  return true;
+}
+
+bool Context::is_pending_commit_agreed(
+    const std::shared_ptr<PendingCommit> commit) {
+  // this node agrees once the log is durable
+  unsigned int success_count = commit->persisted_ ? 1 : 0;
+  for (auto &node : other_nodes_) {
+    auto it = commit->result_map_.find(node.first);
+    if (it != commit->result_map_.end() && it->second == true) {
+      success_count++;
+    }
+  }
+
+  return success_count >= majority_;
+}
+
+void Context::finish_pending_commit(std::shared_ptr<PendingCommit> commit,
+                                    const bool result) {
+  if (result == false) {
+    store_->truncate_persisted_logs(commit->first_id());
+  }
+  respond_pending_commit(commit, result);
+}
+
+void Context::respond_pending_commit(std::shared_ptr<PendingCommit> commit,
+                                     const bool result) {
+  if (commit->completion_queue_ != nullptr) {
+    complete_queued_commit(commit->log_, result, commit->tag_,
+                           *commit->completion_queue_);
+    return;
+  }
+
+  if (commit->batch_logs_.empty() == true) {
+    complete_commit(commit->promise_, commit->future_, commit->log_, result,
+                    commit->callback_);
+    return;
+  }
+
+  if (result == true) {
+    invoke_commit_callbacks(commit->batch_logs_.data(),
+                            commit->batch_logs_.size());
+  }
+  for (std::size_t i = 0; i < commit->batch_logs_.size(); i++) {
+    respond_commit(commit->batch_promises_[i], commit->batch_futures_[i],
+                   commit->batch_logs_[i], result, commit->callback_);
+  }
+}
+
 std::shared_ptr<PendingCommit> Context::get_pending_commit() {
   std::lock_guard<std::mutex> lock(pending_commit_mutex_);
   if (pending_commit_ == nullptr || pending_commit_->log_ == nullptr) {
     return nullptr;
   }
 
-  if (pending_commit_->log_->id_ != store_->logs_size()) {
+  if (pending_commit_->first_id() != store_->logs_size()) {
     pending_commit_ = nullptr;
     return nullptr;
   }
@@ -518,14 +1144,14 @@ std::shared_ptr<PendingCommit> Context::get_pending_commit() {
 }
 
 bool Context::set_pending_commit(std::shared_ptr<PendingCommit> commit) {
-  if (commit->log_->id_ != store_->logs_size()) {
+  if (commit->first_id() != store_->logs_size()) {
     return false;
   }
 
   std::lock_guard<std::mutex> lock(pending_commit_mutex_);
 
   if (pending_commit_ != nullptr && pending_commit_->log_ != nullptr) {
-    if (pending_commit_->log_->id_ == store_->logs_size()) {
+    if (pending_commit_->first_id() == store_->logs_size()) {
       return false;
     }
   }
@@ -538,8 +1164,7 @@ bool Context::set_pending_commit(std::shared_ptr<PendingCommit> commit) {
 void Context::cancel_pending_commit() {
   auto commit = clear_pending_commit();
   if (commit != nullptr && commit->log_ != nullptr) {
-    complete_commit(commit->promise_, commit->future_, commit->log_, false,
-                    commit->callback_);
+    finish_pending_commit(commit, false);
   }
 }
 
@@ -569,27 +1194,19 @@ void Context::handle_pending_commit_response(const uint32_t id,
     }
     commit->result_map_[id] = success;
 
-    unsigned int received_count = 1;
-    unsigned int success_count = 1;
-    for (auto &node : other_nodes_) {
-      if (commit->result_map_.count(node.first) > 0) {
-        received_count++;
-        if (commit->result_map_[node.first] == success) {
-          success_count++;
-        }
-      }
-    }
-
-    if (success_count < majority_) {
+    // Until the log is durable on this node, the commit is left to
+    // on_pending_commit_persisted, so that a log whose write fails is never
+    // appended.
+    if (commit->persisted_ == false ||
+        is_pending_commit_agreed(commit) == false) {
       return;
     }
 
-    result = true;
+    result = append_pending_commit(commit);
     pending_commit_ = nullptr;
   }
 
-  complete_commit(commit->promise_, commit->future_, commit->log_, result,
-                  commit->callback_);
+  finish_pending_commit(commit, result);
 }
 
 void Context::on_broadcast_response(const uint32_t id,
@@ -604,8 +1221,11 @@ void Context::on_broadcast_response(const uint32_t id,
 
 const std::shared_ptr<LogEntry> Context::on_log_get_request(uint64_t id) {
   auto commit = get_pending_commit();
-  if (commit != nullptr && commit->log_ != nullptr && commit->log_->id_ == id) {
-    return commit->log_;
+  if (commit != nullptr && commit->log_ != nullptr) {
+    auto log = commit->log(id);
+    if (log != nullptr) {
+      return log;
+    }
   }
 
   return store_->log(id);
@@ -624,15 +1244,113 @@ Command::SharedPtr Context::get_command(uint64_t id) {
   return log->command_;
 }
 
+bool Context::acknowledge_applied(const uint64_t id) {
+  if (store_->applied_size(id + 1) == false) {
+    return false;
+  }
+  // the logs are replayed from the applied size
+  session_table_.forget_duplicates(store_->applied_size());
+  return true;
+}
+
+bool Context::acknowledge_snapshot(const uint64_t size) {
+  return store_->snapshot_size(size);
+}
+
+uint64_t Context::get_applied_commands_size() {
+  return store_->applied_size();
+}
+
 void Context::register_on_committed(
     std::function<void(uint64_t, Command::SharedPtr)> callback) {
+  std::unique_lock<std::recursive_mutex> lock(callback_mutex_);
+  if (callback_worker_ != nullptr) {
+    callback_worker_->reserve(lock);
+  }
   set_commit_callback(callback);
+  if (callback == nullptr) {
+    return;
+  }
+
+  // replay the commands which are not acknowledged as applied, including the
+  // ones loaded on restart
+  auto size = store_->logs_size();
+  if (callback_worker_ != nullptr) {
+    callback_worker_->post_replay(store_->applied_size(), size,
+                                  CallbackWorker::kCommitCallback);
+    notified_size_ = size;
+    return;
+  }
+
+  for (auto id = store_->applied_size(); id < size; id++) {
+    auto log = store_->log(id);
+    if (log == nullptr) {
+      break;
+    }
+    if (session_table_.is_duplicate(id) == false) {
+      callback(id, log->command_);
+    }
+  }
+  notified_size_ = size;
+}
+
+void Context::register_on_committed_batch(
+    CallbackWorker::CommitBatchCallback callback) {
+  std::unique_lock<std::recursive_mutex> lock(callback_mutex_);
+  if (callback_worker_ != nullptr) {
+    callback_worker_->reserve(lock);
+  }
+  commit_batch_callback_ = callback;
+  if (callback_worker_ != nullptr) {
+    callback_worker_->set_commit_batch_callback(callback);
+  }
+  if (callback == nullptr) {
+    return;
+  }
+
+  // replay the commands which are not acknowledged as applied in chunks
+  auto size = store_->logs_size();
+  if (callback_worker_ != nullptr) {
+    callback_worker_->post_replay(store_->applied_size(), size,
+                                  CallbackWorker::kCommitBatchCallback);
+    notified_size_ = size;
+    return;
+  }
+
+  std::vector<Command::SharedPtr> commands;
+  auto first_id = store_->applied_size();
+  for (auto id = first_id; id < size; id++) {
+    auto log = store_->log(id);
+    if (log == nullptr) {
+      break;
+    }
+    // a batch has consecutive ids, so it ends before a duplicate
+    auto duplicate = session_table_.is_duplicate(id);
+    if (duplicate == false) {
+      commands.push_back(log->command_);
+    }
+    if (duplicate == true ||
+        commands.size() == CallbackWorker::kMaxReplayBatchSize) {
+      if (commands.empty() == false) {
+        callback(first_id, commands);
+      }
+      first_id = id + 1;
+      commands.clear();
+    }
+  }
+  if (commands.empty() == false) {
+    callback(first_id, commands);
+  }
+  notified_size_ = size;
 }
 
 void Context::set_commit_callback(
     std::function<void(uint64_t, Command::SharedPtr)> callback) {
   std::lock_guard<std::recursive_mutex> lock(callback_mutex_);
   commit_callback_ = callback;
+  if (callback_worker_ != nullptr) {
+    callback_worker_->set_commit_callback(callback);
+  }
 }
 
 void Context::register_on_reverted(std::function<void(uint64_t)> callback) {
@@ -642,20 +1360,316 @@ void Context::register_on_reverted(std::function<void(uint64_t)> callback) {
 void Context::set_revert_callback(std::function<void(uint64_t)> callback) {
   std::lock_guard<std::recursive_mutex> lock(callback_mutex_);
   revert_callback_ = callback;
+  if (callback_worker_ != nullptr) {
+    callback_worker_->set_revert_callback(callback);
+  }
 }
 
-void Context::invoke_commit_callback(LogEntry::SharedPtr log) {
+void Context::set_log_applier(LogApplier *log_applier) {
   std::lock_guard<std::recursive_mutex> lock(callback_mutex_);
-  if (log != nullptr && commit_callback_ != nullptr) {
-    commit_callback_(log->id_, log->command_);
+  log_applier_ = log_applier;
+  if (log_applier == nullptr) {
+    return;
   }
+
+  // the applier catches up with the logs appended before
+  catch_up_log_applier();
 }
 
-void Context::invoke_revert_callback(uint64_t id) {
+void Context::catch_up_log_applier() {
   std::lock_guard<std::recursive_mutex> lock(callback_mutex_);
-  if (revert_callback_ != nullptr) {
-    revert_callback_(id);
+  auto size = store_->logs_size();
+  for (auto id = log_applier_->applied_size(); id < size; id++) {
+    auto log = store_->log(id);
+    if (log == nullptr) {
+      RCLCPP_ERROR(logger_, "log %lu to apply is not loaded", id);
+      break;
+    }
+    if (session_table_.is_duplicate(id) == false) {
+      log_applier_->apply(id, log->command_);
+    }
+  }
+}
+
+SessionTable &Context::get_session_table() { return session_table_; }
+
+void Context::on_commit_command_requested(
+    const std::shared_ptr<rmw_request_id_t> header,
+    const std::shared_ptr<foros_msgs::srv::CommitCommand::Request> request) {
+  auto send_response = [this, header](const uint64_t id, const bool result) {
+    foros_msgs::srv::CommitCommand::Response response;
+    response.id = id;
+    response.result = result;
+    commit_command_service_->send_response(*header, response);
+  };
+
+  auto command = Command::make_shared(std::move(request->command));
+  if (request->header.empty() == false) {
+    CommandHeader command_header;
+    if (command_header.decode(request->header.data(),
+                              request->header.size()) !=
+        request->header.size()) {
+      RCLCPP_ERROR(logger_, "header of a forwarded command is invalid");
+      send_response(0, false);
+      return;
+    }
+    command_header.apply(*command);
+  }
+
+  uint64_t id = 0;
+  auto state = SessionTable::SequenceState::kNew;
+  if (state_machine_interface_->is_leader() == true) {
+    state = session_table_.find(*command, id);
+  }
+  if (state == SessionTable::SequenceState::kCommitted) {
+    // a retried sequence is answered by the log which committed it
+    send_response(id, true);
+    return;
+  }
+  if (state == SessionTable::SequenceState::kStale) {
+    RCLCPP_WARN(logger_, "sequence %lu of session %lu is stale",
+                command->sequence(), command->session_id());
+    send_response(store_->logs_size(), false);
+    return;
+  }
+
+  // not forwarded again, so a stale leader fails instead of relaying it back
+  propose_command(command,
+                  [send_response](CommandCommitResponseSharedFuture future) {
+                    auto response = future.get();
+                    send_response(response->id(), response->result());
+                  },
+                  false);
+}
+
+void Context::set_leader(const uint32_t id) {
+  std::lock_guard<std::mutex> lock(forward_mutex_);
+  leader_known_ = true;
+  leader_id_ = id;
+}
+
+void Context::reset_leader() {
+  // the forwarded commits are kept, as the leader of the previous term may
+  // still commit and respond to them
+  std::lock_guard<std::mutex> lock(forward_mutex_);
+  leader_known_ = false;
+}
+
+void Context::cancel_forwarded_commits() {
+  std::map<uint64_t, ForwardedCommit> commits;
+  {
+    std::lock_guard<std::mutex> lock(forward_mutex_);
+    commits.swap(forwarded_commits_);
+  }
+
+  for (auto &commit : commits) {
+    cancel_commit(commit.second.promise_, commit.second.future_,
+                  store_->logs_size(), commit.second.callback_);
+  }
+}
+
+void Context::expire_forwarded_commits() {
+  auto now = std::chrono::steady_clock::now();
+  std::vector<ForwardedCommit> commits;
+  {
+    std::lock_guard<std::mutex> lock(forward_mutex_);
+    for (auto it = forwarded_commits_.begin();
+         it != forwarded_commits_.end();) {
+      if (it->second.deadline_ > now) {
+        ++it;
+        continue;
+      }
+      commits.push_back(std::move(it->second));
+      it = forwarded_commits_.erase(it);
+    }
+  }
+
+  for (auto &commit : commits) {
+    // the response may be lost while the command is committed, which the
+    // sessions of the applied logs tell
+    uint64_t id = 0;
+    if (session_table_.find(*commit.command_, id) ==
+        SessionTable::SequenceState::kCommitted) {
+      commit.promise_->set_value(
+          CommandCommitResponse::make_shared(id, commit.command_, true));
+      if (commit.callback_ != nullptr) {
+        commit.callback_(commit.future_);
+      }
+      continue;
+    }
+    RCLCPP_WARN(logger_, "forwarded commit is not responded in %u msecs",
+                forward_timeout_);
+    cancel_commit(commit.promise_, commit.future_, store_->logs_size(),
+                  commit.callback_);
+  }
+}
+
+bool Context::forward_commit(CommandCommitResponseSharedPromise promise,
+                             CommandCommitResponseSharedFuture future,
+                             Command::SharedPtr command,
+                             CommandCommitResponseCallback callback) {
+  std::shared_ptr<OtherNode> leader;
+  uint64_t forward_id;
+  {
+    std::lock_guard<std::mutex> lock(forward_mutex_);
+    if (leader_known_ == false || is_valid_node(leader_id_) == false) {
+      return false;
+    }
+    leader = other_nodes_[leader_id_];
+    forward_id = next_forward_id_++;
+    forwarded_commits_.emplace(
+        forward_id,
+        ForwardedCommit{promise, future, command, callback,
+                        std::chrono::steady_clock::now() +
+                            std::chrono::milliseconds(forward_timeout_)});
+  }
+
+  if (leader->forward_commit(
+          command, std::bind(&Context::complete_forwarded_commit, this,
+                             forward_id, std::placeholders::_1,
+                             std::placeholders::_2)) == false) {
+    std::lock_guard<std::mutex> lock(forward_mutex_);
+    forwarded_commits_.erase(forward_id);
+    return false;
+  }
+  return true;
+}
+
+void Context::complete_forwarded_commit(const uint64_t forward_id,
+                                        const uint64_t id, const bool result) {
+  ForwardedCommit commit;
+  {
+    std::lock_guard<std::mutex> lock(forward_mutex_);
+    auto found = forwarded_commits_.find(forward_id);
+    // already failed as the leader did not respond in time
+    if (found == forwarded_commits_.end()) {
+      return;
+    }
+    commit = std::move(found->second);
+    forwarded_commits_.erase(found);
+  }
+
+  commit.promise_->set_value(
+      CommandCommitResponse::make_shared(id, commit.command_, result));
+  if (commit.callback_ != nullptr) {
+    commit.callback_(commit.future_);
+  }
+}
+
+void Context::invoke_commit_callback(LogEntry::SharedPtr log) {
+  if (log == nullptr) {
+    return;
+  }
+  invoke_commit_callbacks(&log, 1);
+}
+
+void Context::invoke_commit_callbacks(const LogEntry::SharedPtr *logs,
+                                      const std::size_t count) {
+  std::unique_lock<std::recursive_mutex> lock(callback_mutex_);
+  // duplicates of committed sequences are skipped by the applier and the
+  // callbacks, and they are rare, so they are looked up only if there are
+  std::size_t duplicates = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    if (session_table_.apply(logs[i]->id_, logs[i]->command_) == false) {
+      duplicates++;
+    }
+  }
+  auto is_duplicate = [&](const std::size_t i) {
+    return duplicates > 0 && session_table_.is_duplicate(logs[i]->id_);
+  };
+  if (log_applier_ != nullptr) {
+    for (std::size_t i = 0; i < count; i++) {
+      if (is_duplicate(i) == false) {
+        log_applier_->apply(logs[i]->id_, logs[i]->command_);
+      }
+    }
+  }
+  if (callback_worker_ != nullptr) {
+    callback_worker_->reserve(lock);
+  }
+  if (commit_callback_ == nullptr && commit_batch_callback_ == nullptr) {
+    return;
+  }
+
+  // a log appended while the callback is registered is already replayed
+  std::size_t first = 0;
+  while (first < count && logs[first]->id_ < notified_size_) {
+    first++;
+  }
+  if (first == count) {
+    return;
+  }
+  notified_size_ = logs[count - 1]->id_ + 1;
+
+  // each run of logs between the duplicates is delivered at once
+  while (first < count) {
+    if (is_duplicate(first) == true) {
+      first++;
+      continue;
+    }
+    auto last = first + 1;
+    while (last < count && is_duplicate(last) == false) {
+      last++;
+    }
+    deliver_commit_callbacks(logs + first, last - first);
+    first = last;
+  }
+}
+
+void Context::deliver_commit_callbacks(const LogEntry::SharedPtr *logs,
+                                       const std::size_t count) {
+  const auto first_id = logs[0]->id_;
+
+  if (callback_worker_ != nullptr) {
+    if (count == 1) {
+      callback_worker_->post_commit(first_id, logs[0]->command_);
+    } else {
+      std::vector<Command::SharedPtr> commands;
+      commands.reserve(count);
+      for (std::size_t i = 0; i < count; i++) {
+        commands.push_back(logs[i]->command_);
+      }
+      callback_worker_->post_commits(first_id, std::move(commands));
+    }
+    return;
+  }
+
+  if (commit_callback_ != nullptr) {
+    for (std::size_t i = 0; i < count; i++) {
+      commit_callback_(logs[i]->id_, logs[i]->command_);
+    }
+  }
+  if (commit_batch_callback_ != nullptr) {
+    std::vector<Command::SharedPtr> commands;
+    commands.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+      commands.push_back(logs[i]->command_);
+    }
+    commit_batch_callback_(first_id, commands);
+  }
+}
+
+void Context::invoke_revert_callback(uint64_t id) {
+  std::unique_lock<std::recursive_mutex> lock(callback_mutex_);
+  if (callback_worker_ != nullptr) {
+    callback_worker_->reserve(lock);
+  }
+
+  notified_size_ = std::min(notified_size_, id);
+  session_table_.revert(id);
+  if (log_applier_ != nullptr) {
+    log_applier_->revert(id);
+    // the logs before the id which the applier could not undo
+    catch_up_log_applier();
+  }
+  if (revert_callback_ == nullptr) {
+    return;
+  }
+  if (callback_worker_ != nullptr) {
+    callback_worker_->post_revert(id);
+    return;
   }
+  revert_callback_(id);
 }
 
 void Context::inspector_message_requested(
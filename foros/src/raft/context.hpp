@@ -18,6 +18,7 @@
 #define AKIT_FAILOVER_FOROS_RAFT_CONTEXT_HPP_
 
 #include <foros_msgs/srv/append_entries.hpp>
+#include <foros_msgs/srv/commit_command.hpp>
 #include <foros_msgs/srv/request_vote.hpp>
 #include <rclcpp/any_service_callback.hpp>
 #include <rclcpp/logger.hpp>
@@ -26,8 +27,10 @@
 #include <rclcpp/node_interfaces/node_graph_interface.hpp>
 #include <rclcpp/node_interfaces/node_services_interface.hpp>
 #include <rclcpp/node_interfaces/node_timers_interface.hpp>
+#include <rclcpp/node_interfaces/node_waitables_interface.hpp>
 #include <rclcpp/timer.hpp>
 
+#include <chrono>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -36,13 +39,21 @@
 #include <tuple>
 #include <vector>
 
+#include "akit/failover/foros/cluster_node_options.hpp"
 #include "akit/failover/foros/command.hpp"
+#include "akit/failover/foros/commit_completion_queue.hpp"
+#include "common/task_queue.hpp"
+#include "raft/callback_worker.hpp"
 #include "raft/commit_info.hpp"
 #include "raft/context_store.hpp"
+#include "raft/entry_codec.hpp"
 #include "raft/inspector.hpp"
+#include "raft/log_applier.hpp"
 #include "raft/other_node.hpp"
 #include "raft/pending_commit.hpp"
+#include "raft/session_table.hpp"
 #include "raft/state_machine_interface.hpp"
+#include "raft/storage.hpp"
 
 namespace akit {
 namespace failover {
@@ -59,9 +70,16 @@ class Context {
       rclcpp::node_interfaces::NodeTopicsInterface::SharedPtr node_topics,
       rclcpp::node_interfaces::NodeTimersInterface::SharedPtr node_timers,
       rclcpp::node_interfaces::NodeClockInterface::SharedPtr node_clock,
+      rclcpp::node_interfaces::NodeWaitablesInterface::SharedPtr
+          node_waitables,
       const unsigned int election_timeout_min,
       const unsigned int election_timeout_max,
-      const std::string &temp_directory, rclcpp::Logger &logger);
+      const std::string &temp_directory, rclcpp::Logger &logger,
+      const StorageType storage_type = StorageType::kLevelDB,
+      const EntryCodec &codec = EntryCodec(),
+      const std::size_t callback_queue_size = 0,
+      const bool commit_forwarding = false);
+  ~Context();
 
   void initialize(const std::vector<uint32_t> &cluster_node_ids,
                   StateMachineInterface *state_machine_interface);
@@ -80,12 +98,32 @@ class Context {
   void request_vote();
   CommandCommitResponseSharedFuture commit_command(
       Command::SharedPtr command, CommandCommitResponseCallback callback);
+  CommandCommitResponseSharedFuture commit_command(
+      const uint64_t session_id, const uint64_t sequence,
+      Command::SharedPtr command, CommandCommitResponseCallback callback);
+  void commit_command(Command::SharedPtr command, const uint64_t tag,
+                      CommitCompletionQueue::SharedPtr completion_queue);
+  std::vector<CommandCommitResponseSharedFuture> commit_commands(
+      const std::vector<Command::SharedPtr> &commands,
+      CommandCommitResponseCallback callback);
   void cancel_pending_commit();
   uint64_t get_commands_size();
   Command::SharedPtr get_command(uint64_t id);
+  bool acknowledge_applied(const uint64_t id);
+  // Acknowledge the size of the logs kept in the snapshot of the log applier.
+  // The logs after it are loaded on restart even if the application has
+  // applied them.
+  bool acknowledge_snapshot(const uint64_t size);
+  uint64_t get_applied_commands_size();
   void register_on_committed(
       std::function<void(const uint64_t, Command::SharedPtr)> callback);
+  void register_on_committed_batch(
+      CallbackWorker::CommitBatchCallback callback);
   void register_on_reverted(std::function<void(const uint64_t)> callback);
+  void set_log_applier(LogApplier *log_applier);
+  SessionTable &get_session_table();
+  // directory holding the persistent logs, empty for the memory storage
+  const std::string &get_storage_directory() const;
 
 
   /////////////////syc/ ///////////////
@@ -105,6 +143,9 @@ class Context {
 
 
   void initialize_node();
+  std::unique_ptr<Storage> create_storage(const StorageType storage_type,
+                                          const std::string &temp_directory,
+                                          const EntryCodec &codec);
   void initialize_other_nodes(const std::vector<uint32_t> &cluster_node_ids);
   void set_cluster_size(uint32_t size);
   void set_state_machine_interface(
@@ -114,7 +155,15 @@ class Context {
   bool is_valid_node(uint32_t id);
 
   void invoke_commit_callback(LogEntry::SharedPtr log);
+  void invoke_commit_callbacks(const LogEntry::SharedPtr *logs,
+                               const std::size_t count);
+  // deliver consecutive logs to the commit callbacks, with callback_mutex_
+  // locked
+  void deliver_commit_callbacks(const LogEntry::SharedPtr *logs,
+                                const std::size_t count);
   void invoke_revert_callback(uint64_t id);
+  // apply the logs from the applied size of the log applier to it
+  void catch_up_log_applier();
 
   // Voting methods
   std::tuple<uint64_t, bool> vote(const uint64_t term, const uint32_t id,
@@ -131,11 +180,19 @@ class Context {
   // Data replication methods
   void on_append_entries_requested(
       const std::shared_ptr<rmw_request_id_t> header,
-      const std::shared_ptr<foros_msgs::srv::AppendEntries::Request> request,
-      std::shared_ptr<foros_msgs::srv::AppendEntries::Response> response);
+      const std::shared_ptr<foros_msgs::srv::AppendEntries::Request> request);
   uint32_t request_remote_commit(const Command::SharedPtr command);
-  bool request_local_commit(
+  void request_local_commit(
+      const std::shared_ptr<foros_msgs::srv::AppendEntries::Request> request,
+      std::function<void(const bool)> callback);
+  bool decode_entries(
       const std::shared_ptr<foros_msgs::srv::AppendEntries::Request> request);
+  bool decode_encoded_entries(
+      foros_msgs::srv::AppendEntries::Request &request);
+  void persist_received_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                             std::function<void(const bool)> callback);
+  bool append_persisted_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                             bool result);
   void request_local_rollback(const uint64_t commit_index);
   void on_broadcast_response(const uint32_t id, const uint64_t commit_index,
                              const uint64_t term, const bool success);
@@ -143,15 +200,30 @@ class Context {
       CommandCommitResponseSharedPromise promise,
       CommandCommitResponseSharedFuture future, LogEntry::SharedPtr log,
       bool result, CommandCommitResponseCallback callback);
+  CommandCommitResponseSharedFuture respond_commit(
+      CommandCommitResponseSharedPromise promise,
+      CommandCommitResponseSharedFuture future, LogEntry::SharedPtr log,
+      bool result, CommandCommitResponseCallback callback);
   CommandCommitResponseSharedFuture cancel_commit(
       CommandCommitResponseSharedPromise promise,
       CommandCommitResponseSharedFuture future, uint64_t id,
       CommandCommitResponseCallback callback);
+  void complete_queued_commit(LogEntry::SharedPtr log, bool result,
+                              const uint64_t tag,
+                              CommitCompletionQueue &completion_queue);
   std::shared_ptr<PendingCommit> get_pending_commit();
   bool set_pending_commit(std::shared_ptr<PendingCommit> commit);
   void handle_pending_commit_response(const uint32_t id,
                                       const uint64_t commit_index,
                                       const uint64_t term, const bool success);
+  void persist_pending_commit(const std::shared_ptr<PendingCommit> commit);
+  void on_pending_commit_persisted(LogEntry::SharedPtr log, bool result);
+  bool append_pending_commit(const std::shared_ptr<PendingCommit> commit);
+  bool is_pending_commit_agreed(const std::shared_ptr<PendingCommit> commit);
+  void finish_pending_commit(std::shared_ptr<PendingCommit> commit,
+                             const bool result);
+  void respond_pending_commit(std::shared_ptr<PendingCommit> commit,
+                              const bool result);
   const std::shared_ptr<LogEntry> on_log_get_request(uint64_t id);
   void inspector_message_requested(foros_msgs::msg::Inspector::SharedPtr msg);
 
@@ -161,6 +233,33 @@ class Context {
       std::function<void(uint64_t, Command::SharedPtr)> callback);
   void set_revert_callback(std::function<void(uint64_t)> callback);
 
+  // Commit forwarding methods
+  struct ForwardedCommit {
+    CommandCommitResponseSharedPromise promise_;
+    CommandCommitResponseSharedFuture future_;
+    Command::SharedPtr command_;
+    CommandCommitResponseCallback callback_;
+    // failed if the leader does not respond by then
+    std::chrono::steady_clock::time_point deadline_;
+  };
+
+  CommandCommitResponseSharedFuture propose_command(
+      Command::SharedPtr command, CommandCommitResponseCallback callback,
+      const bool forward);
+  void on_commit_command_requested(
+      const std::shared_ptr<rmw_request_id_t> header,
+      const std::shared_ptr<foros_msgs::srv::CommitCommand::Request> request);
+  void set_leader(const uint32_t id);
+  void reset_leader();
+  void cancel_forwarded_commits();
+  void expire_forwarded_commits();
+  bool forward_commit(CommandCommitResponseSharedPromise promise,
+                      CommandCommitResponseSharedFuture future,
+                      Command::SharedPtr command,
+                      CommandCommitResponseCallback callback);
+  void complete_forwarded_commit(const uint64_t forward_id, const uint64_t id,
+                                 const bool result);
+
   const std::string cluster_name_;
   uint32_t node_id_;
   
@@ -170,6 +269,13 @@ class Context {
   rclcpp::node_interfaces::NodeServicesInterface::SharedPtr node_services_;
   rclcpp::node_interfaces::NodeTimersInterface::SharedPtr node_timers_;
   rclcpp::node_interfaces::NodeClockInterface::SharedPtr node_clock_;
+  rclcpp::node_interfaces::NodeWaitablesInterface::SharedPtr node_waitables_;
+
+  // runs the completions of storage writes on the executor
+  std::shared_ptr<TaskQueue> task_queue_;
+  // Received logs being persisted by id, accessed only on the executor. A log
+  // replaced here by a later request is not appended once it is persisted.
+  std::map<uint64_t, LogEntry::SharedPtr> persisting_logs_;
 
   rclcpp::Service<foros_msgs::srv::AppendEntries>::SharedPtr
       append_entries_service_;
@@ -179,9 +285,14 @@ class Context {
       request_vote_service_;
   rclcpp::AnyServiceCallback<foros_msgs::srv::RequestVote>
       request_vote_callback_;
+  rclcpp::Service<foros_msgs::srv::CommitCommand>::SharedPtr
+      commit_command_service_;
+  rclcpp::AnyServiceCallback<foros_msgs::srv::CommitCommand>
+      commit_command_callback_;
 
   std::map<uint32_t, std::shared_ptr<OtherNode>> other_nodes_;
 
+  std::string storage_directory_;        // directory of the raft data store
   std::unique_ptr<ContextStore> store_;  // raft data store
 
   uint32_t majority_;                  // number of majority of the full cluster
@@ -200,13 +311,37 @@ class Context {
   std::mutex pending_commit_mutex_;
   std::shared_ptr<PendingCommit> pending_commit_;
   std::function<void(uint64_t, Command::SharedPtr)> commit_callback_;
+  CallbackWorker::CommitBatchCallback commit_batch_callback_;
+  // applied before the callbacks, guarded by callback_mutex_
+  LogApplier *log_applier_;
+  // sequences committed by the client sessions, applied with the logs
+  SessionTable session_table_;
   std::function<void(uint64_t)> revert_callback_;
+  // size of the logs passed to the commit callback, guarded by callback_mutex_
+  uint64_t notified_size_;
 
   StateMachineInterface *state_machine_interface_;
 
+  // encoder of replicated and stored entries
+  const EntryCodec codec_;
+
   rclcpp::Logger logger_;
 
   std::recursive_mutex callback_mutex_;
+  // delivers the callbacks on its own thread if a queue size is given
+  std::unique_ptr<CallbackWorker> callback_worker_;
+
+  // commits of a follower are relayed to the leader if enabled
+  const bool commit_forwarding_;
+  std::mutex forward_mutex_;
+  bool leader_known_;  // whether leader_id_ is the leader of this term
+  uint32_t leader_id_;
+  uint64_t next_forward_id_;
+  // commits waiting for the response of the leader, which may still commit
+  // them after the term changes
+  std::map<uint64_t, ForwardedCommit> forwarded_commits_;
+  unsigned int forward_timeout_;  // forwarded commit timeout in msecs
+  rclcpp::TimerBase::SharedPtr forward_timer_;  // forwarded commit timer
 
   std::unique_ptr<Inspector> inspector_;
 };
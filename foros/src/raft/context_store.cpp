@@ -16,360 +16,451 @@
 
 #include "raft/context_store.hpp"
 
-#include <leveldb/db.h>
 #include <rclcpp/logging.hpp>
 
+#include <algorithm>
+#include <functional>
+#include <future>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "raft/storage/leveldb_storage.hpp"
+
 namespace akit {
 namespace failover {
 namespace foros {
 namespace raft {
 
 ContextStore::ContextStore(const std::string &path, rclcpp::Logger &logger)
-    : current_term_(0),
+    : ContextStore(std::make_unique<LevelDBStorage>(path, logger), logger) {}
+
+ContextStore::ContextStore(std::unique_ptr<Storage> storage,
+                           rclcpp::Logger &logger)
+    : storage_(std::move(storage)),
+      current_term_(0),
       voted_for_(0),
       voted_(false),
       vote_received_(0),
+      applied_size_(0),
+      snapshot_size_(kNoSnapshot),
+      applied_size_queued_(false),
+      commit_size_queued_(false),
+      logs_(nullptr),
+      log_epoch_(0),
+      persisted_commit_size_(0),
       logger_(logger.get_child("raft")) {
-  leveldb::Options options;
-  options.create_if_missing = true;
-
-  auto status = leveldb::DB::Open(options, path, &db_);
-
-  if (status.ok() == false || db_ == nullptr) {
-    RCLCPP_ERROR(logger_, "db open failed: %s", status.ToString().c_str());
-    return;
+  for (auto &readers : log_readers_) {
+    readers.store(0);
   }
+  auto state = storage_->load_hard_state();
+  current_term_ = state.term_;
+  voted_for_ = state.voted_for_;
+  voted_ = state.voted_;
 
-  init_current_term();
-  init_voted_for();
-  init_voted();
-  init_logs();
+  load_logs();
 }
 
-ContextStore::~ContextStore() {
-  if (db_ != nullptr) {
-    delete db_;
+void ContextStore::load_logs() {
+  auto size = storage_->load_logs_size();
+  auto applied_size = std::min(storage_->load_applied_size(), size);
+
+  // Logs persisted by a leader but never agreed are discarded, as they were
+  // never appended. The applied logs are committed even if the commit size
+  // was not stored yet.
+  auto commit_size = std::max(storage_->load_commit_size(), applied_size);
+  if (commit_size < size) {
+    RCLCPP_INFO(logger_, "discarding %lu logs which are not committed",
+                size - commit_size);
+    if (storage_->truncate_logs(commit_size) == true) {
+      size = commit_size;
+    }
   }
-}
 
-bool ContextStore::current_term(const uint64_t term) {
-  std::lock_guard<std::mutex> lock(store_mutex_);
-  current_term_ = term;
+  // The applied logs are skipped if the stored index has their terms. The
+  // index is stored before the logs, so it never misses a run of them.
+  TermIndex stored_index;
+  stored_index.reset(storage_->load_term_index(), size);
+  auto &runs = stored_index.runs();
+  auto first_id = applied_size;
+  if (runs.empty() == true || runs.front().first_id_ != 0) {
+    first_id = 0;
+  }
 
-  if (db_ == nullptr) {
-    //RCLCPP_ERROR(logger_, "db is nullptr");
-    return false;
+  auto capacity = kInitialLogDirectorySize;
+  while (capacity * kLogBlockSize <= first_id) {
+    capacity *= 2;
   }
+  publish_log_directory(create_log_directory(capacity, first_id));
+  term_index_ = stored_index;
+  term_index_.truncate(first_id);
 
-  leveldb::Slice value(reinterpret_cast<const char *>(&term), sizeof(uint64_t));
+  for (auto &log : storage_->load_logs(first_id)) {
+    publish_log(log);
+  }
+  persisted_term_index_ = term_index_;
+  persisted_commit_size_ = std::min(commit_size, size);
+  applied_size_ = std::min(applied_size, logs_size());
 
-  auto status = db_->Put(leveldb::WriteOptions(), kCurrentTermKey, value);
-  if (status.ok() == false) {
-    RCLCPP_ERROR(logger_, "current_term set failed: %s",
-                 status.ToString().c_str());
-    return false;
+  // the stored index may be missing or partially written, so it is replaced
+  // with the one built from the logs if they differ
+  if (runs != term_index_.runs()) {
+    storage_->store_term_index(term_index_.runs());
   }
-  return true;
-}
 
-uint64_t ContextStore::current_term() const {
-  std::lock_guard<std::mutex> lock(store_mutex_);
-  return current_term_;
+  if (first_id > 0) {
+    RCLCPP_INFO(logger_, "%lu applied logs are left in the storage", first_id);
+  }
 }
 
-void ContextStore::init_current_term() {
-  std::string value;
-  auto status = db_->Get(leveldb::ReadOptions(), kCurrentTermKey, &value);
+ContextStore::~ContextStore() { close(); }
 
-  if (status.ok() == false) {
-    if (!status.NotFound) {
-      RCLCPP_ERROR(logger_, "current_term get failed: %s",
-                   status.ToString().c_str());
-    }
-    current_term_ = 0;
-    return;
-  }
+void ContextStore::close() { worker_.stop(); }
 
-  leveldb::Slice slice = value;
-  if (slice.size() != sizeof(uint64_t)) {
-    RCLCPP_ERROR(logger_, "current_term value size is invalid");
-    current_term_ = 0;
-    return;
-  }
+bool ContextStore::current_term(const uint64_t term) {
+  std::lock_guard<std::mutex> lock(store_mutex_);
+  current_term_ = term;
+  return store_hard_state();
+}
 
-  current_term_ = *(reinterpret_cast<const uint64_t *>(slice.data()));
+uint64_t ContextStore::current_term() const {
+  return current_term_;
 }
 
 bool ContextStore::voted_for(const uint32_t id) {
   std::lock_guard<std::mutex> lock(store_mutex_);
   voted_for_ = id;
-
-  if (db_ == nullptr) {
-    //RCLCPP_ERROR(logger_, "db is nullptr");
-    return false;
-  }
-
-  leveldb::Slice value(reinterpret_cast<const char *>(&id), sizeof(uint32_t));
-  auto status = db_->Put(leveldb::WriteOptions(), kVotedForKey, value);
-  if (status.ok() == false) {
-    RCLCPP_ERROR(logger_, "voted_for set failed: %s",
-                 status.ToString().c_str());
-    return false;
-  }
-  return true;
+  return store_hard_state();
 }
 
 uint32_t ContextStore::voted_for() const {
-  std::lock_guard<std::mutex> lock(store_mutex_);
   return voted_for_;
 }
 
-void ContextStore::init_voted_for() {
-  std::string value;
-  auto status = db_->Get(leveldb::ReadOptions(), kVotedForKey, &value);
-
-  if (status.ok() == false) {
-    if (!status.NotFound) {
-      RCLCPP_ERROR(logger_, "voted_for get failed: %s",
-                   status.ToString().c_str());
-    }
-    voted_for_ = 0;
-    return;
-  }
-
-  leveldb::Slice slice = value;
-  if (slice.size() != sizeof(uint32_t)) {
-    RCLCPP_ERROR(logger_, "voted_for value size is invalid");
-    voted_for_ = 0;
-    return;
-  }
+bool ContextStore::voted(const bool voted) {
+  std::lock_guard<std::mutex> lock(store_mutex_);
+  voted_ = voted;
+  return store_hard_state();
+}
 
-  voted_for_ = *(reinterpret_cast<const uint32_t *>(slice.data()));
+bool ContextStore::voted() const {
+  return voted_;
 }
 
-bool ContextStore::voted(const bool voted) {
+bool ContextStore::hard_state(const uint64_t term, const uint32_t voted_for,
+                              const bool voted) {
   std::lock_guard<std::mutex> lock(store_mutex_);
+  current_term_ = term;
+  voted_for_ = voted_for;
   voted_ = voted;
-
-  if (db_ == nullptr) {
-    //RCLCPP_ERROR(logger_, "db is nullptr");
-    return false;
-  }
-  leveldb::Slice value(reinterpret_cast<const char *>(&voted), sizeof(bool));
-  auto status = db_->Put(leveldb::WriteOptions(), kVotedKey, value);
-  if (status.ok() == false) {
-    RCLCPP_ERROR(logger_, "voted set failed: %s", status.ToString().c_str());
-    return false;
-  }
-  return true;
+  return store_hard_state();
 }
 
-bool ContextStore::voted() const {
+HardState ContextStore::hard_state() const {
   std::lock_guard<std::mutex> lock(store_mutex_);
-  return voted_;
+  return HardState(current_term_, voted_for_, voted_);
 }
 
-void ContextStore::init_voted() {
-  std::string value;
-  auto status = db_->Get(leveldb::ReadOptions(), kVotedKey, &value);
+bool ContextStore::vote(const uint32_t id) {
+  std::lock_guard<std::mutex> lock(store_mutex_);
+  voted_for_ = id;
+  voted_ = true;
+  return store_hard_state();
+}
 
-  if (status.ok() == false) {
-    if (!status.NotFound) {
-      RCLCPP_ERROR(logger_, "voted get failed: %s", status.ToString().c_str());
-    }
-    voted_ = false;
-    return;
+bool ContextStore::grant_vote(const uint32_t id, uint64_t &term) {
+  std::lock_guard<std::mutex> lock(store_mutex_);
+  if (term < current_term_ || voted_ == true) {
+    term = current_term_;
+    return false;
   }
 
-  leveldb::Slice slice = value;
-  if (slice.size() != sizeof(bool)) {
-    RCLCPP_ERROR(logger_, "voted value size is invalid");
-    voted_ = false;
-    return;
-  }
+  term = current_term_;
+  voted_for_ = id;
+  voted_ = true;
+  return store_hard_state();
+}
 
-  voted_ = *(reinterpret_cast<const bool *>(slice.data()));
+bool ContextStore::reset_vote() {
+  std::lock_guard<std::mutex> lock(store_mutex_);
+  voted_for_ = 0;
+  voted_ = false;
+  return store_hard_state();
+}
+
+bool ContextStore::store_hard_state() {
+  std::lock_guard<std::mutex> lock(storage_mutex_);
+  return storage_->store_hard_state(
+      HardState(current_term_, voted_for_, voted_));
 }
 
 uint32_t ContextStore::vote_received() {
-  std::lock_guard<std::mutex> lock(store_mutex_);
   return vote_received_;
 }
 
 bool ContextStore::increase_vote_received() {
-  std::lock_guard<std::mutex> lock(store_mutex_);
   vote_received_++;
   return true;
 }
 
 bool ContextStore::reset_vote_received() {
-  std::lock_guard<std::mutex> lock(store_mutex_);
   vote_received_ = 0;
   return true;
 }
 
 const LogEntry::SharedPtr ContextStore::log(const uint64_t id) {
-  std::lock_guard<std::mutex> lock(store_mutex_);
-  if (logs_.size() <= id) {
+  LogReader reader(log_epoch_, log_readers_);
+  auto directory = logs_.load();
+  if (directory->size_.load(std::memory_order_acquire) <= id) {
     return nullptr;
   }
 
-  return logs_[id];
+  auto block = directory->blocks_[id / kLogBlockSize];
+  if (block == nullptr || (*block)[id % kLogBlockSize] == nullptr) {
+    return load_log(id);
+  }
+  return (*block)[id % kLogBlockSize];
 }
 
 const LogEntry::SharedPtr ContextStore::log() {
-  std::lock_guard<std::mutex> lock(store_mutex_);
-  if (logs_.empty() == true) {
+  auto size = logs_size();
+  if (size == 0) {
     return nullptr;
   }
 
-  return logs_.back();
+  return log(size - 1);
+}
+
+LogEntry::SharedPtr ContextStore::load_log(const uint64_t id) {
+  std::lock_guard<std::mutex> lock(storage_mutex_);
+  return storage_->load_log(id);
 }
 
 uint64_t ContextStore::logs_size() const {
-  std::lock_guard<std::mutex> lock(store_mutex_);
-  return logs_.size();
+  LogReader reader(log_epoch_, log_readers_);
+  return logs_.load()->size_.load(std::memory_order_acquire);
 }
 
-uint64_t ContextStore::load_logs_size() {
-  if (db_ == nullptr) {
-    //RCLCPP_ERROR(logger_, "db is nullptr");
-    return 0;
+uint64_t ContextStore::applied_size() const { return applied_size_; }
+
+bool ContextStore::applied_size(const uint64_t size) {
+  {
+    // checked under the lock, since a revert lowers both of the sizes
+    std::lock_guard<std::mutex> lock(store_mutex_);
+    if (size > logs_.load(std::memory_order_relaxed)->size_) {
+      RCLCPP_ERROR(logger_, "applied size is invalid: %lu", size);
+      return false;
+    }
+
+    if (applied_size_ < size) {
+      applied_size_ = size;
+    }
   }
+  store_applied_size();
+  return true;
+}
 
-  std::string value;
-  auto status = db_->Get(leveldb::ReadOptions(), kLogSizeKey, &value);
+bool ContextStore::snapshot_size(const uint64_t size) {
+  {
+    std::lock_guard<std::mutex> lock(store_mutex_);
+    if (size > logs_.load(std::memory_order_relaxed)->size_) {
+      RCLCPP_ERROR(logger_, "snapshot size is invalid: %lu", size);
+      return false;
+    }
 
-  if (status.ok() == false) {
-    if (!status.NotFound) {
-      RCLCPP_ERROR(logger_, "logs size get failed: %s",
-                   status.ToString().c_str());
+    if (snapshot_size_ == kNoSnapshot || snapshot_size_ < size) {
+      snapshot_size_ = size;
     }
-    return 0;
   }
+  store_applied_size();
+  return true;
+}
 
-  leveldb::Slice slice = value;
-  if (slice.size() != sizeof(uint64_t)) {
-    RCLCPP_ERROR(logger_, "logs size value size is invalid");
-    return 0;
+void ContextStore::store_applied_size() {
+  // only the latest size is stored when acknowledgements come faster than
+  // the storage
+  if (applied_size_queued_.exchange(true) == true) {
+    return;
   }
 
-  return *(reinterpret_cast<const uint64_t *>(slice.data()));
+  worker_.post([this]() {
+    applied_size_queued_ = false;
+    std::lock_guard<std::mutex> lock(storage_mutex_);
+    storage_->store_applied_size(std::min<uint64_t>(applied_size_,
+                                                    snapshot_size_));
+  });
 }
 
-bool ContextStore::store_logs_size(const uint64_t size) {
-  if (db_ == nullptr) {
-    //RCLCPP_ERROR(logger_, "db is nullptr");
+bool ContextStore::push_log(LogEntry::SharedPtr log) {
+  if (is_valid_log(log) == false) {
     return false;
   }
 
-  leveldb::Slice value(reinterpret_cast<const char *>(&size), sizeof(uint64_t));
-  auto status = db_->Put(leveldb::WriteOptions(), kLogSizeKey, value);
-  if (status.ok() == false) {
-    RCLCPP_ERROR(logger_, "logs size set failed: %s",
-                 status.ToString().c_str());
+  if (log->id_ != logs_size()) {
+    RCLCPP_ERROR(logger_, "log id is invalid");
     return false;
   }
-  return true;
-}
 
-void ContextStore::init_logs() {
-  std::string value;
+  if (wait_for_logs({log}) == false) {
+    return false;
+  }
 
-  logs_.clear();
+  return append_log(log);
+}
 
-  for (uint64_t i = 0; i < load_logs_size(); i++) {
-    auto log = load_log(i);
-    if (log == nullptr) {
-      store_logs_size(i);
-      break;
-    }
-    logs_.push_back(log);
+bool ContextStore::push_logs(const std::vector<LogEntry::SharedPtr> &logs) {
+  if (is_valid_batch(logs) == false) {
+    return false;
   }
-}
 
-LogEntry::SharedPtr ContextStore::load_log(const uint64_t id) {
-  if (db_ == nullptr) {
-    //RCLCPP_ERROR(logger_, "db is nullptr");
-    return nullptr;
+  if (logs.front()->id_ != logs_size()) {
+    RCLCPP_ERROR(logger_, "log id is invalid");
+    return false;
   }
 
-  std::string value;
-  auto status = db_->Get(leveldb::ReadOptions(), get_log_term_key(id), &value);
+  if (wait_for_logs(logs) == false) {
+    return false;
+  }
 
-  if (status.ok() == false) {
-    if (!status.NotFound) {
-      RCLCPP_ERROR(logger_, "log term for %lu get failed: %s", id,
-                   status.ToString().c_str());
+  for (auto &log : logs) {
+    if (append_log(log) == false) {
+      return false;
     }
-    return nullptr;
   }
+  return true;
+}
 
-  leveldb::Slice slice = value;
-  if (slice.size() < sizeof(uint64_t)) {
-    RCLCPP_ERROR(logger_, "log term value size is invalid");
-    return nullptr;
+bool ContextStore::wait_for_logs(
+    const std::vector<LogEntry::SharedPtr> &logs) {
+  std::promise<bool> promise;
+  auto future = promise.get_future();
+  worker_.post([this, logs, &promise]() {
+    write_logs(logs, true,
+               [&promise](bool result) { promise.set_value(result); });
+  });
+  return future.get();
+}
+
+void ContextStore::persist_log(LogEntry::SharedPtr log,
+                               std::function<void(bool)> callback) {
+  if (is_valid_log(log) == false) {
+    callback(false);
+    return;
   }
 
-  uint64_t term = *(reinterpret_cast<const uint64_t *>(slice.data()));
+  worker_.post([this, log, callback]() { write_logs({log}, false, callback); });
+}
 
-  status = db_->Get(leveldb::ReadOptions(), get_log_data_key(id), &value);
-  slice = value;
-  auto command = Command::make_shared(slice.data(), slice.size());
+void ContextStore::persist_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                                std::function<void(bool)> callback) {
+  if (is_valid_batch(logs) == false) {
+    callback(false);
+    return;
+  }
+
+  worker_.post(
+      [this, logs, callback]() { write_logs(logs, false, callback); });
+}
+
+void ContextStore::persist_committed_logs(
+    const std::vector<LogEntry::SharedPtr> &logs,
+    std::function<void(bool)> callback) {
+  if (is_valid_batch(logs) == false) {
+    callback(false);
+    return;
+  }
 
-  return LogEntry::make_shared(id, term, command);
+  worker_.post(
+      [this, logs, callback]() { write_logs(logs, true, callback); });
 }
 
-bool ContextStore::store_log_term(const uint64_t id, const uint64_t term) {
-  if (db_ == nullptr) {
-   // RCLCPP_ERROR(logger_, "db is nullptr");
+bool ContextStore::append_log(LogEntry::SharedPtr log) {
+  if (is_valid_log(log) == false) {
     return false;
   }
 
-  leveldb::Slice value(reinterpret_cast<const char *>(&term), sizeof(uint64_t));
-  auto status = db_->Put(leveldb::WriteOptions(), get_log_term_key(id), value);
-  if (status.ok() == false) {
-    RCLCPP_ERROR(logger_, "logs term for %lu set failed: %s", id,
-                 status.ToString().c_str());
+  std::lock_guard<std::mutex> lock(store_mutex_);
+  if (log->id_ != logs_.load(std::memory_order_relaxed)->size_) {
+    RCLCPP_ERROR(logger_, "log id is invalid");
     return false;
   }
 
+  publish_log(log);
+
   return true;
 }
 
-bool ContextStore::store_log_data(const uint64_t id,
-                                  std::vector<uint8_t> data) {
-  if (db_ == nullptr) {
-   // RCLCPP_ERROR(logger_, "db is nullptr");
-    return false;
+void ContextStore::store_commit_size() {
+  // only the latest size is stored when commits come faster than the storage
+  if (commit_size_queued_.exchange(true) == true) {
+    return;
   }
 
-  std::string buffer(data.begin(), data.end());
-  leveldb::Slice value(buffer.c_str(), data.size());
-  auto status = db_->Put(leveldb::WriteOptions(), get_log_data_key(id), value);
-  if (status.ok() == false) {
-    RCLCPP_ERROR(logger_, "logs term for %lu set failed: %s", id,
-                 status.ToString().c_str());
-    return false;
+  worker_.post([this]() {
+    commit_size_queued_ = false;
+    // a revert truncates the storage after this on the same thread, so a
+    // size read before the revert is lowered again
+    auto size = logs_size();
+    std::lock_guard<std::mutex> lock(storage_mutex_);
+    if (size > persisted_commit_size_ &&
+        storage_->store_commit_size(size) == true) {
+      persisted_commit_size_ = size;
+    }
+  });
+}
+
+bool ContextStore::revert_log(const uint64_t id) {
+  {
+    std::lock_guard<std::mutex> lock(store_mutex_);
+    auto directory = logs_.load(std::memory_order_relaxed);
+    if (id >= directory->size_.load(std::memory_order_relaxed)) {
+      RCLCPP_ERROR(logger_, "invalid id to revert: %lu", id);
+      return false;
+    }
+
+    // Only the block holding the new tail is copied, since its slots from id
+    // will be filled again.
+    auto reverted = create_log_directory(directory->blocks_.size(), id);
+    auto index = id / kLogBlockSize;
+    auto offset = id % kLogBlockSize;
+    auto tail = directory->blocks_[index];
+    if (offset > 0 && tail != nullptr) {
+      auto block = std::make_unique<LogBlock>();
+      std::copy(tail->begin(), tail->begin() + offset, block->begin());
+      reverted->blocks_[index] = block.get();
+      retire_log_blocks(index);
+      log_blocks_.push_back(std::move(block));
+    } else {
+      retire_log_blocks(index);
+    }
+    publish_log_directory(std::move(reverted));
+    term_index_.truncate(id);
+
+    // reverted logs are applied again once they are committed
+    auto lowered = false;
+    if (applied_size_ > id) {
+      applied_size_ = id;
+      lowered = true;
+    }
+    if (snapshot_size_ != kNoSnapshot && snapshot_size_ > id) {
+      snapshot_size_ = id;
+      lowered = true;
+    }
+    if (lowered == true) {
+      store_applied_size();
+    }
   }
 
+  worker_.run([this, id]() { return truncate_storage(id); });
   return true;
 }
 
-std::string ContextStore::get_log_data_key(uint64_t id) {
-  return std::string(kLogKeyPrefix + std::to_string(id) + kLogDataKeySuffix);
+void ContextStore::truncate_persisted_logs(const uint64_t size) {
+  worker_.post([this, size]() { truncate_storage(size); });
 }
 
-std::string ContextStore::get_log_term_key(uint64_t id) {
-  return std::string(kLogKeyPrefix + std::to_string(id) + kLogTermKeySuffix);
-}
-
-bool ContextStore::push_log(LogEntry::SharedPtr log) {
-  std::lock_guard<std::mutex> lock(store_mutex_);
+bool ContextStore::is_valid_log(const LogEntry::SharedPtr &log) {
   if (log == nullptr) {
     RCLCPP_ERROR(logger_, "log is nullptr");
     return false;
@@ -380,37 +471,203 @@ bool ContextStore::push_log(LogEntry::SharedPtr log) {
     return false;
   }
 
-  if (log->id_ != logs_.size()) {
-    RCLCPP_ERROR(logger_, "log id is invalid");
+  return true;
+}
+
+bool ContextStore::is_valid_batch(
+    const std::vector<LogEntry::SharedPtr> &logs) {
+  if (logs.empty() == true) {
+    RCLCPP_ERROR(logger_, "logs are empty");
     return false;
   }
 
-  if (store_log_term(log->id_, log->term_) == false) {
-    return false;
+  for (std::size_t i = 0; i < logs.size(); i++) {
+    if (is_valid_log(logs[i]) == false) {
+      return false;
+    }
+    if (logs[i]->id_ != logs.front()->id_ + i) {
+      RCLCPP_ERROR(logger_, "logs are not consecutive");
+      return false;
+    }
   }
+  return true;
+}
 
-  if (store_log_data(log->id_, log->command_->data()) == false) {
-    return false;
+void ContextStore::write_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                              const bool committed,
+                              std::function<void(bool)> callback) {
+  std::lock_guard<std::mutex> lock(storage_mutex_);
+  auto first_id = logs.front()->id_;
+  auto size = logs.back()->id_ + 1;
+  if (first_id > persisted_term_index_.size()) {
+    RCLCPP_ERROR(logger_, "log id to persist is invalid: %lu", first_id);
+    callback(false);
+    return;
   }
 
-  if (store_logs_size(logs_.size() + 1) == false) {
+  // Writing a log drops the stored logs after it. The index is stored first,
+  // so that it never misses a run of the stored logs.
+  auto changed = persisted_term_index_.truncate(first_id);
+  for (auto &log : logs) {
+    changed = persisted_term_index_.append(log->id_, log->term_) || changed;
+  }
+  if (changed == true &&
+      storage_->store_term_index(persisted_term_index_.runs()) == false) {
+    persisted_term_index_.truncate(first_id);
+    callback(false);
+    return;
+  }
+
+  // The storage may call the callback on its own thread once the logs are
+  // durable, while this thread goes on to queue the next logs. A write
+  // failing there fails every later one, so the index ahead of the logs is
+  // only rebuilt on the next load.
+  if (storage_->persist_logs(logs, committed, callback) == false) {
+    persisted_term_index_.truncate(first_id);
+    callback(false);
+    return;
+  }
+
+  if (committed == true) {
+    persisted_commit_size_ = size;
+  }
+}
+
+bool ContextStore::truncate_storage(const uint64_t size) {
+  std::lock_guard<std::mutex> lock(storage_mutex_);
+  if (size >= persisted_term_index_.size()) {
+    return true;
+  }
+
+  if (storage_->truncate_logs(size) == false) {
     return false;
   }
 
-  logs_.push_back(log);
+  // the logs written again from the size are not committed yet
+  if (persisted_commit_size_ > size) {
+    if (storage_->store_commit_size(size) == false) {
+      return false;
+    }
+    persisted_commit_size_ = size;
+  }
 
+  if (persisted_term_index_.truncate(size) == true) {
+    return storage_->store_term_index(persisted_term_index_.runs());
+  }
   return true;
 }
 
-bool ContextStore::revert_log(const uint64_t id) {
+uint64_t ContextStore::log_term(const uint64_t id) const {
   std::lock_guard<std::mutex> lock(store_mutex_);
-  if (id >= logs_.size()) {
-    RCLCPP_ERROR(logger_, "invalid id to revert: %lu", id);
-    return false;
+  return term_index_.term(id);
+}
+
+uint64_t ContextStore::last_log_term() const {
+  std::lock_guard<std::mutex> lock(store_mutex_);
+  return term_index_.last_term();
+}
+
+bool ContextStore::first_log_id(const uint64_t term, uint64_t &id) const {
+  std::lock_guard<std::mutex> lock(store_mutex_);
+  return term_index_.first_id(term, id);
+}
+
+void ContextStore::publish_log(LogEntry::SharedPtr log) {
+  auto directory = logs_.load(std::memory_order_relaxed);
+  auto size = directory->size_.load(std::memory_order_relaxed);
+  auto index = size / kLogBlockSize;
+  if (index >= directory->blocks_.size()) {
+    directory = publish_log_directory(
+        create_log_directory(directory->blocks_.size() * 2, size));
   }
-  logs_.resize(id);
-  store_logs_size(id);
-  return true;
+
+  if (directory->blocks_[index] == nullptr) {
+    directory->blocks_[index] = allocate_log_block(index);
+  }
+
+  (*directory->blocks_[index])[size % kLogBlockSize] = log;
+  directory->size_.store(size + 1, std::memory_order_release);
+  term_index_.append(log->id_, log->term_);
+
+  if (retired_log_blocks_.empty() == false ||
+      retired_log_directories_.empty() == false) {
+    reclaim_log_blocks();
+  }
+}
+
+std::unique_ptr<ContextStore::LogDirectory>
+ContextStore::create_log_directory(const uint64_t capacity,
+                                   const uint64_t size) {
+  auto directory = std::make_unique<LogDirectory>(capacity);
+  auto current = logs_.load(std::memory_order_relaxed);
+  if (current != nullptr) {
+    auto blocks = (size + kLogBlockSize - 1) / kLogBlockSize;
+    std::copy(current->blocks_.begin(), current->blocks_.begin() + blocks,
+              directory->blocks_.begin());
+  }
+  directory->size_.store(size, std::memory_order_relaxed);
+  return directory;
+}
+
+ContextStore::LogDirectory *ContextStore::publish_log_directory(
+    std::unique_ptr<LogDirectory> directory) {
+  logs_.store(directory.get());
+  if (log_directory_ != nullptr) {
+    retired_log_directories_.push_back(
+        Retired<LogDirectory>{log_epoch_.load(), std::move(log_directory_)});
+  }
+  log_directory_ = std::move(directory);
+  reclaim_log_blocks();
+  return log_directory_.get();
+}
+
+ContextStore::LogBlock *ContextStore::allocate_log_block(const uint64_t index) {
+  if (log_blocks_.size() <= index) {
+    log_blocks_.resize(index + 1);
+  }
+  log_blocks_[index] = std::make_unique<LogBlock>();
+  return log_blocks_[index].get();
+}
+
+void ContextStore::retire_log_blocks(const uint64_t index) {
+  for (auto i = index; i < log_blocks_.size(); i++) {
+    if (log_blocks_[i] != nullptr) {
+      retired_log_blocks_.push_back(
+          Retired<LogBlock>{log_epoch_.load(), std::move(log_blocks_[i])});
+    }
+  }
+  log_blocks_.resize(std::min<uint64_t>(index, log_blocks_.size()));
+}
+
+void ContextStore::reclaim_log_blocks() {
+  // The epoch advances once the readers of the epoch before it are gone, and
+  // the later readers count in the new one. So the readers in the epoch a
+  // directory or block is retired in and the ones before are gone two epochs
+  // later, and the readers since then never see it as it is not published.
+  auto epoch = log_epoch_.load();
+  if (log_readers_[(epoch + 1) % 2].load() == 0) {
+    log_epoch_.store(++epoch);
+    // advanced again if the readers of the epoch left are gone too, so that
+    // without readers every retired one is freed at once
+    if (log_readers_[(epoch + 1) % 2].load() == 0) {
+      epoch++;
+      log_epoch_.store(epoch);
+    }
+  }
+
+  while (retired_log_directories_.empty() == false &&
+         retired_log_directories_.front().epoch_ + 2 <= epoch) {
+    retired_log_directories_.pop_front();
+  }
+  while (retired_log_blocks_.empty() == false &&
+         retired_log_blocks_.front().epoch_ + 2 <= epoch) {
+    retired_log_blocks_.pop_front();
+  }
+}
+
+std::size_t ContextStore::retired_log_blocks_size() const {
+  std::lock_guard<std::mutex> lock(store_mutex_);
+  return retired_log_directories_.size() + retired_log_blocks_.size();
 }
 
 }  // namespace raft
@@ -17,25 +17,46 @@
 #ifndef AKIT_FAILOVER_FOROS_RAFT_CONTEXT_STORE_HPP_
 #define AKIT_FAILOVER_FOROS_RAFT_CONTEXT_STORE_HPP_
 
-#include <leveldb/db.h>
 #include <rclcpp/logger.hpp>
 
+#include <array>
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "akit/failover/foros/command.hpp"
+#include "raft/hard_state.hpp"
 #include "raft/log_entry.hpp"
+#include "raft/storage.hpp"
+#include "raft/storage_worker.hpp"
+#include "raft/term_index.hpp"
 
 namespace akit {
 namespace failover {
 namespace foros {
 namespace raft {
 
+/// Raft state and log entries.
+/**
+ * Readers of logs and hard state never take the store mutex. The hard state
+ * fields are atomics and the logs are published through a directory of fixed
+ * size blocks whose filled slots are never modified, so readers do not
+ * contend with writers. Directories and blocks replaced by writers are freed
+ * once no reader is active.
+ * Storage writes run on a worker thread in the order they are requested.
+ * Logs applied by the application before a restart are not loaded, but read
+ * from the storage when they are requested.
+ */
 class ContextStore final {
  public:
   explicit ContextStore(const std::string &path, rclcpp::Logger &logger);
+  explicit ContextStore(std::unique_ptr<Storage> storage,
+                        rclcpp::Logger &logger);
   ~ContextStore();
 
   bool current_term(const uint64_t term);
@@ -47,49 +68,184 @@ class ContextStore final {
   bool voted(const bool voted);
   bool voted() const;
 
+  bool hard_state(const uint64_t term, const uint32_t voted_for,
+                  const bool voted);
+  HardState hard_state() const;
+  bool vote(const uint32_t id);
+  // Vote for a candidate unless this node already voted in the term. The
+  // check and the vote are done under one lock, so only one candidate is
+  // granted a vote in a term. The current term is returned through term.
+  bool grant_vote(const uint32_t id, uint64_t &term);
+  bool reset_vote();
+
   uint32_t vote_received();
   bool increase_vote_received();
   bool reset_vote_received();
 
   const LogEntry::SharedPtr log(const uint64_t id);
   const LogEntry::SharedPtr log();
+  // Persist and append a log, waiting for the storage.
   bool push_log(LogEntry::SharedPtr log);
+  // Persist and append consecutive logs with a single storage write.
+  bool push_logs(const std::vector<LogEntry::SharedPtr> &logs);
+  // Persist a log on the storage thread without appending it. The callback is
+  // called on the storage thread once the log is durable or failed.
+  void persist_log(LogEntry::SharedPtr log,
+                   std::function<void(bool)> callback);
+  // Persist consecutive logs with a single storage write, like persist_log.
+  void persist_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                    std::function<void(bool)> callback);
+  // Persist consecutive logs already committed by the leader, like
+  // persist_logs, and raise the stored commit size with them.
+  void persist_committed_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                              std::function<void(bool)> callback);
+  // Append a log which is already persisted.
+  bool append_log(LogEntry::SharedPtr log);
+  // Store the log size as the commit size on the storage thread without
+  // waiting, once logs persisted before they were agreed are appended.
+  // Persisted logs beyond the stored commit size are discarded on load.
+  void store_commit_size();
   bool revert_log(const uint64_t id);
+  // Discard persisted logs which are not appended, after pending writes.
+  void truncate_persisted_logs(const uint64_t size);
   uint64_t logs_size() const;
 
+  // Number of logs applied by the application.
+  uint64_t applied_size() const;
+  // Raise the applied size and store it on the storage thread without
+  // waiting. Returns false if it is beyond the logs.
+  bool applied_size(const uint64_t size);
+  // Raise the size of the logs kept in the snapshot of a log applier, like
+  // the applied size. Once it is given, the smaller of the two sizes is
+  // stored, so that the logs after either of them are loaded on restart.
+  bool snapshot_size(const uint64_t size);
+
+  // Term lookups are answered from the term index without loading logs.
+  uint64_t log_term(const uint64_t id) const;
+  uint64_t last_log_term() const;
+  bool first_log_id(const uint64_t term, uint64_t &id) const;
+
+  // Finish pending writes and run the later ones on the calling thread.
+  void close();
+
+  // Number of replaced directories and dropped blocks not freed yet.
+  std::size_t retired_log_blocks_size() const;
+
  private:
-  void init_current_term();
-  void init_voted_for();
-  void init_voted();
-  void init_logs();
-  bool store_logs_size(const uint64_t size);
-  uint64_t load_logs_size();
+  static constexpr uint64_t kLogBlockSize = 1024;
+  static constexpr uint64_t kInitialLogDirectorySize = 64;
+  static constexpr uint64_t kNoSnapshot = UINT64_MAX;
+
+  // Fixed size block of logs. Blocks never move once allocated.
+  using LogBlock = std::array<LogEntry::SharedPtr, kLogBlockSize>;
+
+  // Directory of log blocks. Within a directory the size only grows and
+  // slots below it are never modified, so a new directory is published when
+  // it runs out of blocks or when logs are reverted.
+  class LogDirectory {
+   public:
+    explicit LogDirectory(const uint64_t capacity)
+        : blocks_(capacity, nullptr), size_(0) {}
+
+    std::vector<LogBlock *> blocks_;
+    std::atomic<uint64_t> size_;
+  };
+
+  // Marks a reader of the directory active in the current epoch while it is
+  // alive, so that the directory and blocks it reads are not reclaimed. The
+  // readers of each epoch are counted by its parity, since the epoch only
+  // advances once the readers of the epoch before it are gone.
+  class LogReader {
+   public:
+    LogReader(const std::atomic<uint64_t> &epoch,
+              std::array<std::atomic<uint64_t>, 2> &readers)
+        : readers_(readers) {
+      while (true) {
+        epoch_ = epoch.load();
+        readers_[epoch_ % 2].fetch_add(1);
+        // counted in the epoch which is still current
+        if (epoch.load() == epoch_) {
+          break;
+        }
+        readers_[epoch_ % 2].fetch_sub(1);
+      }
+    }
+    ~LogReader() { readers_[epoch_ % 2].fetch_sub(1); }
+
+   private:
+    std::array<std::atomic<uint64_t>, 2> &readers_;
+    uint64_t epoch_;
+  };
+
+  // replaced directory or dropped block with the epoch it is retired in
+  template <typename T>
+  struct Retired {
+    uint64_t epoch_;
+    std::unique_ptr<T> object_;
+  };
+
+  bool store_hard_state();
+  void load_logs();
   LogEntry::SharedPtr load_log(const uint64_t id);
-  bool store_log_term(const uint64_t id, const uint64_t term);
-  bool store_log_data(const uint64_t id, std::vector<uint8_t> data);
-  std::string get_log_data_key(const uint64_t id);
-  std::string get_log_term_key(const uint64_t id);
+  void store_applied_size();
+  bool is_valid_log(const LogEntry::SharedPtr &log);
+  bool is_valid_batch(const std::vector<LogEntry::SharedPtr> &logs);
+  // Store logs on the worker thread and wait until they are durable.
+  bool wait_for_logs(const std::vector<LogEntry::SharedPtr> &logs);
+  // Queue logs to the storage on the worker thread. The callback is called
+  // once they are durable or failed.
+  void write_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                  const bool committed, std::function<void(bool)> callback);
+  bool truncate_storage(const uint64_t size);
+  void publish_log(LogEntry::SharedPtr log);
+  std::unique_ptr<LogDirectory> create_log_directory(const uint64_t capacity,
+                                                     const uint64_t size);
+  LogDirectory *publish_log_directory(std::unique_ptr<LogDirectory> directory);
+  LogBlock *allocate_log_block(const uint64_t index);
+  void retire_log_blocks(const uint64_t index);
+  void reclaim_log_blocks();
+
+  std::unique_ptr<Storage> storage_;
 
-  const char *kCurrentTermKey = "current_term";
-  const char *kVotedForKey = "voted_for";
-  const char *kVotedKey = "voted";
-  const char *kLogKeyPrefix = "log/";
-  const char *kLogDataKeySuffix = "/data";
-  const char *kLogTermKeySuffix = "/term";
-  const char *kLogSizeKey = "log_size";
+  std::atomic<uint64_t> current_term_;
+  std::atomic<uint32_t> voted_for_;
+  std::atomic<bool> voted_;
+  std::atomic<uint32_t> vote_received_;
+  std::atomic<uint64_t> applied_size_;
+  // kNoSnapshot until a log applier keeps a snapshot
+  std::atomic<uint64_t> snapshot_size_;
+  // true while a store of the applied size is queued
+  std::atomic<bool> applied_size_queued_;
+  // true while a store of the commit size is queued
+  std::atomic<bool> commit_size_queued_;
 
-  leveldb::DB *db_;
+  std::atomic<LogDirectory *> logs_;
+  // the published directory and its blocks, indexed like the directory
+  std::unique_ptr<LogDirectory> log_directory_;
+  std::vector<std::unique_ptr<LogBlock>> log_blocks_;
+  // Replaced directories and dropped blocks are freed two epochs after they
+  // are retired, once no reader which may hold them is active.
+  std::deque<Retired<LogDirectory>> retired_log_directories_;
+  std::deque<Retired<LogBlock>> retired_log_blocks_;
+  std::atomic<uint64_t> log_epoch_;
+  mutable std::array<std::atomic<uint64_t>, 2> log_readers_;
 
-  uint64_t current_term_;
-  uint32_t voted_for_;
-  bool voted_;
-  uint32_t vote_received_;
+  // guarded by store_mutex_
+  TermIndex term_index_;
 
-  std::vector<LogEntry::SharedPtr> logs_;
+  // index of the persisted logs, which may be ahead of the appended logs,
+  // guarded by storage_mutex_
+  TermIndex persisted_term_index_;
+  // stored commit size, guarded by storage_mutex_
+  uint64_t persisted_commit_size_;
+  std::mutex storage_mutex_;
 
   rclcpp::Logger logger_;
 
   mutable std::mutex store_mutex_;
+
+  // declared last, so that pending writes finish before anything is destroyed
+  StorageWorker worker_;
 };
 
 }  // namespace raft
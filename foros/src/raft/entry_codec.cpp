@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raft/entry_codec.hpp"
+
+#include <vector>
+
+#include "common/compression.hpp"
+#include "common/delta_codec.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+EntryCodec::EntryCodec(const bool delta_encoding,
+                       const uint32_t compression_threshold)
+    : delta_encoding_(delta_encoding),
+      compression_threshold_(compression_threshold) {}
+
+uint8_t EntryCodec::encode(const CommandData *base, const CommandData &data,
+                           std::vector<uint8_t> &encoded) const {
+  uint8_t encoding = kRaw;
+  CommandData input = data;
+
+  std::vector<uint8_t> delta;
+  if (delta_encoding_ == true && base != nullptr &&
+      DeltaCodec::encode(*base, data, delta) == true) {
+    encoding |= kDelta;
+    input = delta;
+  }
+
+  if (compression_threshold_ > 0 && input.size() >= compression_threshold_ &&
+      Compression::compress(input.data(), input.size(), encoded) == true) {
+    return encoding | kCompressed;
+  }
+
+  if (encoding != kRaw) {
+    encoded.swap(delta);
+  }
+  return encoding;
+}
+
+bool EntryCodec::decode(const uint8_t encoding, const CommandData *base,
+                        const uint8_t *data, std::size_t size,
+                        std::vector<uint8_t> &decoded) {
+  if ((encoding & ~(kDelta | kCompressed)) != 0) {
+    return false;
+  }
+
+  std::vector<uint8_t> decompressed;
+  if ((encoding & kCompressed) != 0) {
+    if (Compression::decompress(data, size, decompressed) == false) {
+      return false;
+    }
+    data = decompressed.data();
+    size = decompressed.size();
+  }
+
+  if ((encoding & kDelta) != 0) {
+    return base != nullptr && DeltaCodec::decode(*base, data, size, decoded);
+  }
+
+  if ((encoding & kCompressed) != 0) {
+    decoded.swap(decompressed);
+  } else {
+    decoded.assign(data, data + size);
+  }
+  return true;
+}
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_ENTRY_CODEC_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_ENTRY_CODEC_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "akit/failover/foros/command.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Encodes the command data of log entries for replication and storage.
+// An entry is encoded as a delta against the previous entry and compressed
+// only if each step makes it smaller, so a decoder needs the encoding flags.
+class EntryCodec {
+ public:
+  // Encoding flags, the same values as AppendEntries.entries_encoding
+  static constexpr uint8_t kRaw = 0;
+  static constexpr uint8_t kDelta = 1;
+  static constexpr uint8_t kCompressed = 2;
+
+  // Data smaller than the compression threshold is not compressed, and a
+  // threshold of 0 disables compression.
+  explicit EntryCodec(const bool delta_encoding = false,
+                      const uint32_t compression_threshold = 0);
+
+  // Encode the data against the base, which is the data of the previous
+  // entry or nullptr. Returns kRaw if no encoding makes the data smaller, in
+  // which case the output is unspecified and the data is used as it is.
+  uint8_t encode(const CommandData *base, const CommandData &data,
+                 std::vector<uint8_t> &encoded) const;
+
+  // Decode data encoded with the flags against the same base.
+  static bool decode(const uint8_t encoding, const CommandData *base,
+                     const uint8_t *data, std::size_t size,
+                     std::vector<uint8_t> &decoded);
+
+  bool delta_encoding() const { return delta_encoding_; }
+
+ private:
+  bool delta_encoding_;
+  uint32_t compression_threshold_;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_ENTRY_CODEC_HPP_
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_HARD_STATE_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_HARD_STATE_HPP_
+
+#include <cstdint>
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Raft state which must be persisted before responding to any request.
+class HardState {
+ public:
+  HardState() : term_(0), voted_for_(0), voted_(false) {}
+  HardState(uint64_t term, uint32_t voted_for, bool voted)
+      : term_(term), voted_for_(voted_for), voted_(voted) {}
+
+  uint64_t term_;
+  uint32_t voted_for_;
+  bool voted_;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_HARD_STATE_HPP_
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_LOG_APPLIER_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_LOG_APPLIER_HPP_
+
+#include <cstdint>
+
+#include "akit/failover/foros/command.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// State built from the logs inside the library. It is applied on the raft
+// threads before the application callbacks are invoked.
+class LogApplier {
+ public:
+  virtual ~LogApplier() = default;
+  // size of the logs applied so far
+  virtual uint64_t applied_size() = 0;
+  virtual void apply(const uint64_t id, Command::SharedPtr command) = 0;
+  // Revert the logs from the given id. The applied size may go below the id
+  // if the applier can not undo them, and the logs from it are applied
+  // again.
+  virtual void revert(const uint64_t id) = 0;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_LOG_APPLIER_HPP_
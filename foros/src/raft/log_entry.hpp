@@ -17,9 +17,8 @@
 #ifndef AKIT_FAILOVER_FOROS_RAFT_LOG_ENTRY_HPP_
 #define AKIT_FAILOVER_FOROS_RAFT_LOG_ENTRY_HPP_
 
-#include <rclcpp/macros.hpp>
-
 #include "akit/failover/foros/command.hpp"
+#include "akit/failover/foros/pool_allocator.hpp"
 
 namespace akit {
 namespace failover {
@@ -28,7 +27,7 @@ namespace raft {
 
 class LogEntry {
  public:
-  RCLCPP_SMART_PTR_DEFINITIONS(LogEntry)
+  FOROS_POOLED_SMART_PTR_DEFINITIONS(LogEntry)
 
   LogEntry(uint64_t id, uint64_t term, Command::SharedPtr command)
       : id_(id), term_(term), command_(command) {}
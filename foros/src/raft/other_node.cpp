@@ -15,9 +15,12 @@
  */
 
 #include "raft/other_node.hpp"
+#include <algorithm>
 #include <memory>
 #include <string>
+#include "common/crc32c.hpp"
 #include "common/node_util.hpp"
+#include "raft/command_header.hpp"
 
 namespace akit {
 namespace failover {
@@ -29,12 +32,13 @@ OtherNode::OtherNode(
     rclcpp::node_interfaces::NodeGraphInterface::SharedPtr node_graph,
     rclcpp::node_interfaces::NodeServicesInterface::SharedPtr node_services,
     const std::string &cluster_name, const uint32_t node_id,
-    const uint64_t next_index,
+    const uint64_t next_index, const EntryCodec &codec,
     std::function<const std::shared_ptr<LogEntry>(uint64_t)>
         get_log_entry_callback)
     : node_id_(node_id),
       next_index_(next_index),
       match_index_(0),
+      codec_(codec),
       get_log_entry_callback_(get_log_entry_callback) {
   rcl_client_options_t options = rcl_client_get_default_options();
   options.qos = rmw_qos_profile_services_default;
@@ -54,6 +58,14 @@ OtherNode::OtherNode(
       options);
   node_services->add_client(
       std::dynamic_pointer_cast<rclcpp::ClientBase>(request_vote_), nullptr);
+
+  commit_command_ = rclcpp::Client<foros_msgs::srv::CommitCommand>::make_shared(
+      node_base.get(), node_graph,
+      NodeUtil::get_service_name(cluster_name, node_id,
+                                 NodeUtil::kCommitCommandServiceName),
+      options);
+  node_services->add_client(
+      std::dynamic_pointer_cast<rclcpp::ClientBase>(commit_command_), nullptr);
 }
 //////////////////syc
 
@@ -65,44 +77,119 @@ bool OtherNode::broadcast(const uint64_t current_term, const uint32_t node_id,
                           const LogEntry::SharedPtr log,
                           std::function<void(const uint32_t, const uint64_t,
                                              const uint64_t, const bool)>
-                              callback) {
+                              callback,
+                          AppendEntriesRequestCache &request_cache) {
   if (append_entries_->service_is_ready() == false) {
     return false;
   }
 
-  auto request = std::make_shared<foros_msgs::srv::AppendEntries::Request>();
-
-  request->term = current_term;
-  request->leader_id = node_id;
-
   uint64_t next_index;
   {
     std::lock_guard<std::mutex> lock(index_mutex_);
     next_index = next_index_;
   }
 
+  auto &request = request_cache[next_index];
+  if (request == nullptr) {
+    request = create_append_entries_request(current_term, node_id, log,
+                                            next_index);
+  }
+
+  send_append_entries(request, callback);
+
+  return true;
+}
+
+foros_msgs::srv::AppendEntries::Request::SharedPtr
+OtherNode::create_append_entries_request(const uint64_t current_term,
+                                         const uint32_t node_id,
+                                         const LogEntry::SharedPtr log,
+                                         const uint64_t next_index) {
+  auto request = std::make_shared<foros_msgs::srv::AppendEntries::Request>();
+
+  request->term = current_term;
+  request->leader_id = node_id;
+
   if (get_log_entry_callback_ != nullptr) {
-    if (log != nullptr && log->id_ >= next_index) {
-      auto entry = get_log_entry_callback_(next_index);
-      if (entry != nullptr) {
-        request->entries = entry->command_->data();
-        request->leader_commit = entry->id_;
-        request->term = entry->term_;
+    LogEntry::SharedPtr prev_entry;
+    if (next_index > 0) {
+      prev_entry = get_log_entry_callback_(next_index - 1);
+      if (prev_entry != nullptr) {
+        request->prev_log_index = prev_entry->id_;
+        request->prev_log_term = prev_entry->term_;
       }
     }
 
-    if (next_index > 0) {
-      auto entry = get_log_entry_callback_(next_index - 1);
+    if (log != nullptr && log->id_ >= next_index) {
+      auto entry = get_log_entry_callback_(next_index);
       if (entry != nullptr) {
-        request->prev_log_index = entry->id_;
-        request->prev_log_term = entry->term_;
+        // consecutive entries of the same term are sent at once
+        std::vector<LogEntry::SharedPtr> entries = {entry};
+        std::size_t size = entry->command_->view().size();
+        while (entries.back()->id_ < log->id_ &&
+               entries.size() < kMaxBatchEntries && size < kMaxBatchSize) {
+          auto next = get_log_entry_callback_(entries.back()->id_ + 1);
+          if (next == nullptr || next->term_ != entry->term_) {
+            break;
+          }
+          entries.push_back(next);
+          size += next->command_->view().size();
+        }
+
+        // headers are sent only if an entry has one, which most do not
+        auto with_header = std::any_of(
+            entries.begin(), entries.end(),
+            [](const LogEntry::SharedPtr &next) {
+              return CommandHeader(*next->command_).is_default() == false;
+            });
+
+        // each entry is encoded against the previous one, so the follower
+        // decodes the first one against its entry at prev_log_index, which
+        // matches ours once the prev log check passes
+        auto base = prev_entry;
+        for (auto &next : entries) {
+          append_entry(base, next, with_header, *request);
+          base = next;
+        }
+        if (entries.size() == 1) {
+          request->entries_encoding = request->entries_encodings.front();
+          request->entries_crc = request->entries_crcs.front();
+          request->entries_sizes.clear();
+          request->entries_encodings.clear();
+          request->entries_crcs.clear();
+        }
+        request->leader_commit = entries.back()->id_;
+        request->term = entries.back()->term_;
       }
     }
   }
 
-  send_append_entries(request, callback);
+  return request;
+}
 
-  return true;
+void OtherNode::append_entry(const LogEntry::SharedPtr base,
+                             const LogEntry::SharedPtr entry,
+                             const bool with_header,
+                             foros_msgs::srv::AppendEntries::Request &request) {
+  auto data = entry->command_->view();
+  request.entries_crcs.push_back(CRC32C::value(data.data(), data.size()));
+
+  auto base_data =
+      base == nullptr ? CommandData(nullptr, 0) : base->command_->view();
+  std::vector<uint8_t> encoded;
+  auto encoding =
+      codec_.encode(base == nullptr ? nullptr : &base_data, data, encoded);
+  auto sent = encoding == EntryCodec::kRaw ? data : CommandData(encoded);
+  request.entries.insert(request.entries.end(), sent.begin(), sent.end());
+  request.entries_sizes.push_back(sent.size());
+  request.entries_encodings.push_back(encoding);
+
+  if (with_header == true) {
+    CommandHeader header(*entry->command_);
+    auto offset = request.entries_headers.size();
+    request.entries_headers.resize(offset + header.size());
+    header.encode(request.entries_headers.data() + offset);
+  }
 }
 
 void OtherNode::send_append_entries(
@@ -122,7 +209,7 @@ void OtherNode::send_append_entries(
           if (response->success) {
             this->match_index_ = request->leader_commit;
             this->next_index_ = this->match_index_ + 1;
-          } else {
+          } else if (response->corrupted == false) {
             if (this->next_index_ > 0) {
               this->next_index_--;
             }
@@ -237,6 +324,31 @@ void OtherNode::update_match_index(const uint64_t match_index) {
   set_match_index(match_index);
 }
 
+bool OtherNode::forward_commit(
+    const Command::SharedPtr command,
+    std::function<void(const uint64_t, const bool)> callback) {
+  if (commit_command_->service_is_ready() == false) {
+    return false;
+  }
+
+  auto request = std::make_shared<foros_msgs::srv::CommitCommand::Request>();
+  request->command = command->view().to_vector();
+  CommandHeader header(*command);
+  if (header.is_default() == false) {
+    request->header.resize(header.size());
+    header.encode(request->header.data());
+  }
+  commit_command_->async_send_request(
+      request,
+      [callback](rclcpp::Client<foros_msgs::srv::CommitCommand>::SharedFuture
+                     future) {
+        auto response = future.get();
+        callback(response->id, response->result);
+      });
+
+  return true;
+}
+
 void OtherNode::set_match_index(const uint64_t match_index) {
   std::lock_guard<std::mutex> lock(index_mutex_);
   match_index_ = match_index;
@@ -18,17 +18,23 @@
 #define AKIT_FAILOVER_FOROS_RAFT_OTHER_NODE_HPP_
 
 #include <foros_msgs/srv/append_entries.hpp>
+#include <foros_msgs/srv/commit_command.hpp>
 #include <foros_msgs/srv/request_vote.hpp>
 #include <rclcpp/client.hpp>
 #include <rclcpp/node_interfaces/node_base_interface.hpp>
 #include <rclcpp/node_interfaces/node_graph_interface.hpp>
 #include <rclcpp/node_interfaces/node_services_interface.hpp>
 
+#include <cstddef>
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "akit/failover/foros/command.hpp"
 #include "raft/commit_info.hpp"
+#include "raft/entry_codec.hpp"
 #include "raft/log_entry.hpp"
 
 namespace akit {
@@ -38,12 +44,17 @@ namespace raft {
 
 class OtherNode {
  public:
+  // AppendEntries requests of a broadcast by next index. Followers waiting for
+  // the same entry share one request, so the entry is copied only once.
+  using AppendEntriesRequestCache =
+      std::map<uint64_t, foros_msgs::srv::AppendEntries::Request::SharedPtr>;
+
   OtherNode(
       rclcpp::node_interfaces::NodeBaseInterface::SharedPtr node_base,
       rclcpp::node_interfaces::NodeGraphInterface::SharedPtr node_graph,
       rclcpp::node_interfaces::NodeServicesInterface::SharedPtr node_services,
       const std::string &cluster_name, const uint32_t node_id,
-      const uint64_t next_index,
+      const uint64_t next_index, const EntryCodec &codec,
       std::function<const std::shared_ptr<LogEntry>(uint64_t)>
           get_log_entry_callback);
 
@@ -51,7 +62,8 @@ class OtherNode {
                  const LogEntry::SharedPtr log,
                  std::function<void(const uint32_t, const uint64_t,
                                     const uint64_t, const bool)>
-                     callback);
+                     callback,
+                 AppendEntriesRequestCache &request_cache);
 
 
   /// original code 
@@ -83,9 +95,26 @@ bool request_vote(
 
 
   void update_match_index(const uint64_t match_index);
+
+  // Relay a command to this node as the leader. The callback is called with
+  // the id and the result of the commit once the node responds.
+  bool forward_commit(const Command::SharedPtr command,
+                      std::function<void(const uint64_t, const bool)> callback);
    
  private:
+  // limits of the entries sent in an AppendEntries request
+  static constexpr std::size_t kMaxBatchEntries = 64;
+  static constexpr std::size_t kMaxBatchSize = 1 << 20;
+
   std::vector<std::string> candidate_data; //////syc
+  foros_msgs::srv::AppendEntries::Request::SharedPtr
+  create_append_entries_request(const uint64_t current_term,
+                                const uint32_t node_id,
+                                const LogEntry::SharedPtr log,
+                                const uint64_t next_index);
+  void append_entry(const LogEntry::SharedPtr base,
+                    const LogEntry::SharedPtr entry, const bool with_header,
+                    foros_msgs::srv::AppendEntries::Request &request);
   void send_append_entries(
       const foros_msgs::srv::AppendEntries::Request::SharedPtr request,
       std::function<void(const uint32_t, const uint64_t, const uint64_t,
@@ -98,8 +127,11 @@ bool request_vote(
   uint64_t next_index_;
   // index of highest log entry known to be replicated on this node
   uint64_t match_index_;
+  // encoder of the entries sent to this node
+  const EntryCodec codec_;
   rclcpp::Client<foros_msgs::srv::AppendEntries>::SharedPtr append_entries_;
   rclcpp::Client<foros_msgs::srv::RequestVote>::SharedPtr request_vote_;
+  rclcpp::Client<foros_msgs::srv::CommitCommand>::SharedPtr commit_command_;
   std::function<const std::shared_ptr<LogEntry>(uint64_t)>
       get_log_entry_callback_;
 
@@ -17,8 +17,13 @@
 #ifndef AKIT_FAILOVER_FOROS_RAFT_PENDING_COMMIT_HPP_
 #define AKIT_FAILOVER_FOROS_RAFT_PENDING_COMMIT_HPP_
 
+#include <functional>
 #include <map>
+#include <utility>
+#include <vector>
 
+#include "akit/failover/foros/commit_completion_queue.hpp"
+#include "akit/failover/foros/pool_allocator.hpp"
 #include "raft/commit_info.hpp"
 #include "raft/log_entry.hpp"
 
@@ -27,19 +32,70 @@ namespace failover {
 namespace foros {
 namespace raft {
 
+// Consecutive logs which are replicated and agreed at once.
 class PendingCommit {
  public:
+  FOROS_POOLED_SMART_PTR_DEFINITIONS(PendingCommit)
+
+  using ResultMap =
+      std::map<uint32_t, bool, std::less<uint32_t>,
+               PoolAllocator<std::pair<const uint32_t, bool>>>;
+
   PendingCommit(LogEntry::SharedPtr log,
                 CommandCommitResponseSharedPromise promise,
                 CommandCommitResponseSharedFuture future,
                 CommandCommitResponseCallback callback)
-      : log_(log), promise_(promise), future_(future), callback_(callback) {}
+      : log_(log),
+        promise_(promise),
+        future_(future),
+        callback_(callback),
+        persisted_(false) {}
+
+  PendingCommit(LogEntry::SharedPtr log, const uint64_t tag,
+                CommitCompletionQueue::SharedPtr completion_queue)
+      : log_(log),
+        tag_(tag),
+        completion_queue_(completion_queue),
+        persisted_(false) {}
+
+  PendingCommit(std::vector<LogEntry::SharedPtr> logs,
+                std::vector<CommandCommitResponseSharedPromise> promises,
+                std::vector<CommandCommitResponseSharedFuture> futures,
+                CommandCommitResponseCallback callback)
+      : log_(logs.back()),
+        callback_(callback),
+        batch_logs_(std::move(logs)),
+        batch_promises_(std::move(promises)),
+        batch_futures_(std::move(futures)),
+        persisted_(false) {}
+
+  uint64_t first_id() const {
+    return batch_logs_.empty() ? log_->id_ : batch_logs_.front()->id_;
+  }
+
+  // Get a log of the commit, or nullptr if the id is not in it.
+  LogEntry::SharedPtr log(const uint64_t id) const {
+    if (id < first_id() || id > log_->id_) {
+      return nullptr;
+    }
+    return batch_logs_.empty() ? log_ : batch_logs_[id - first_id()];
+  }
 
-  const LogEntry::SharedPtr log_;
+  const LogEntry::SharedPtr log_;  // the last log
   CommandCommitResponseSharedPromise promise_;
   CommandCommitResponseSharedFuture future_;
   CommandCommitResponseCallback callback_;
-  std::map<uint32_t, bool> result_map_;
+  // logs and their promises and futures of a batch commit, which are empty
+  // for a single log
+  const std::vector<LogEntry::SharedPtr> batch_logs_;
+  std::vector<CommandCommitResponseSharedPromise> batch_promises_;
+  std::vector<CommandCommitResponseSharedFuture> batch_futures_;
+  // tag and queue of a commit completed through a completion queue, which
+  // has no promise
+  uint64_t tag_ = 0;
+  CommitCompletionQueue::SharedPtr completion_queue_;
+  ResultMap result_map_;
+  bool persisted_;  // whether the logs are durable on this node
 };
 
 }  // namespace raft
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "raft/session_table.hpp"
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+SessionTable::SessionTable() {}
+
+SessionTable::SequenceState SessionTable::find(const uint64_t session_id,
+                                               const uint64_t sequence,
+                                               uint64_t &id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto session = sessions_.find(session_id);
+  if (session == sessions_.end() || session->second.sequence_ < sequence) {
+    return SequenceState::kNew;
+  }
+  if (session->second.sequence_ > sequence) {
+    return SequenceState::kStale;
+  }
+  id = session->second.id_;
+  return SequenceState::kCommitted;
+}
+
+SessionTable::SequenceState SessionTable::find(const Command &command,
+                                               uint64_t &id) {
+  if (command.session_id() == 0) {
+    return SequenceState::kNew;
+  }
+  return find(command.session_id(), command.sequence(), id);
+}
+
+bool SessionTable::apply(const uint64_t id,
+                         const Command::SharedPtr &command) {
+  if (command == nullptr || command->session_id() == 0) {
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &session = sessions_[command->session_id()];
+  auto existed = session.id_ != 0 || session.sequence_ != 0;
+  // a duplicate in the logs does not move the session back
+  if (existed == true && session.sequence_ >= command->sequence()) {
+    // the log applied again, e.g. after a restart, is not its own duplicate
+    if (session.id_ == id) {
+      return true;
+    }
+    duplicates_.insert(id);
+    return false;
+  }
+
+  undos_.push_back(Undo{id, command->session_id(), existed, session});
+  while (undos_.front().id_ + kRevertableSize < id) {
+    undos_.pop_front();
+  }
+  session = Session{command->sequence(), id};
+  return true;
+}
+
+void SessionTable::revert(const uint64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  while (undos_.empty() == false && undos_.back().id_ >= id) {
+    auto &undo = undos_.back();
+    if (undo.existed_ == true) {
+      sessions_[undo.session_id_] = undo.session_;
+    } else {
+      sessions_.erase(undo.session_id_);
+    }
+    undos_.pop_back();
+  }
+  duplicates_.erase(duplicates_.lower_bound(id), duplicates_.end());
+}
+
+bool SessionTable::is_duplicate(const uint64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return duplicates_.count(id) > 0;
+}
+
+void SessionTable::forget_duplicates(const uint64_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  duplicates_.erase(duplicates_.begin(), duplicates_.lower_bound(size));
+}
+
+std::vector<SessionTable::Entry> SessionTable::entries() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Entry> entries;
+  entries.reserve(sessions_.size());
+  for (auto &session : sessions_) {
+    entries.push_back(Entry{session.first, session.second.sequence_,
+                            session.second.id_});
+  }
+  return entries;
+}
+
+void SessionTable::merge(const std::vector<Entry> &entries) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &entry : entries) {
+    auto session = sessions_.find(entry.session_id_);
+    if (session == sessions_.end()) {
+      sessions_.emplace(entry.session_id_,
+                        Session{entry.sequence_, entry.id_});
+    } else if (session->second.sequence_ < entry.sequence_) {
+      session->second = Session{entry.sequence_, entry.id_};
+    }
+  }
+}
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
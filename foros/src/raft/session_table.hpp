@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_SESSION_TABLE_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_SESSION_TABLE_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "akit/failover/foros/command.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Latest sequence committed by each client session. It is applied with the
+// logs, so a retried sequence is found on the leader even if the previous
+// leader committed it. A session commits its sequences in order, so a log of
+// a sequence which is not later than the latest one is a duplicate.
+class SessionTable {
+ public:
+  enum class SequenceState {
+    kNew,        // not committed yet
+    kCommitted,  // the latest sequence of the session
+    kStale,      // older than the latest sequence, whose log is not known
+  };
+
+  struct Entry {
+    uint64_t session_id_;
+    uint64_t sequence_;
+    uint64_t id_;  // id of the log committing the sequence
+  };
+
+  // changes of this many logs are kept to be reverted
+  static constexpr uint64_t kRevertableSize = 4096;
+
+  SessionTable();
+
+  // Find a sequence of a session, and the id of the log committing it if it
+  // is committed.
+  SequenceState find(const uint64_t session_id, const uint64_t sequence,
+                     uint64_t &id);
+  // Find the sequence of a command, which is new if it is not of a session.
+  SequenceState find(const Command &command, uint64_t &id);
+
+  // Apply the session of a log. Returns false if the log is a duplicate.
+  bool apply(const uint64_t id, const Command::SharedPtr &command);
+  void revert(const uint64_t id);
+
+  // Whether an applied log is a duplicate, which is known for the logs from
+  // the size given to forget_duplicates().
+  bool is_duplicate(const uint64_t id);
+  // Forget the duplicates before the size, which are not asked for anymore.
+  void forget_duplicates(const uint64_t size);
+
+  std::vector<Entry> entries();
+  // merge the entries of a snapshot, keeping the later sequences
+  void merge(const std::vector<Entry> &entries);
+
+ private:
+  struct Session {
+    uint64_t sequence_;
+    uint64_t id_;
+  };
+
+  // previous state of a session changed by a log
+  struct Undo {
+    uint64_t id_;
+    uint64_t session_id_;
+    bool existed_;
+    Session session_;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<uint64_t, Session> sessions_;
+  std::deque<Undo> undos_;
+  std::set<uint64_t> duplicates_;  // ids of the duplicate logs
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_SESSION_TABLE_HPP_
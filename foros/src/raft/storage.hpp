@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_STORAGE_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_STORAGE_HPP_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "raft/hard_state.hpp"
+#include "raft/log_entry.hpp"
+#include "raft/term_index.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Persistence backend of ContextStore.
+// ContextStore keeps the state in memory and serializes calls to a storage, so
+// a storage only needs to make the given state survive a restart.
+class Storage {
+ public:
+  virtual ~Storage() {}
+
+  // Load the hard state. Returns the initial state if nothing is stored.
+  virtual HardState load_hard_state() = 0;
+  virtual bool store_hard_state(const HardState &state) = 0;
+
+  // Load the logs in order of id, starting from the given id.
+  virtual std::vector<LogEntry::SharedPtr> load_logs(
+      const uint64_t first_id) = 0;
+  virtual LogEntry::SharedPtr load_log(const uint64_t id) = 0;
+  virtual uint64_t load_logs_size() = 0;
+  // Store a log and make the log size id + 1.
+  virtual bool store_log(const LogEntry::SharedPtr log) = 0;
+  // Store consecutive logs and make the log size the last id + 1. Storages
+  // which can write them at once override this.
+  virtual bool store_logs(const std::vector<LogEntry::SharedPtr> &logs) {
+    for (auto &log : logs) {
+      if (store_log(log) == false) {
+        return false;
+      }
+    }
+    return true;
+  }
+  // Store consecutive logs which are already committed and make the commit
+  // size the last id + 1. Storages which can write both at once override
+  // this.
+  virtual bool store_committed_logs(
+      const std::vector<LogEntry::SharedPtr> &logs) {
+    return store_logs(logs) && store_commit_size(logs.back()->id_ + 1);
+  }
+  // Store consecutive logs like store_committed_logs if they are committed,
+  // otherwise like store_logs, and call the callback once they are durable
+  // or failed. Returns false without calling the callback if they can not be
+  // written. Storages syncing on their own thread override this to return
+  // before the logs are durable, so that later logs share a sync with them.
+  virtual bool persist_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                            const bool committed,
+                            std::function<void(bool)> callback) {
+    auto stored = committed ? store_committed_logs(logs) : store_logs(logs);
+    if (stored == false) {
+      return false;
+    }
+    callback(true);
+    return true;
+  }
+  // Discard the logs whose id is equal or greater than the given size.
+  virtual bool truncate_logs(const uint64_t size) = 0;
+
+  // Load the run-length term index. Runs beyond the log size may be returned
+  // if a write was interrupted, so callers must truncate them.
+  virtual std::vector<TermRun> load_term_index() = 0;
+  virtual bool store_term_index(const std::vector<TermRun> &runs) = 0;
+
+  // Load the number of logs applied by the application. It is stored without
+  // waiting for the logs, so it may be larger than the log size.
+  virtual uint64_t load_applied_size() = 0;
+  virtual bool store_applied_size(const uint64_t size) = 0;
+
+  // Load the number of logs known to be committed. The leader stores its logs
+  // before they are agreed, so the logs beyond this size are discarded on
+  // load. Returns the log size if nothing is stored.
+  virtual uint64_t load_commit_size() = 0;
+  virtual bool store_commit_size(const uint64_t size) = 0;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_STORAGE_HPP_
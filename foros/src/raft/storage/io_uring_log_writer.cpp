@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raft/storage/io_uring_log_writer.hpp"
+
+#include <rclcpp/logging.hpp>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+namespace {
+
+unsigned int load_acquire(const unsigned int *p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void store_release(unsigned int *p, const unsigned int value) {
+  __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+template <typename T>
+T *offset_pointer(void *base, const uint32_t offset) {
+  return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+}
+
+}  // namespace
+
+std::unique_ptr<IoUringLogWriter> IoUringLogWriter::create(
+    const int fd, const uint64_t offset, rclcpp::Logger &logger) {
+  auto writer = std::make_unique<IoUringLogWriter>(fd, offset, logger);
+  if (writer->ring_fd_ < 0) {
+    return nullptr;
+  }
+  return writer;
+}
+
+IoUringLogWriter::IoUringLogWriter(const int fd, const uint64_t offset,
+                                   rclcpp::Logger &logger)
+    : LogWriter(fd, offset, logger),
+      ring_fd_(-1),
+      sq_ring_(MAP_FAILED),
+      sq_ring_size_(0),
+      cq_ring_(MAP_FAILED),
+      cq_ring_size_(0),
+      sqes_(static_cast<struct io_uring_sqe *>(MAP_FAILED)),
+      sqes_size_(0) {
+  if (setup() == false) {
+    teardown();
+    return;
+  }
+  start();
+}
+
+IoUringLogWriter::~IoUringLogWriter() {
+  stop();
+  teardown();
+}
+
+bool IoUringLogWriter::setup() {
+  struct io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+
+  ring_fd_ =
+      static_cast<int>(syscall(__NR_io_uring_setup, kQueueDepth, &params));
+  if (ring_fd_ < 0) {
+    RCLCPP_WARN(logger_, "io_uring setup failed: %s", std::strerror(errno));
+    return false;
+  }
+
+  sq_ring_size_ =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  auto single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap == true) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    return false;
+  }
+
+  if (single_mmap == true) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      return false;
+    }
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqes_ = static_cast<struct io_uring_sqe *>(
+      mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+  if (sqes_ == MAP_FAILED) {
+    return false;
+  }
+
+  sq_head_ = offset_pointer<unsigned int>(sq_ring_, params.sq_off.head);
+  sq_tail_ = offset_pointer<unsigned int>(sq_ring_, params.sq_off.tail);
+  sq_mask_ = offset_pointer<unsigned int>(sq_ring_, params.sq_off.ring_mask);
+  sq_array_ = offset_pointer<unsigned int>(sq_ring_, params.sq_off.array);
+  cq_head_ = offset_pointer<unsigned int>(cq_ring_, params.cq_off.head);
+  cq_tail_ = offset_pointer<unsigned int>(cq_ring_, params.cq_off.tail);
+  cq_mask_ = offset_pointer<unsigned int>(cq_ring_, params.cq_off.ring_mask);
+  cqes_ = offset_pointer<struct io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+  return probe();
+}
+
+bool IoUringLogWriter::probe() {
+  // the ring can be created by kernels older than the operations it uses
+  std::vector<uint8_t> buffer(sizeof(struct io_uring_probe) +
+                              IORING_OP_LAST * sizeof(struct io_uring_probe_op));
+  auto probe = reinterpret_cast<struct io_uring_probe *>(buffer.data());
+  if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe,
+              IORING_OP_LAST) < 0) {
+    RCLCPP_WARN(logger_, "io_uring probe failed: %s", std::strerror(errno));
+    return false;
+  }
+
+  for (auto op : {IORING_OP_WRITE, IORING_OP_FSYNC}) {
+    if (op > probe->last_op ||
+        (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) {
+      RCLCPP_WARN(logger_, "io_uring operation %d is not supported", op);
+      return false;
+    }
+  }
+  return true;
+}
+
+void IoUringLogWriter::teardown() {
+  if (sqes_ != MAP_FAILED) {
+    munmap(sqes_, sqes_size_);
+    sqes_ = static_cast<struct io_uring_sqe *>(MAP_FAILED);
+  }
+  if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  cq_ring_ = MAP_FAILED;
+  if (sq_ring_ != MAP_FAILED) {
+    munmap(sq_ring_, sq_ring_size_);
+    sq_ring_ = MAP_FAILED;
+  }
+  if (ring_fd_ >= 0) {
+    close(ring_fd_);
+    ring_fd_ = -1;
+  }
+}
+
+bool IoUringLogWriter::write(const std::vector<const std::string *> &records,
+                             const uint64_t offset) {
+  if (ring_fd_ < 0) {
+    return false;
+  }
+
+  // a submission holds kQueueDepth - 1 writes and the sync
+  auto position = offset;
+  for (std::size_t begin = 0; begin < records.size();
+       begin += kQueueDepth - 1) {
+    auto end = std::min<std::size_t>(records.size(), begin + kQueueDepth - 1);
+    if (submit(records, begin, end, position) == false) {
+      return false;
+    }
+    for (auto i = begin; i < end; i++) {
+      position += records[i]->size();
+    }
+  }
+  return true;
+}
+
+bool IoUringLogWriter::submit(const std::vector<const std::string *> &records,
+                              const std::size_t begin, const std::size_t end,
+                              const uint64_t offset) {
+  auto position = offset;
+  for (auto i = begin; i < end; i++) {
+    auto sqe = get_sqe();
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd_;
+    sqe->off = position;
+    sqe->addr = reinterpret_cast<uint64_t>(records[i]->data());
+    sqe->len = static_cast<uint32_t>(records[i]->size());
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = records[i]->size();
+    position += records[i]->size();
+  }
+
+  // the sync runs only if every linked write succeeded
+  auto sqe = get_sqe();
+  sqe->opcode = IORING_OP_FSYNC;
+  sqe->fd = fd_;
+  sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+  sqe->user_data = 0;
+
+  auto count = static_cast<unsigned int>(end - begin + 1);
+  if (enter(count) == false) {
+    return false;
+  }
+
+  auto result = true;
+  auto head = *cq_head_;
+  for (unsigned int i = 0; i < count; i++, head++) {
+    auto &cqe = cqes_[head & *cq_mask_];
+    // a short write cancels the rest of the chain, so it is a failure too
+    if (cqe.res < 0 || static_cast<uint64_t>(cqe.res) != cqe.user_data) {
+      result = false;
+    }
+  }
+  store_release(cq_head_, head);
+
+  if (result == false) {
+    RCLCPP_ERROR(logger_, "log write failed");
+  }
+  return result;
+}
+
+struct io_uring_sqe *IoUringLogWriter::get_sqe() {
+  auto tail = *sq_tail_;
+  auto index = tail & *sq_mask_;
+  auto sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sq_array_[index] = index;
+  store_release(sq_tail_, tail + 1);
+  return sqe;
+}
+
+bool IoUringLogWriter::enter(const unsigned int count) {
+  auto to_submit = count;
+  while (true) {
+    auto completed = load_acquire(cq_tail_) - *cq_head_;
+    if (to_submit == 0 && completed >= count) {
+      return true;
+    }
+
+    auto ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit,
+                       count - completed, IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      RCLCPP_ERROR(logger_, "io_uring enter failed: %s", std::strerror(errno));
+      drain(count);
+      return false;
+    }
+    to_submit -= std::min<unsigned int>(to_submit, ret);
+  }
+}
+
+void IoUringLogWriter::drain(const unsigned int count) {
+  // the requests not taken by the kernel are dropped
+  auto head = load_acquire(sq_head_);
+  auto submitted = count - (*sq_tail_ - head);
+  store_release(sq_tail_, head);
+
+  // the records of the taken requests are freed by the caller, so wait until
+  // the kernel is done with them
+  while (load_acquire(cq_tail_) - *cq_head_ < submitted) {
+    auto pending = submitted - (load_acquire(cq_tail_) - *cq_head_);
+    auto ret = syscall(__NR_io_uring_enter, ring_fd_, 0, pending,
+                       IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (ret < 0 && errno != EINTR) {
+      // closing the ring cancels the requests left
+      RCLCPP_ERROR(logger_, "io_uring drain failed: %s", std::strerror(errno));
+      teardown();
+      return;
+    }
+  }
+  store_release(cq_head_, load_acquire(cq_tail_));
+}
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
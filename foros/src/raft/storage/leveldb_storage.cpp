@@ -0,0 +1,871 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raft/storage/leveldb_storage.hpp"
+
+#include <leveldb/db.h>
+#include <leveldb/iterator.h>
+#include <leveldb/write_batch.h>
+#include <rclcpp/logging.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/byte_order.hpp"
+#include "common/crc32c.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+LevelDBStorage::LevelDBStorage(const std::string &path,
+                               rclcpp::Logger &logger)
+    : db_(nullptr),
+      logger_(logger.get_child("storage")),
+      logs_size_(0),
+      gc_requested_(false),
+      gc_stopped_(false) {
+  leveldb::Options options;
+  options.create_if_missing = true;
+
+  auto status = leveldb::DB::Open(options, path, &db_);
+
+  if (status.ok() == false || db_ == nullptr) {
+    RCLCPP_ERROR(logger_, "db open failed: %s", status.ToString().c_str());
+    return;
+  }
+
+  init_format();
+  start_garbage_collector();
+}
+
+LevelDBStorage::~LevelDBStorage() {
+  stop_garbage_collector();
+
+  if (db_ != nullptr) {
+    delete db_;
+  }
+}
+
+HardState LevelDBStorage::load_hard_state() {
+  HardState state;
+
+  if (db_ == nullptr) {
+    return state;
+  }
+
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions(), kHardStateKey, &value);
+
+  if (status.ok() == false) {
+    if (status.IsNotFound() == false) {
+      RCLCPP_ERROR(logger_, "hard state get failed: %s",
+                   status.ToString().c_str());
+      return state;
+    }
+    migrate_legacy_hard_state(state);
+    return state;
+  }
+
+  if (value.size() != kHardStateSize) {
+    RCLCPP_ERROR(logger_, "hard state value size is invalid");
+    return state;
+  }
+
+  state.term_ = ByteOrder::decode_big_endian64(value.data());
+  state.voted_for_ =
+      ByteOrder::decode_big_endian32(value.data() + sizeof(uint64_t));
+  state.voted_ = value[sizeof(uint64_t) + sizeof(uint32_t)] != 0;
+  return state;
+}
+
+bool LevelDBStorage::store_hard_state(const HardState &state) {
+  if (db_ == nullptr) {
+    //RCLCPP_ERROR(logger_, "db is nullptr");
+    return false;
+  }
+
+  char value[kHardStateSize];
+  encode_hard_state(state, value);
+
+  auto status = db_->Put(leveldb::WriteOptions(), kHardStateKey,
+                         leveldb::Slice(value, kHardStateSize));
+  if (status.ok() == false) {
+    RCLCPP_ERROR(logger_, "hard state set failed: %s",
+                 status.ToString().c_str());
+    return false;
+  }
+  return true;
+}
+
+std::vector<TermRun> LevelDBStorage::load_term_index() {
+  std::vector<TermRun> runs;
+
+  if (db_ == nullptr) {
+    return runs;
+  }
+
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions(), kTermIndexKey, &value);
+  if (status.ok() == false) {
+    if (status.IsNotFound() == false) {
+      RCLCPP_ERROR(logger_, "term index get failed: %s",
+                   status.ToString().c_str());
+    }
+    return runs;
+  }
+
+  if (value.size() % kTermRunSize != 0) {
+    RCLCPP_ERROR(logger_, "term index value size is invalid");
+    return runs;
+  }
+
+  for (std::size_t offset = 0; offset < value.size();
+       offset += kTermRunSize) {
+    auto data = value.data() + offset;
+    runs.emplace_back(ByteOrder::decode_big_endian64(data),
+                      ByteOrder::decode_big_endian64(data + sizeof(uint64_t)));
+  }
+  return runs;
+}
+
+bool LevelDBStorage::store_term_index(const std::vector<TermRun> &runs) {
+  if (db_ == nullptr) {
+    return false;
+  }
+
+  std::string value(runs.size() * kTermRunSize, '\0');
+  for (std::size_t i = 0; i < runs.size(); i++) {
+    auto data = &value[i * kTermRunSize];
+    ByteOrder::encode_big_endian64(data, runs[i].term_);
+    ByteOrder::encode_big_endian64(data + sizeof(uint64_t),
+                                   runs[i].first_id_);
+  }
+
+  auto status = db_->Put(leveldb::WriteOptions(), kTermIndexKey, value);
+  if (status.ok() == false) {
+    RCLCPP_ERROR(logger_, "term index set failed: %s",
+                 status.ToString().c_str());
+    return false;
+  }
+  return true;
+}
+
+uint64_t LevelDBStorage::load_applied_size() {
+  if (db_ == nullptr) {
+    return 0;
+  }
+
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions(), kAppliedSizeKey, &value);
+  if (status.ok() == false) {
+    if (status.IsNotFound() == false) {
+      RCLCPP_ERROR(logger_, "applied size get failed: %s",
+                   status.ToString().c_str());
+    }
+    return 0;
+  }
+
+  if (value.size() != sizeof(uint64_t)) {
+    RCLCPP_ERROR(logger_, "applied size value size is invalid");
+    return 0;
+  }
+
+  return ByteOrder::decode_big_endian64(value.data());
+}
+
+bool LevelDBStorage::store_applied_size(const uint64_t size) {
+  if (db_ == nullptr) {
+    return false;
+  }
+
+  char value[sizeof(uint64_t)];
+  ByteOrder::encode_big_endian64(value, size);
+  auto status = db_->Put(leveldb::WriteOptions(), kAppliedSizeKey,
+                         leveldb::Slice(value, sizeof(value)));
+  if (status.ok() == false) {
+    RCLCPP_ERROR(logger_, "applied size set failed: %s",
+                 status.ToString().c_str());
+    return false;
+  }
+  return true;
+}
+
+uint64_t LevelDBStorage::load_commit_size() {
+  if (db_ == nullptr) {
+    return 0;
+  }
+
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions(), kCommitSizeKey, &value);
+  if (status.ok() == false) {
+    if (status.IsNotFound() == false) {
+      RCLCPP_ERROR(logger_, "commit size get failed: %s",
+                   status.ToString().c_str());
+    }
+    return load_logs_size();
+  }
+
+  if (value.size() != sizeof(uint64_t)) {
+    RCLCPP_ERROR(logger_, "commit size value size is invalid");
+    return load_logs_size();
+  }
+
+  return ByteOrder::decode_big_endian64(value.data());
+}
+
+bool LevelDBStorage::store_commit_size(const uint64_t size) {
+  if (db_ == nullptr) {
+    return false;
+  }
+
+  char value[sizeof(uint64_t)];
+  ByteOrder::encode_big_endian64(value, size);
+  auto status = db_->Put(leveldb::WriteOptions(), kCommitSizeKey,
+                         leveldb::Slice(value, sizeof(value)));
+  if (status.ok() == false) {
+    RCLCPP_ERROR(logger_, "commit size set failed: %s",
+                 status.ToString().c_str());
+    return false;
+  }
+  return true;
+}
+
+void LevelDBStorage::encode_hard_state(const HardState &state,
+                                       char *buffer) const {
+  ByteOrder::encode_big_endian64(buffer, state.term_);
+  ByteOrder::encode_big_endian32(buffer + sizeof(uint64_t), state.voted_for_);
+  buffer[sizeof(uint64_t) + sizeof(uint32_t)] = state.voted_ ? 1 : 0;
+}
+
+bool LevelDBStorage::migrate_legacy_hard_state(HardState &state) {
+  state.term_ = load_legacy_current_term();
+  state.voted_for_ = load_legacy_voted_for();
+  state.voted_ = load_legacy_voted();
+
+  char value[kHardStateSize];
+  encode_hard_state(state, value);
+
+  leveldb::WriteBatch batch;
+  batch.Put(kHardStateKey, leveldb::Slice(value, kHardStateSize));
+  batch.Delete(kLegacyCurrentTermKey);
+  batch.Delete(kLegacyVotedForKey);
+  batch.Delete(kLegacyVotedKey);
+
+  leveldb::WriteOptions options;
+  options.sync = true;
+  auto status = db_->Write(options, &batch);
+  if (status.ok() == false) {
+    RCLCPP_ERROR(logger_, "hard state migration failed: %s",
+                 status.ToString().c_str());
+    return false;
+  }
+  return true;
+}
+
+uint64_t LevelDBStorage::load_legacy_current_term() {
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions(), kLegacyCurrentTermKey, &value);
+
+  if (status.ok() == false) {
+    if (status.IsNotFound() == false) {
+      RCLCPP_ERROR(logger_, "current_term get failed: %s",
+                   status.ToString().c_str());
+    }
+    return 0;
+  }
+
+  if (value.size() != sizeof(uint64_t)) {
+    RCLCPP_ERROR(logger_, "current_term value size is invalid");
+    return 0;
+  }
+
+  return *(reinterpret_cast<const uint64_t *>(value.data()));
+}
+
+uint32_t LevelDBStorage::load_legacy_voted_for() {
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions(), kLegacyVotedForKey, &value);
+
+  if (status.ok() == false) {
+    if (status.IsNotFound() == false) {
+      RCLCPP_ERROR(logger_, "voted_for get failed: %s",
+                   status.ToString().c_str());
+    }
+    return 0;
+  }
+
+  if (value.size() != sizeof(uint32_t)) {
+    RCLCPP_ERROR(logger_, "voted_for value size is invalid");
+    return 0;
+  }
+
+  return *(reinterpret_cast<const uint32_t *>(value.data()));
+}
+
+bool LevelDBStorage::load_legacy_voted() {
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions(), kLegacyVotedKey, &value);
+
+  if (status.ok() == false) {
+    if (status.IsNotFound() == false) {
+      RCLCPP_ERROR(logger_, "voted get failed: %s", status.ToString().c_str());
+    }
+    return false;
+  }
+
+  if (value.size() != sizeof(bool)) {
+    RCLCPP_ERROR(logger_, "voted value size is invalid");
+    return false;
+  }
+
+  return *(reinterpret_cast<const bool *>(value.data()));
+}
+
+void LevelDBStorage::init_format() {
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions(), kFormatVersionKey, &value);
+
+  if (status.ok() == false) {
+    if (status.IsNotFound() == false) {
+      RCLCPP_ERROR(logger_, "format version get failed: %s",
+                   status.ToString().c_str());
+    }
+    migrate_legacy_logs();
+    return;
+  }
+
+  if (value.size() != sizeof(uint32_t)) {
+    RCLCPP_ERROR(logger_, "format version value size is invalid");
+    return;
+  }
+
+  auto version = ByteOrder::decode_big_endian32(value.data());
+  if (version > kFormatVersion) {
+    // the versions before 4 are stored in host byte order
+    auto host_version = *(reinterpret_cast<const uint32_t *>(value.data()));
+    if (host_version < kBigEndianSizeVersion) {
+      version = host_version;
+    }
+  }
+  if (version > kFormatVersion) {
+    // do not touch a store written by a newer version
+    RCLCPP_ERROR(logger_, "unsupported store format version: %u", version);
+    delete db_;
+    db_ = nullptr;
+    return;
+  }
+
+  if (version < kFormatVersion) {
+    migrate_logs(version);
+  }
+}
+
+bool LevelDBStorage::migrate_legacy_logs() {
+  leveldb::WriteBatch batch;
+
+  // legacy keys are removed first since a legacy key and a new key share the
+  // same prefix
+  std::unique_ptr<leveldb::Iterator> it(
+      db_->NewIterator(leveldb::ReadOptions()));
+  for (it->Seek(kLogKeyPrefix);
+       it->Valid() && it->key().starts_with(kLogKeyPrefix); it->Next()) {
+    batch.Delete(it->key());
+  }
+  it.reset();
+
+  uint64_t size = read_host_order_logs_size();
+  uint64_t id;
+  char key[kLogKeySize];
+  std::string term_value;
+  std::string data_value;
+  for (id = 0; id < size; id++) {
+    auto status = db_->Get(leveldb::ReadOptions(),
+                           get_legacy_log_key(id, kLegacyLogTermKeySuffix),
+                           &term_value);
+    if (status.ok() == false || term_value.size() < sizeof(uint64_t)) {
+      break;
+    }
+
+    status = db_->Get(leveldb::ReadOptions(),
+                      get_legacy_log_key(id, kLegacyLogDataKeySuffix),
+                      &data_value);
+    if (status.ok() == false) {
+      break;
+    }
+
+    // legacy terms were stored in host byte order
+    auto term = *(reinterpret_cast<const uint64_t *>(term_value.data()));
+    batch.Put(get_log_key(id, key),
+              encode_log(term, CommandHeader(), data_value.data(),
+                         data_value.size()));
+  }
+
+  if (id > 0) {
+    RCLCPP_INFO(logger_, "migrating %lu logs to format version %u", id,
+                kFormatVersion);
+  }
+
+  put_logs_size(batch, id);
+  put_format_version(batch);
+
+  leveldb::WriteOptions options;
+  options.sync = true;
+  auto status = db_->Write(options, &batch);
+  if (status.ok() == false) {
+    RCLCPP_ERROR(logger_, "log migration failed: %s",
+                 status.ToString().c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool LevelDBStorage::migrate_logs(const uint32_t from_version) {
+  leveldb::WriteBatch batch;
+  uint64_t count = 0;
+  uint64_t id;
+  // version 1 stores the term and the command data only
+  auto data_offset = from_version == 1 ? kLogTermSize : kLogHeaderSize;
+
+  // the records of version 3 are kept as they are
+  std::unique_ptr<leveldb::Iterator> it(
+      db_->NewIterator(leveldb::ReadOptions()));
+  for (it->Seek(kLogKeyPrefix); from_version < kCommandHeaderVersion &&
+                                it->Valid() &&
+                                it->key().starts_with(kLogKeyPrefix);
+       it->Next()) {
+    auto value = it->value();
+    if (parse_log_key(it->key(), &id) == false ||
+        value.size() < data_offset) {
+      continue;
+    }
+    auto term = ByteOrder::decode_big_endian64(value.data());
+    auto migrated = encode_log(term, CommandHeader(),
+                               value.data() + data_offset,
+                               value.size() - data_offset);
+    if (from_version > 1 &&
+        CRC32C::extend(CRC32C::value(value.data(), kLogTermSize),
+                       value.data() + kLogHeaderSize,
+                       value.size() - kLogHeaderSize) !=
+            ByteOrder::decode_big_endian32(value.data() + kLogTermSize)) {
+      // a corrupted log keeps its checksum, so that it stays corrupted
+      std::memcpy(&migrated[kLogTermSize], value.data() + kLogTermSize,
+                  kLogChecksumSize);
+    }
+    batch.Put(it->key(), migrated);
+    count++;
+  }
+  it.reset();
+
+  if (count > 0) {
+    RCLCPP_INFO(logger_, "migrating %lu logs to format version %u", count,
+                kFormatVersion);
+  }
+
+  put_logs_size(batch, read_host_order_logs_size());
+  put_format_version(batch);
+
+  leveldb::WriteOptions options;
+  options.sync = true;
+  auto status = db_->Write(options, &batch);
+  if (status.ok() == false) {
+    RCLCPP_ERROR(logger_, "log migration failed: %s",
+                 status.ToString().c_str());
+    return false;
+  }
+
+  return true;
+}
+
+uint64_t LevelDBStorage::load_logs_size() {
+  std::lock_guard<std::mutex> lock(log_mutex_);
+  return read_logs_size();
+}
+
+uint64_t LevelDBStorage::read_logs_size() {
+  if (db_ == nullptr) {
+    //RCLCPP_ERROR(logger_, "db is nullptr");
+    return 0;
+  }
+
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions(), kLogSizeKey, &value);
+
+  if (status.ok() == false) {
+    if (status.IsNotFound() == false) {
+      RCLCPP_ERROR(logger_, "logs size get failed: %s",
+                   status.ToString().c_str());
+    }
+    return 0;
+  }
+
+  if (value.size() != sizeof(uint64_t)) {
+    RCLCPP_ERROR(logger_, "logs size value size is invalid");
+    return 0;
+  }
+
+  return ByteOrder::decode_big_endian64(value.data());
+}
+
+uint64_t LevelDBStorage::read_host_order_logs_size() {
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions(), kLogSizeKey, &value);
+  if (status.ok() == false || value.size() != sizeof(uint64_t)) {
+    return 0;
+  }
+
+  return *(reinterpret_cast<const uint64_t *>(value.data()));
+}
+
+void LevelDBStorage::put_logs_size(leveldb::WriteBatch &batch,
+                                   const uint64_t size) const {
+  char value[sizeof(uint64_t)];
+  ByteOrder::encode_big_endian64(value, size);
+  batch.Put(kLogSizeKey, leveldb::Slice(value, sizeof(value)));
+}
+
+void LevelDBStorage::put_format_version(leveldb::WriteBatch &batch) const {
+  char value[sizeof(uint32_t)];
+  ByteOrder::encode_big_endian32(value, kFormatVersion);
+  batch.Put(kFormatVersionKey, leveldb::Slice(value, sizeof(value)));
+}
+
+bool LevelDBStorage::store_logs_size(const uint64_t size) {
+  if (db_ == nullptr) {
+    //RCLCPP_ERROR(logger_, "db is nullptr");
+    return false;
+  }
+
+  leveldb::WriteBatch batch;
+  put_logs_size(batch, size);
+  auto status = db_->Write(leveldb::WriteOptions(), &batch);
+  if (status.ok() == false) {
+    RCLCPP_ERROR(logger_, "logs size set failed: %s",
+                 status.ToString().c_str());
+    return false;
+  }
+  return true;
+}
+
+std::vector<LogEntry::SharedPtr> LevelDBStorage::load_logs(
+    const uint64_t first_id) {
+  std::vector<LogEntry::SharedPtr> logs;
+
+  if (db_ == nullptr) {
+    return logs;
+  }
+
+  std::lock_guard<std::mutex> lock(log_mutex_);
+
+  uint64_t size = read_logs_size();
+  if (first_id > size) {
+    return logs;
+  }
+
+  uint64_t id;
+  char key[kLogKeySize];
+
+  std::unique_ptr<leveldb::Iterator> it(
+      db_->NewIterator(leveldb::ReadOptions()));
+  for (it->Seek(get_log_key(first_id, key));
+       it->Valid() && first_id + logs.size() < size; it->Next()) {
+    if (parse_log_key(it->key(), &id) == false ||
+        id != first_id + logs.size()) {
+      break;
+    }
+
+    auto log = decode_log(id, it->value());
+    if (log == nullptr) {
+      break;
+    }
+    logs.push_back(log);
+  }
+
+  logs_size_ = first_id + logs.size();
+  if (logs_size_ != size) {
+    RCLCPP_ERROR(logger_, "only %lu of %lu logs are loaded", logs_size_, size);
+    store_logs_size(logs_size_);
+  }
+
+  // records left behind by reverts before the last shutdown
+  if (it->Valid() && parse_log_key(it->key(), &id) == true) {
+    request_garbage_collection();
+  }
+
+  return logs;
+}
+
+LogEntry::SharedPtr LevelDBStorage::load_log(const uint64_t id) {
+  if (db_ == nullptr) {
+    //RCLCPP_ERROR(logger_, "db is nullptr");
+    return nullptr;
+  }
+
+  char key[kLogKeySize];
+  std::string value;
+  auto status = db_->Get(leveldb::ReadOptions(), get_log_key(id, key), &value);
+
+  if (status.ok() == false) {
+    if (status.IsNotFound() == false) {
+      RCLCPP_ERROR(logger_, "log for %lu get failed: %s", id,
+                   status.ToString().c_str());
+    }
+    return nullptr;
+  }
+
+  return decode_log(id, value);
+}
+
+LogEntry::SharedPtr LevelDBStorage::decode_log(const uint64_t id,
+                                               const leveldb::Slice &value) {
+  if (value.size() < kLogHeaderSize) {
+    RCLCPP_ERROR(logger_, "log value size for %lu is invalid", id);
+    return nullptr;
+  }
+
+  // a corrupted log is treated as missing, so that it is fetched again from
+  // the leader
+  auto data = value.data() + kLogHeaderSize;
+  auto size = value.size() - kLogHeaderSize;
+  auto checksum = CRC32C::extend(CRC32C::value(value.data(), kLogTermSize),
+                                 data, size);
+  if (checksum != ByteOrder::decode_big_endian32(value.data() + kLogTermSize)) {
+    RCLCPP_ERROR(logger_, "log checksum for %lu mismatches", id);
+    return nullptr;
+  }
+
+  CommandHeader header;
+  auto header_size =
+      header.decode(reinterpret_cast<const uint8_t *>(data), size);
+  if (header_size == 0) {
+    RCLCPP_ERROR(logger_, "log header for %lu is invalid", id);
+    return nullptr;
+  }
+
+  auto term = ByteOrder::decode_big_endian64(value.data());
+  auto command = Command::make_shared(data + header_size, size - header_size);
+  header.apply(*command);
+
+  return LogEntry::make_shared(id, term, command);
+}
+
+std::string LevelDBStorage::encode_log(const uint64_t term,
+                                       const CommandHeader &header,
+                                       const char *data,
+                                       const std::size_t size) const {
+  std::string value(kLogHeaderSize + header.size(), '\0');
+  value.reserve(kLogHeaderSize + header.size() + size);
+  ByteOrder::encode_big_endian64(&value[0], term);
+  header.encode(reinterpret_cast<uint8_t *>(&value[kLogHeaderSize]));
+  value.append(data, size);
+  auto checksum = CRC32C::extend(
+      CRC32C::value(value.data(), kLogTermSize),
+      value.data() + kLogHeaderSize, value.size() - kLogHeaderSize);
+  ByteOrder::encode_big_endian32(&value[kLogTermSize], checksum);
+  return value;
+}
+
+bool LevelDBStorage::store_log(const LogEntry::SharedPtr log) {
+  return write_logs(&log, 1);
+}
+
+bool LevelDBStorage::store_logs(const std::vector<LogEntry::SharedPtr> &logs) {
+  return logs.empty() == true || write_logs(logs.data(), logs.size());
+}
+
+bool LevelDBStorage::store_committed_logs(
+    const std::vector<LogEntry::SharedPtr> &logs) {
+  return logs.empty() == true || write_logs(logs.data(), logs.size(), true);
+}
+
+bool LevelDBStorage::write_logs(const LogEntry::SharedPtr *logs,
+                                const std::size_t count,
+                                const bool committed) {
+  if (db_ == nullptr) {
+    // RCLCPP_ERROR(logger_, "db is nullptr");
+    return false;
+  }
+
+  // the logs and the size are written in a single batch
+  char key[kLogKeySize];
+  leveldb::WriteBatch batch;
+  for (std::size_t i = 0; i < count; i++) {
+    auto data = logs[i]->command_->view();
+    batch.Put(get_log_key(logs[i]->id_, key),
+              encode_log(logs[i]->term_, CommandHeader(*logs[i]->command_),
+                         reinterpret_cast<const char *>(data.data()),
+                         data.size()));
+  }
+
+  uint64_t size = logs[count - 1]->id_ + 1;
+  put_logs_size(batch, size);
+  if (committed == true) {
+    char value[sizeof(uint64_t)];
+    ByteOrder::encode_big_endian64(value, size);
+    batch.Put(kCommitSizeKey, leveldb::Slice(value, sizeof(value)));
+  }
+
+  std::lock_guard<std::mutex> lock(log_mutex_);
+  auto status = db_->Write(leveldb::WriteOptions(), &batch);
+  if (status.ok() == false) {
+    RCLCPP_ERROR(logger_, "log for %lu set failed: %s", logs[0]->id_,
+                 status.ToString().c_str());
+    return false;
+  }
+  logs_size_ = size;
+
+  return true;
+}
+
+bool LevelDBStorage::truncate_logs(const uint64_t size) {
+  std::lock_guard<std::mutex> lock(log_mutex_);
+  if (store_logs_size(size) == false) {
+    return false;
+  }
+  logs_size_ = size;
+  request_garbage_collection();
+  return true;
+}
+
+leveldb::Slice LevelDBStorage::get_log_key(const uint64_t id,
+                                           char *buffer) const {
+  std::memcpy(buffer, kLogKeyPrefix, kLogKeyPrefixSize);
+  ByteOrder::encode_big_endian64(buffer + kLogKeyPrefixSize, id);
+  return leveldb::Slice(buffer, kLogKeySize);
+}
+
+bool LevelDBStorage::parse_log_key(const leveldb::Slice &key,
+                                   uint64_t *id) const {
+  if (key.size() != kLogKeySize || key.starts_with(kLogKeyPrefix) == false) {
+    return false;
+  }
+
+  *id = ByteOrder::decode_big_endian64(key.data() + kLogKeyPrefixSize);
+  return true;
+}
+
+std::string LevelDBStorage::get_legacy_log_key(const uint64_t id,
+                                               const char *suffix) const {
+  return std::string(kLogKeyPrefix + std::to_string(id) + suffix);
+}
+
+void LevelDBStorage::start_garbage_collector() {
+  if (db_ == nullptr) {
+    return;
+  }
+
+  gc_thread_ = std::thread(&LevelDBStorage::run_garbage_collector, this);
+}
+
+void LevelDBStorage::stop_garbage_collector() {
+  {
+    std::lock_guard<std::mutex> lock(gc_mutex_);
+    gc_stopped_ = true;
+  }
+  gc_condition_.notify_one();
+
+  if (gc_thread_.joinable()) {
+    gc_thread_.join();
+  }
+}
+
+void LevelDBStorage::request_garbage_collection() {
+  {
+    std::lock_guard<std::mutex> lock(gc_mutex_);
+    gc_requested_ = true;
+  }
+  gc_condition_.notify_one();
+}
+
+void LevelDBStorage::run_garbage_collector() {
+  std::unique_lock<std::mutex> lock(gc_mutex_);
+  while (true) {
+    gc_condition_.wait(lock, [this] { return gc_requested_ || gc_stopped_; });
+    // a requested collection is finished before the storage is closed
+    if (gc_requested_ == false) {
+      return;
+    }
+    gc_requested_ = false;
+
+    lock.unlock();
+    auto deleted = collect_garbage();
+    lock.lock();
+
+    if (deleted > 0) {
+      RCLCPP_DEBUG(logger_, "%lu orphaned log records deleted", deleted);
+    }
+  }
+}
+
+uint64_t LevelDBStorage::collect_garbage() {
+  uint64_t deleted = 0;
+  uint64_t first = 0;
+  uint64_t id;
+  char key[kLogKeySize];
+
+  while (true) {
+    leveldb::WriteBatch batch;
+    std::size_t count = 0;
+
+    // the log mutex prevents deleting a record stored again meanwhile
+    std::lock_guard<std::mutex> lock(log_mutex_);
+    std::unique_ptr<leveldb::Iterator> it(
+        db_->NewIterator(leveldb::ReadOptions()));
+    for (it->Seek(get_log_key(logs_size_, key));
+         it->Valid() && count < kGarbageCollectionBatchSize; it->Next()) {
+      if (parse_log_key(it->key(), &id) == false) {
+        break;
+      }
+      if (deleted == 0 && count == 0) {
+        first = id;
+      }
+      batch.Delete(it->key());
+      count++;
+    }
+
+    if (count == 0) {
+      break;
+    }
+
+    auto status = db_->Write(leveldb::WriteOptions(), &batch);
+    if (status.ok() == false) {
+      RCLCPP_ERROR(logger_, "orphaned logs delete failed: %s",
+                   status.ToString().c_str());
+      break;
+    }
+    deleted += count;
+  }
+
+  if (deleted > 0) {
+    char begin_key[kLogKeySize];
+    char end_key[kLogKeySize];
+    auto begin = get_log_key(first, begin_key);
+    auto end = get_log_key(UINT64_MAX, end_key);
+    db_->CompactRange(&begin, &end);
+  }
+
+  return deleted;
+}
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
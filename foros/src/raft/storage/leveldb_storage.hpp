@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_STORAGE_LEVELDB_STORAGE_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_STORAGE_LEVELDB_STORAGE_HPP_
+
+#include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+#include <rclcpp/logger.hpp>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "raft/command_header.hpp"
+#include "raft/storage.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Stores commands as they are, without the EntryCodec of the WAL storage.
+// LevelDB already compresses neighbouring records of a block with snappy, and
+// a delta would make load_log read the chain of logs it is based on.
+class LevelDBStorage final : public Storage {
+ public:
+  explicit LevelDBStorage(const std::string &path, rclcpp::Logger &logger);
+  ~LevelDBStorage();
+
+  HardState load_hard_state() override;
+  bool store_hard_state(const HardState &state) override;
+
+  std::vector<LogEntry::SharedPtr> load_logs(const uint64_t first_id) override;
+  LogEntry::SharedPtr load_log(const uint64_t id) override;
+  uint64_t load_logs_size() override;
+  bool store_log(const LogEntry::SharedPtr log) override;
+  bool store_logs(const std::vector<LogEntry::SharedPtr> &logs) override;
+  bool store_committed_logs(
+      const std::vector<LogEntry::SharedPtr> &logs) override;
+  bool truncate_logs(const uint64_t size) override;
+
+  std::vector<TermRun> load_term_index() override;
+  bool store_term_index(const std::vector<TermRun> &runs) override;
+
+  uint64_t load_applied_size() override;
+  bool store_applied_size(const uint64_t size) override;
+
+  uint64_t load_commit_size() override;
+  bool store_commit_size(const uint64_t size) override;
+
+ private:
+  void init_format();
+  bool migrate_legacy_logs();
+  bool migrate_legacy_hard_state(HardState &state);
+  uint64_t load_legacy_current_term();
+  uint32_t load_legacy_voted_for();
+  bool load_legacy_voted();
+  bool write_logs(const LogEntry::SharedPtr *logs, const std::size_t count,
+                  const bool committed = false);
+  bool store_logs_size(const uint64_t size);
+  uint64_t read_logs_size();
+  uint64_t read_host_order_logs_size();
+  void put_logs_size(leveldb::WriteBatch &batch, const uint64_t size) const;
+  void put_format_version(leveldb::WriteBatch &batch) const;
+  bool migrate_logs(const uint32_t from_version);
+  LogEntry::SharedPtr decode_log(const uint64_t id,
+                                 const leveldb::Slice &value);
+  std::string encode_log(const uint64_t term, const CommandHeader &header,
+                         const char *data, const std::size_t size) const;
+  leveldb::Slice get_log_key(const uint64_t id, char *buffer) const;
+  bool parse_log_key(const leveldb::Slice &key, uint64_t *id) const;
+  std::string get_legacy_log_key(const uint64_t id, const char *suffix) const;
+  void encode_hard_state(const HardState &state, char *buffer) const;
+  void start_garbage_collector();
+  void stop_garbage_collector();
+  void request_garbage_collection();
+  void run_garbage_collector();
+  uint64_t collect_garbage();
+
+  // Term, voted_for and voted are stored in a single record so that they are
+  // always updated together.
+  //   key   : "hard_state"
+  //   value : term in 8 bytes + voted_for in 4 bytes + voted in 1 byte,
+  //           all big-endian
+  static constexpr std::size_t kHardStateSize =
+      sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint8_t);
+
+  // Runs of the term index in a single record.
+  //   key   : "term_index"
+  //   value : term in 8 bytes + first id in 8 bytes for each run,
+  //           all big-endian
+  static constexpr std::size_t kTermRunSize = sizeof(uint64_t) * 2;
+
+  // Number of logs applied by the application.
+  //   key   : "applied_size"
+  //   value : size in 8 bytes big-endian
+
+  // Number of logs known to be committed. Databases written before it was
+  // added have none, and all of their logs are committed.
+  //   key   : "commit_size"
+  //   value : size in 8 bytes big-endian
+
+  // Number of logs stored.
+  //   key   : "log_size"
+  //   value : size in 8 bytes big-endian
+
+  // Version of the format below.
+  //   key   : "format_version"
+  //   value : version in 4 bytes big-endian
+
+  // Version 4 stores each log entry as a single record.
+  //   key   : "log/" + id in 8 bytes big-endian
+  //   value : term in 8 bytes big-endian + CRC32C of the rest of the value in
+  //           4 bytes big-endian + command header + command data
+  // Big-endian keys keep the records ordered by id in leveldb, so the log can
+  // be loaded, compacted and deleted by range.
+  // Version 1 has no checksum, version 2 no command header, and version 3
+  // stores the log size and the version in host byte order. All of them are
+  // migrated on open.
+  static constexpr uint32_t kFormatVersion = 4;
+  static constexpr uint32_t kCommandHeaderVersion = 3;
+  static constexpr uint32_t kBigEndianSizeVersion = 4;
+  static constexpr std::size_t kLogKeyPrefixSize = 4;
+  static constexpr std::size_t kLogKeySize =
+      kLogKeyPrefixSize + sizeof(uint64_t);
+  static constexpr std::size_t kLogTermSize = sizeof(uint64_t);
+  static constexpr std::size_t kLogChecksumSize = sizeof(uint32_t);
+  static constexpr std::size_t kLogHeaderSize = kLogTermSize + kLogChecksumSize;
+  // maximum number of records deleted while holding the log mutex
+  static constexpr std::size_t kGarbageCollectionBatchSize = 1024;
+
+  const char *kFormatVersionKey = "format_version";
+  const char *kHardStateKey = "hard_state";
+  const char *kLogKeyPrefix = "log/";
+  const char *kLogSizeKey = "log_size";
+  const char *kAppliedSizeKey = "applied_size";
+  const char *kCommitSizeKey = "commit_size";
+  const char *kTermIndexKey = "term_index";
+
+  // Keys of the unversioned format, only used for migration
+  const char *kLegacyCurrentTermKey = "current_term";
+  const char *kLegacyVotedForKey = "voted_for";
+  const char *kLegacyVotedKey = "voted";
+  const char *kLegacyLogDataKeySuffix = "/data";
+  const char *kLegacyLogTermKeySuffix = "/term";
+
+  leveldb::DB *db_;
+  rclcpp::Logger logger_;
+
+  // size of the stored log, guarded by log_mutex_
+  uint64_t logs_size_;
+  std::mutex log_mutex_;
+
+  // garbage collector deleting log records beyond the log size
+  std::thread gc_thread_;
+  std::mutex gc_mutex_;
+  std::condition_variable gc_condition_;
+  bool gc_requested_;
+  bool gc_stopped_;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_STORAGE_LEVELDB_STORAGE_HPP_
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raft/storage/log_writer.hpp"
+
+#include <rclcpp/logging.hpp>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef FOROS_HAVE_IO_URING
+#include "raft/storage/io_uring_log_writer.hpp"
+#endif
+#include "raft/storage/thread_log_writer.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+LogWriter::LogWriter(const int fd, const uint64_t offset,
+                     rclcpp::Logger &logger)
+    : fd_(fd),
+      logger_(logger),
+      offset_(offset),
+      failed_(false),
+      syncs_(0),
+      stopped_(false) {}
+
+LogWriter::~LogWriter() { stop(); }
+
+std::unique_ptr<LogWriter> LogWriter::create(const int fd,
+                                             const uint64_t offset,
+                                             rclcpp::Logger &logger) {
+#ifdef FOROS_HAVE_IO_URING
+  auto writer = IoUringLogWriter::create(fd, offset, logger);
+  if (writer != nullptr) {
+    return writer;
+  }
+  RCLCPP_WARN(logger, "io_uring is not available, use thread log writer");
+#endif
+  return std::make_unique<ThreadLogWriter>(fd, offset, logger);
+}
+
+void LogWriter::append(std::string record,
+                       std::function<void(bool)> callback) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped_ == false) {
+      requests_.emplace_back(std::move(record), std::move(callback));
+      condition_.notify_one();
+      return;
+    }
+  }
+  callback(false);
+}
+
+uint64_t LogWriter::syncs() const { return syncs_; }
+
+void LogWriter::start() { thread_ = std::thread(&LogWriter::loop, this); }
+
+void LogWriter::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    condition_.notify_one();
+  }
+
+  if (thread_.joinable() == true) {
+    thread_.join();
+  }
+}
+
+void LogWriter::loop() {
+  std::deque<Request> batch;
+  std::vector<const std::string *> records;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait(
+        lock, [this]() { return stopped_ == true || !requests_.empty(); });
+    if (requests_.empty() == true) {
+      return;
+    }
+
+    batch.swap(requests_);
+    lock.unlock();
+
+    uint64_t size = 0;
+    records.clear();
+    for (auto &request : batch) {
+      records.push_back(&request.record_);
+      size += request.record_.size();
+    }
+
+    auto result = false;
+    if (failed_ == false) {
+      result = write(records, offset_);
+      syncs_++;
+    }
+    if (result == true) {
+      offset_ += size;
+    } else {
+      failed_ = true;
+    }
+
+    for (auto &request : batch) {
+      request.callback_(result);
+    }
+    batch.clear();
+
+    lock.lock();
+  }
+}
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_STORAGE_LOG_WRITER_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_STORAGE_LOG_WRITER_HPP_
+
+#include <rclcpp/logger.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Appends records to the end of a file from a writer thread.
+// Records queued while a batch is being written are written together in the
+// next batch followed by a single sync, so concurrent appends share syscalls.
+class LogWriter {
+ public:
+  virtual ~LogWriter();
+
+  // Create a writer using io_uring if it is available, otherwise a writer
+  // using plain syscalls.
+  static std::unique_ptr<LogWriter> create(const int fd, const uint64_t offset,
+                                           rclcpp::Logger &logger);
+
+  // Append a record. The callback is called on the writer thread once the
+  // record is durable or failed. Once a batch fails, every later append fails
+  // so that no record is written after a gap.
+  void append(std::string record, std::function<void(bool)> callback);
+
+  // Number of batches written, each followed by a single sync.
+  uint64_t syncs() const;
+
+ protected:
+  LogWriter(const int fd, const uint64_t offset, rclcpp::Logger &logger);
+
+  // Write the records at the offset and sync the file.
+  virtual bool write(const std::vector<const std::string *> &records,
+                     const uint64_t offset) = 0;
+
+  // Derived writers start the thread once constructed and stop it before
+  // they are destroyed.
+  void start();
+  void stop();
+
+  const int fd_;
+  rclcpp::Logger logger_;
+
+ private:
+  class Request {
+   public:
+    Request(std::string record, std::function<void(bool)> callback)
+        : record_(std::move(record)), callback_(std::move(callback)) {}
+
+    std::string record_;
+    std::function<void(bool)> callback_;
+  };
+
+  void loop();
+
+  uint64_t offset_;
+  bool failed_;
+  std::atomic<uint64_t> syncs_;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<Request> requests_;
+  bool stopped_;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_STORAGE_LOG_WRITER_HPP_
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raft/storage/memory_storage.hpp"
+
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+HardState MemoryStorage::load_hard_state() { return HardState(); }
+
+bool MemoryStorage::store_hard_state(const HardState &) { return true; }
+
+std::vector<LogEntry::SharedPtr> MemoryStorage::load_logs(const uint64_t) {
+  return {};
+}
+
+LogEntry::SharedPtr MemoryStorage::load_log(const uint64_t) { return nullptr; }
+
+uint64_t MemoryStorage::load_logs_size() { return 0; }
+
+bool MemoryStorage::store_log(const LogEntry::SharedPtr) { return true; }
+
+bool MemoryStorage::truncate_logs(const uint64_t) { return true; }
+
+std::vector<TermRun> MemoryStorage::load_term_index() { return {}; }
+
+bool MemoryStorage::store_term_index(const std::vector<TermRun> &) {
+  return true;
+}
+
+uint64_t MemoryStorage::load_applied_size() { return 0; }
+
+bool MemoryStorage::store_applied_size(const uint64_t) { return true; }
+
+uint64_t MemoryStorage::load_commit_size() { return 0; }
+
+bool MemoryStorage::store_commit_size(const uint64_t) { return true; }
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
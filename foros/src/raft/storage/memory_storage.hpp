@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_STORAGE_MEMORY_STORAGE_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_STORAGE_MEMORY_STORAGE_HPP_
+
+#include <vector>
+
+#include "raft/storage.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Storage for clusters which do not need to persist anything across restarts.
+// ContextStore already keeps everything in memory, so nothing is done here.
+class MemoryStorage final : public Storage {
+ public:
+  HardState load_hard_state() override;
+  bool store_hard_state(const HardState &state) override;
+
+  std::vector<LogEntry::SharedPtr> load_logs(const uint64_t first_id) override;
+  LogEntry::SharedPtr load_log(const uint64_t id) override;
+  uint64_t load_logs_size() override;
+  bool store_log(const LogEntry::SharedPtr log) override;
+  bool truncate_logs(const uint64_t size) override;
+
+  std::vector<TermRun> load_term_index() override;
+  bool store_term_index(const std::vector<TermRun> &runs) override;
+
+  uint64_t load_applied_size() override;
+  bool store_applied_size(const uint64_t size) override;
+
+  uint64_t load_commit_size() override;
+  bool store_commit_size(const uint64_t size) override;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_STORAGE_MEMORY_STORAGE_HPP_
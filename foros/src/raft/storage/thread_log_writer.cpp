@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raft/storage/thread_log_writer.hpp"
+
+#include <rclcpp/logging.hpp>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+ThreadLogWriter::ThreadLogWriter(const int fd, const uint64_t offset,
+                                 rclcpp::Logger &logger)
+    : LogWriter(fd, offset, logger) {
+  start();
+}
+
+ThreadLogWriter::~ThreadLogWriter() { stop(); }
+
+bool ThreadLogWriter::write(const std::vector<const std::string *> &records,
+                            const uint64_t offset) {
+  std::vector<struct iovec> iovecs;
+  iovecs.reserve(records.size());
+  for (auto record : records) {
+    iovecs.push_back({const_cast<char *>(record->data()), record->size()});
+  }
+
+  auto position = static_cast<off_t>(offset);
+  std::size_t index = 0;
+  while (index < iovecs.size()) {
+    auto count = std::min<std::size_t>(iovecs.size() - index, IOV_MAX);
+    auto written = pwritev(fd_, &iovecs[index], count, position);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      RCLCPP_ERROR(logger_, "log write failed: %s", std::strerror(errno));
+      return false;
+    }
+
+    // skip the written vectors and resume a partially written one
+    position += written;
+    while (index < iovecs.size() &&
+           static_cast<std::size_t>(written) >= iovecs[index].iov_len) {
+      written -= iovecs[index].iov_len;
+      index++;
+    }
+    if (index < iovecs.size()) {
+      iovecs[index].iov_base =
+          static_cast<char *>(iovecs[index].iov_base) + written;
+      iovecs[index].iov_len -= written;
+    }
+  }
+
+  if (fdatasync(fd_) != 0) {
+    RCLCPP_ERROR(logger_, "log sync failed: %s", std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
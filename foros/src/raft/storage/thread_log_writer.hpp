@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_STORAGE_THREAD_LOG_WRITER_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_STORAGE_THREAD_LOG_WRITER_HPP_
+
+#include <rclcpp/logger.hpp>
+
+#include <string>
+#include <vector>
+
+#include "raft/storage/log_writer.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Log writer using pwritev and fdatasync on the writer thread.
+class ThreadLogWriter final : public LogWriter {
+ public:
+  ThreadLogWriter(const int fd, const uint64_t offset, rclcpp::Logger &logger);
+  ~ThreadLogWriter();
+
+ private:
+  bool write(const std::vector<const std::string *> &records,
+             const uint64_t offset) override;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_STORAGE_THREAD_LOG_WRITER_HPP_
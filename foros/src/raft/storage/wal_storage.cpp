@@ -0,0 +1,706 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raft/storage/wal_storage.hpp"
+
+#include <fcntl.h>
+#include <rclcpp/logging.hpp>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/byte_order.hpp"
+#include "common/crc32c.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+namespace {
+
+bool sync_directory(const std::string &path) {
+  auto fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  auto result = fsync(fd) == 0;
+  close(fd);
+  return result;
+}
+
+bool write_all(const int fd, const std::string &data) {
+  std::size_t written = 0;
+  while (written < data.size()) {
+    auto ret = ::write(fd, data.data() + written, data.size() - written);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    written += ret;
+  }
+  return true;
+}
+
+}  // namespace
+
+WALStorage::WALStorage(const std::string &path, rclcpp::Logger &logger,
+                       const EntryCodec &codec)
+    : path_(path),
+      file_(path + "/wal"),
+      logger_(logger.get_child("storage")),
+      codec_(codec),
+      fd_(-1),
+      end_offset_(0),
+      applied_size_(0),
+      commit_size_(kNoCommitSize),
+      last_log_depth_(0) {
+  if (mkdir(path_.c_str(), 0755) != 0 && errno != EEXIST) {
+    RCLCPP_ERROR(logger_, "wal directory creation failed: %s",
+                 std::strerror(errno));
+    return;
+  }
+
+  if (open_file() == false) {
+    return;
+  }
+
+  auto corrupted = false;
+  auto live_size = replay(corrupted);
+  // corrupted records are not kept by the compaction
+  if (corrupted == true ||
+      (end_offset_ > kCompactionThreshold && live_size * 2 < end_offset_)) {
+    if (compact() == false || open_file() == false) {
+      return;
+    }
+    replay(corrupted);
+  }
+
+  writer_ = LogWriter::create(fd_, end_offset_, logger_);
+}
+
+WALStorage::~WALStorage() {
+  // the writer completes the queued records before it is destroyed
+  writer_.reset();
+
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+bool WALStorage::open_file() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+
+  auto exists = access(file_.c_str(), F_OK) == 0;
+  fd_ = open(file_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    RCLCPP_ERROR(logger_, "wal open failed: %s", std::strerror(errno));
+    return false;
+  }
+
+  // make a new file itself survive a crash
+  if (exists == false && sync_directory(path_) == false) {
+    RCLCPP_WARN(logger_, "wal directory sync failed: %s",
+                std::strerror(errno));
+  }
+  return true;
+}
+
+uint64_t WALStorage::replay(bool &corrupted) {
+  corrupted = false;
+  hard_state_ = HardState();
+  applied_size_ = 0;
+  commit_size_ = kNoCommitSize;
+  logs_.clear();
+  term_index_.reset({}, 0);
+  end_offset_ = 0;
+
+  struct stat st;
+  if (fstat(fd_, &st) != 0) {
+    RCLCPP_ERROR(logger_, "wal stat failed: %s", std::strerror(errno));
+    return 0;
+  }
+
+  std::string data(st.st_size, '\0');
+  if (read(0, data.size(), &data[0]) == false) {
+    RCLCPP_ERROR(logger_, "wal read failed: %s", std::strerror(errno));
+    return 0;
+  }
+
+  uint64_t offset = 0;
+  while (data.size() - offset >= kHeaderSize) {
+    auto type = static_cast<RecordType>(data[offset]);
+    auto size = ByteOrder::decode_big_endian32(&data[offset + 1]);
+    if (data.size() - offset - kHeaderSize < size) {
+      break;
+    }
+
+    if (verify_record(&data[offset]) == false) {
+      // the logs from a corrupted one are dropped by failing to apply
+      RCLCPP_ERROR(logger_, "wal record at %lu is corrupted", offset);
+      corrupted = true;
+    } else if (apply_record(type, &data[offset + kHeaderSize], size,
+                            offset) == false &&
+               corrupted == false) {
+      RCLCPP_ERROR(logger_, "wal record at %lu is invalid", offset);
+      break;
+    }
+    offset += kHeaderSize + size;
+  }
+
+  // drop a record cut by a crash so that new records follow the valid ones
+  end_offset_ = offset;
+  if (end_offset_ < data.size()) {
+    RCLCPP_WARN(logger_, "dropping %lu bytes at the end of wal",
+                data.size() - end_offset_);
+    if (ftruncate(fd_, end_offset_) != 0 || fdatasync(fd_) != 0) {
+      RCLCPP_ERROR(logger_, "wal truncation failed: %s",
+                   std::strerror(errno));
+    }
+  }
+
+  auto live_size = kHeaderSize * 3 + kHardStateSize + sizeof(uint64_t) * 2;
+  for (auto &log : logs_) {
+    live_size += log.record_size();
+  }
+  return live_size;
+}
+
+bool WALStorage::compact() {
+  auto temp_file = file_ + ".tmp";
+  auto fd = open(temp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                 0644);
+  if (fd < 0) {
+    RCLCPP_ERROR(logger_, "wal compaction failed: %s", std::strerror(errno));
+    return false;
+  }
+
+  auto result =
+      write_all(fd, encode_record(RecordType::kHardState,
+                                  encode_hard_state(hard_state_))) &&
+      write_all(fd, encode_record(RecordType::kAppliedSize,
+                                  encode_size(applied_size_)));
+  if (result == true && commit_size_ != kNoCommitSize) {
+    result = write_all(fd, encode_record(RecordType::kCommitSize,
+                                         encode_size(commit_size_)));
+  }
+  std::string record;
+  for (std::size_t id = 0; result == true && id < logs_.size(); id++) {
+    // log records are copied as they are, since an encoded log stays valid
+    // with the previous log kept as well
+    auto &location = logs_[id];
+    record.resize(location.record_size());
+    result = read(location.offset_, record.size(), &record[0]) &&
+             verify_record(record.data()) && write_all(fd, record);
+  }
+  result = result && fsync(fd) == 0;
+  close(fd);
+
+  // the old file is replaced only once the new one is complete on disk
+  if (result == false || rename(temp_file.c_str(), file_.c_str()) != 0) {
+    RCLCPP_ERROR(logger_, "wal compaction failed: %s", std::strerror(errno));
+    unlink(temp_file.c_str());
+    return false;
+  }
+  sync_directory(path_);
+
+  RCLCPP_INFO(logger_, "wal compacted with %lu logs", logs_.size());
+  return true;
+}
+
+HardState WALStorage::load_hard_state() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hard_state_;
+}
+
+bool WALStorage::store_hard_state(const HardState &state) {
+  return append(RecordType::kHardState, encode_hard_state(state));
+}
+
+std::vector<LogEntry::SharedPtr> WALStorage::load_logs(
+    const uint64_t first_id) {
+  std::vector<LogEntry::SharedPtr> logs;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd_ < 0 || first_id >= logs_.size()) {
+    return logs;
+  }
+
+  // read from the last full log before the first one
+  auto start_id = first_id - logs_[first_id].depth_;
+  auto start_offset = logs_[start_id].offset_;
+  std::string data(end_offset_ - start_offset, '\0');
+  if (read(start_offset, data.size(), &data[0]) == false) {
+    RCLCPP_ERROR(logger_, "wal read failed: %s", std::strerror(errno));
+    return logs;
+  }
+
+  logs.reserve(logs_.size() - first_id);
+  std::vector<uint8_t> command_data;
+  for (auto id = start_id; id < logs_.size(); id++) {
+    auto record = &data[logs_[id].offset_ - start_offset];
+    if (verify_record(record) == false ||
+        decode_log(id, record, command_data) == false) {
+      // drop the logs from the damaged one to fetch them from the leader
+      RCLCPP_ERROR(logger_, "log %lu is corrupted", id);
+      logs_.erase(logs_.begin() + id, logs_.end());
+      term_index_.truncate(id);
+      last_log_ = nullptr;
+      return logs;
+    }
+    if (id >= first_id) {
+      logs.push_back(LogEntry::make_shared(
+          id, logs_[id].term_, make_command(id, record, command_data)));
+    }
+  }
+  return logs;
+}
+
+LogEntry::SharedPtr WALStorage::load_log(const uint64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd_ < 0 || id >= logs_.size()) {
+    return nullptr;
+  }
+
+  // decode from the last full log
+  std::vector<uint8_t> command_data;
+  std::string record;
+  for (auto i = id - logs_[id].depth_; i <= id; i++) {
+    auto &location = logs_[i];
+    record.resize(location.record_size());
+    if (read(location.offset_, record.size(), &record[0]) == false) {
+      RCLCPP_ERROR(logger_, "log %lu read failed: %s", i,
+                   std::strerror(errno));
+      return nullptr;
+    }
+    if (verify_record(record.data()) == false) {
+      RCLCPP_ERROR(logger_, "log %lu is corrupted", i);
+      return nullptr;
+    }
+    if (decode_log(i, record.data(), command_data) == false) {
+      return nullptr;
+    }
+  }
+
+  return LogEntry::make_shared(id, logs_[id].term_,
+                               make_command(id, record.data(), command_data));
+}
+
+uint64_t WALStorage::load_logs_size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return logs_.size();
+}
+
+bool WALStorage::verify_record(const char *record) const {
+  auto bytes = reinterpret_cast<const uint8_t *>(record);
+  auto size = ByteOrder::decode_big_endian32(record + 1);
+  auto crc = CRC32C::value(bytes, kChecksumOffset);
+  crc = CRC32C::extend(crc, bytes + kHeaderSize, size);
+  return crc == ByteOrder::decode_big_endian32(record + kChecksumOffset);
+}
+
+bool WALStorage::decode_log(const uint64_t id, const char *record,
+                            std::vector<uint8_t> &base) const {
+  auto &location = logs_[id];
+  auto bytes =
+      reinterpret_cast<const uint8_t *>(record + location.data_offset());
+  if (location.encoding_ == EntryCodec::kRaw) {
+    base.assign(bytes, bytes + location.size_);
+    return true;
+  }
+
+  std::vector<uint8_t> decoded;
+  CommandData base_data(base);
+  if (EntryCodec::decode(location.encoding_, &base_data, bytes, location.size_,
+                         decoded) == false) {
+    RCLCPP_ERROR(logger_, "log %lu can not be decoded", id);
+    return false;
+  }
+  base.swap(decoded);
+  return true;
+}
+
+Command::SharedPtr WALStorage::make_command(
+    const uint64_t id, const char *record,
+    const std::vector<uint8_t> &data) const {
+  auto command = Command::make_shared(data);
+  auto &location = logs_[id];
+  if (location.command_header_size_ > 0) {
+    // the header is checked on appending or replaying the record
+    CommandHeader header;
+    header.decode(reinterpret_cast<const uint8_t *>(
+                      record + location.command_header_offset()),
+                  location.command_header_size_);
+    header.apply(*command);
+  }
+  return command;
+}
+
+bool WALStorage::store_log(const LogEntry::SharedPtr log) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (log->id_ > logs_.size()) {
+    RCLCPP_ERROR(logger_, "log %lu is not contiguous", log->id_);
+    return false;
+  }
+
+  auto record = encode_next_log(log);
+  lock.unlock();
+
+  return append(record.first, record.second);
+}
+
+bool WALStorage::store_logs(const std::vector<LogEntry::SharedPtr> &logs) {
+  std::vector<Record> records;
+  return encode_logs(logs, false, records) && append(records);
+}
+
+bool WALStorage::store_committed_logs(
+    const std::vector<LogEntry::SharedPtr> &logs) {
+  std::vector<Record> records;
+  return encode_logs(logs, true, records) && append(records);
+}
+
+bool WALStorage::persist_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                              const bool committed,
+                              std::function<void(bool)> callback) {
+  std::vector<Record> records;
+  return encode_logs(logs, committed, records) &&
+         queue(records, std::move(callback));
+}
+
+bool WALStorage::encode_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                             const bool committed,
+                             std::vector<Record> &records) {
+  if (logs.empty() == true) {
+    return true;
+  }
+
+  records.reserve(logs.size() + 1);
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (logs.front()->id_ > logs_.size()) {
+    RCLCPP_ERROR(logger_, "log %lu is not contiguous", logs.front()->id_);
+    return false;
+  }
+
+  for (auto &log : logs) {
+    records.push_back(encode_next_log(log));
+  }
+  lock.unlock();
+
+  // the commit size follows the logs, so it never covers a log which is not
+  // written
+  if (committed == true) {
+    records.emplace_back(RecordType::kCommitSize,
+                         encode_size(logs.back()->id_ + 1));
+  }
+  return true;
+}
+
+WALStorage::Record WALStorage::encode_next_log(const LogEntry::SharedPtr &log) {
+  auto delta_base = last_log_ != nullptr && last_log_->id_ + 1 == log->id_ &&
+                    last_log_depth_ < kMaxDeltaDepth;
+  auto base = delta_base == true ? last_log_->command_->view()
+                                 : CommandData(nullptr, 0);
+
+  auto data = log->command_->view();
+  std::vector<uint8_t> encoded;
+  auto encoding =
+      codec_.encode(delta_base == true ? &base : nullptr, data, encoded);
+  auto stored = encoding == EntryCodec::kRaw ? data : CommandData(encoded);
+  CommandHeader header(*log->command_);
+  auto payload = encode_log(log->id_, log->term_, encoding, header,
+                            stored.data(), stored.size());
+  last_log_ = log;
+  last_log_depth_ =
+      (encoding & EntryCodec::kDelta) != 0 ? last_log_depth_ + 1 : 0;
+
+  auto type = RecordType::kCommandLog;
+  if (header.is_default() == true) {
+    type = encoding == EntryCodec::kRaw ? RecordType::kLog
+                                        : RecordType::kEncodedLog;
+  }
+  return Record(type, std::move(payload));
+}
+
+bool WALStorage::truncate_logs(const uint64_t size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (size >= logs_.size()) {
+    return true;
+  }
+  if (last_log_ != nullptr && last_log_->id_ >= size) {
+    last_log_ = nullptr;
+  }
+  lock.unlock();
+
+  return append(RecordType::kTruncate, encode_size(size));
+}
+
+std::vector<TermRun> WALStorage::load_term_index() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return term_index_.runs();
+}
+
+bool WALStorage::store_term_index(const std::vector<TermRun> &) {
+  return true;
+}
+
+uint64_t WALStorage::load_applied_size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return applied_size_;
+}
+
+bool WALStorage::store_applied_size(const uint64_t size) {
+  return append(RecordType::kAppliedSize, encode_size(size));
+}
+
+uint64_t WALStorage::load_commit_size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return commit_size_ == kNoCommitSize ? logs_.size() : commit_size_;
+}
+
+bool WALStorage::store_commit_size(const uint64_t size) {
+  return append(RecordType::kCommitSize, encode_size(size));
+}
+
+uint64_t WALStorage::syncs() const {
+  return writer_ != nullptr ? writer_->syncs() : 0;
+}
+
+bool WALStorage::append(const std::vector<Record> &records) {
+  if (records.empty() == true) {
+    return true;
+  }
+
+  std::promise<bool> promise;
+  auto future = promise.get_future();
+  if (queue(records, [&promise](bool result) {
+        promise.set_value(result);
+      }) == false) {
+    return false;
+  }
+
+  // records appended by other threads meanwhile share the same sync
+  return future.get();
+}
+
+bool WALStorage::append(const RecordType type, const std::string &payload) {
+  return append(std::vector<Record>{Record(type, payload)});
+}
+
+bool WALStorage::queue(const std::vector<Record> &records,
+                       std::function<void(bool)> callback) {
+  if (records.empty() == true) {
+    callback(true);
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (writer_ == nullptr) {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < records.size(); i++) {
+    // records reach the file in the order they are queued, so the offset of
+    // a record is known before it is written
+    auto &record = records[i];
+    auto offset = end_offset_;
+    end_offset_ += kHeaderSize + record.second.size();
+    apply_record(record.first, record.second.data(), record.second.size(),
+                 offset);
+
+    // a failed record fails every later one, so the result of the last
+    // record covers all of them
+    std::function<void(bool)> done = [](bool) {};
+    if (i + 1 == records.size()) {
+      done = std::move(callback);
+    }
+    writer_->append(encode_record(record.first, record.second), done);
+  }
+  return true;
+}
+
+bool WALStorage::apply_record(const RecordType type, const char *payload,
+                              const uint32_t size, const uint64_t offset) {
+  switch (type) {
+    case RecordType::kLog:
+    case RecordType::kEncodedLog:
+    case RecordType::kCommandLog: {
+      uint8_t encoding = EntryCodec::kRaw;
+      auto header_size = kLogHeaderSize;
+      if (type != RecordType::kLog) {
+        header_size += sizeof(uint8_t);
+      }
+      if (size < header_size) {
+        return false;
+      }
+      if (type != RecordType::kLog) {
+        encoding = static_cast<uint8_t>(payload[kLogHeaderSize]);
+      }
+      uint8_t command_header_size = 0;
+      if (type == RecordType::kCommandLog) {
+        CommandHeader header;
+        command_header_size = header.decode(
+            reinterpret_cast<const uint8_t *>(payload + header_size),
+            size - header_size);
+        if (command_header_size == 0) {
+          return false;
+        }
+        header_size += command_header_size;
+      }
+
+      auto id = ByteOrder::decode_big_endian64(payload);
+      auto term = ByteOrder::decode_big_endian64(payload + sizeof(uint64_t));
+      auto delta = (encoding & EntryCodec::kDelta) != 0;
+      if (id > logs_.size() || (delta == true && id == 0)) {
+        return false;
+      }
+      uint32_t depth = delta ? logs_[id - 1].depth_ + 1 : 0;
+      // a log overwrites the logs from its id
+      logs_.erase(logs_.begin() + id, logs_.end());
+      term_index_.truncate(id);
+      logs_.emplace_back(offset, size - header_size, term, encoding,
+                         command_header_size, depth);
+      term_index_.append(id, term);
+      return true;
+    }
+    case RecordType::kTruncate: {
+      if (size != sizeof(uint64_t)) {
+        return false;
+      }
+      auto log_size = ByteOrder::decode_big_endian64(payload);
+      if (log_size < logs_.size()) {
+        logs_.erase(logs_.begin() + log_size, logs_.end());
+        term_index_.truncate(log_size);
+      }
+      return true;
+    }
+    case RecordType::kHardState: {
+      if (size != kHardStateSize) {
+        return false;
+      }
+      hard_state_.term_ = ByteOrder::decode_big_endian64(payload);
+      hard_state_.voted_for_ =
+          ByteOrder::decode_big_endian32(payload + sizeof(uint64_t));
+      hard_state_.voted_ = payload[sizeof(uint64_t) + sizeof(uint32_t)] != 0;
+      return true;
+    }
+    case RecordType::kAppliedSize: {
+      if (size != sizeof(uint64_t)) {
+        return false;
+      }
+      applied_size_ = ByteOrder::decode_big_endian64(payload);
+      return true;
+    }
+    case RecordType::kCommitSize: {
+      if (size != sizeof(uint64_t)) {
+        return false;
+      }
+      commit_size_ = ByteOrder::decode_big_endian64(payload);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+std::string WALStorage::encode_record(const RecordType type,
+                                      const std::string &payload) const {
+  std::string record(kHeaderSize, '\0');
+  record.reserve(kHeaderSize + payload.size());
+  record[0] = static_cast<char>(type);
+  ByteOrder::encode_big_endian32(&record[1], payload.size());
+  record.append(payload);
+
+  auto bytes = reinterpret_cast<const uint8_t *>(record.data());
+  auto crc = CRC32C::value(bytes, kChecksumOffset);
+  crc = CRC32C::extend(crc, bytes + kHeaderSize, payload.size());
+  ByteOrder::encode_big_endian32(&record[kChecksumOffset], crc);
+  return record;
+}
+
+std::string WALStorage::encode_hard_state(const HardState &state) const {
+  std::string payload(kHardStateSize, '\0');
+  ByteOrder::encode_big_endian64(&payload[0], state.term_);
+  ByteOrder::encode_big_endian32(&payload[sizeof(uint64_t)], state.voted_for_);
+  payload[sizeof(uint64_t) + sizeof(uint32_t)] = state.voted_ ? 1 : 0;
+  return payload;
+}
+
+std::string WALStorage::encode_size(const uint64_t size) const {
+  std::string payload(sizeof(uint64_t), '\0');
+  ByteOrder::encode_big_endian64(&payload[0], size);
+  return payload;
+}
+
+std::string WALStorage::encode_log(const uint64_t id, const uint64_t term,
+                                   const uint8_t encoding,
+                                   const CommandHeader &header,
+                                   const uint8_t *data,
+                                   const std::size_t size) const {
+  std::string payload(kLogHeaderSize, '\0');
+  payload.reserve(kLogHeaderSize + sizeof(uint8_t) + header.size() + size);
+  ByteOrder::encode_big_endian64(&payload[0], id);
+  ByteOrder::encode_big_endian64(&payload[sizeof(uint64_t)], term);
+  if (encoding != EntryCodec::kRaw || header.is_default() == false) {
+    payload.push_back(static_cast<char>(encoding));
+  }
+  if (header.is_default() == false) {
+    auto offset = payload.size();
+    payload.resize(offset + header.size());
+    header.encode(reinterpret_cast<uint8_t *>(&payload[offset]));
+  }
+  payload.append(reinterpret_cast<const char *>(data), size);
+  return payload;
+}
+
+bool WALStorage::read(const uint64_t offset, const std::size_t size,
+                      char *buffer) const {
+  std::size_t done = 0;
+  while (done < size) {
+    auto ret = pread(fd_, buffer + done, size - done, offset + done);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (ret == 0) {
+      errno = EIO;
+      return false;
+    }
+    done += ret;
+  }
+  return true;
+}
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_STORAGE_WAL_STORAGE_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_STORAGE_WAL_STORAGE_HPP_
+
+#include <rclcpp/logger.hpp>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "raft/command_header.hpp"
+#include "raft/entry_codec.hpp"
+#include "raft/storage.hpp"
+#include "raft/storage/log_writer.hpp"
+#include "raft/term_index.hpp"
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Storage appending every change to a single write-ahead log file.
+// Appends go through a LogWriter, so each change costs one submission to
+// io_uring where it is available. The file is replayed on open and rewritten
+// if it mostly holds overwritten records.
+class WALStorage final : public Storage {
+ public:
+  // Logs are stored encoded with the codec whenever that makes them smaller.
+  explicit WALStorage(const std::string &path, rclcpp::Logger &logger,
+                      const EntryCodec &codec = EntryCodec());
+  ~WALStorage();
+
+  HardState load_hard_state() override;
+  bool store_hard_state(const HardState &state) override;
+
+  std::vector<LogEntry::SharedPtr> load_logs(const uint64_t first_id) override;
+  LogEntry::SharedPtr load_log(const uint64_t id) override;
+  uint64_t load_logs_size() override;
+  bool store_log(const LogEntry::SharedPtr log) override;
+  bool store_logs(const std::vector<LogEntry::SharedPtr> &logs) override;
+  // The logs and the commit size are appended with a single wait.
+  bool store_committed_logs(
+      const std::vector<LogEntry::SharedPtr> &logs) override;
+  // The logs are queued to the writer and the callback is called on the
+  // writer thread, so the logs queued meanwhile share the sync.
+  bool persist_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                    const bool committed,
+                    std::function<void(bool)> callback) override;
+  bool truncate_logs(const uint64_t size) override;
+
+  // The term index is rebuilt from the log records while replaying, so it is
+  // never stored separately.
+  std::vector<TermRun> load_term_index() override;
+  bool store_term_index(const std::vector<TermRun> &runs) override;
+
+  uint64_t load_applied_size() override;
+  bool store_applied_size(const uint64_t size) override;
+
+  uint64_t load_commit_size() override;
+  bool store_commit_size(const uint64_t size) override;
+
+  // Number of syncs made by the writer.
+  uint64_t syncs() const;
+
+ private:
+  // Each record is a header followed by a payload.
+  //   header : type in 1 byte + payload size in 4 bytes + CRC32C of the
+  //            type, the size and the payload in 4 bytes
+  //   log        : id in 8 bytes + term in 8 bytes + command data
+  //   encoded log: id in 8 bytes + term in 8 bytes + encoding in 1 byte +
+  //                command data encoded by EntryCodec against the previous log
+  //   command log: encoded log with the command header before the data, for
+  //                a command whose header is not the default one
+  //   truncate   : log size in 8 bytes
+  //   hard state : term in 8 bytes + voted_for in 4 bytes + voted in 1 byte
+  //   applied size: size in 8 bytes
+  //   commit size: size in 8 bytes
+  // All integers are big-endian. A record cut by a crash is dropped on open,
+  // and a corrupted record is skipped with the logs following it, so that
+  // they are fetched again from the leader.
+  enum class RecordType : uint8_t {
+    kLog = 1,
+    kTruncate = 2,
+    kHardState = 3,
+    kEncodedLog = 4,
+    kAppliedSize = 5,
+    kCommandLog = 6,
+    kCommitSize = 7,
+  };
+
+  class LogLocation {
+   public:
+    LogLocation(uint64_t offset, uint32_t size, uint64_t term,
+                uint8_t encoding, uint8_t command_header_size, uint32_t depth)
+        : offset_(offset),
+          size_(size),
+          term_(term),
+          encoding_(encoding),
+          command_header_size_(command_header_size),
+          depth_(depth) {}
+
+    // offset of the command header from the record offset, if it has one
+    uint64_t command_header_offset() const {
+      return kHeaderSize + kLogHeaderSize + sizeof(uint8_t);
+    }
+
+    // offset of the data from the record offset
+    uint64_t data_offset() const {
+      if (command_header_size_ > 0) {
+        return command_header_offset() + command_header_size_;
+      }
+      auto offset = kHeaderSize + kLogHeaderSize;
+      return encoding_ == EntryCodec::kRaw ? offset : offset + sizeof(uint8_t);
+    }
+
+    uint64_t record_size() const { return data_offset() + size_; }
+
+    uint64_t offset_;  // offset of the record
+    uint32_t size_;    // size of the stored data
+    uint64_t term_;
+    uint8_t encoding_;
+    uint8_t command_header_size_;  // 0 if the command has no header
+    uint32_t depth_;  // number of deltas since the last log without delta
+  };
+
+  static constexpr std::size_t kHeaderSize =
+      sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint32_t);
+  static constexpr std::size_t kChecksumOffset =
+      sizeof(uint8_t) + sizeof(uint32_t);
+  static constexpr std::size_t kLogHeaderSize = sizeof(uint64_t) * 2;
+  static constexpr std::size_t kHardStateSize =
+      sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint8_t);
+  // the file is compacted on open if it is larger than this and at least
+  // half of it is overwritten records
+  static constexpr uint64_t kCompactionThreshold = 4 * 1024 * 1024;
+  static constexpr uint64_t kNoCommitSize = UINT64_MAX;
+  // maximum number of deltas decoded to load a log
+  static constexpr uint32_t kMaxDeltaDepth = 64;
+
+  bool open_file();
+  uint64_t replay(bool &corrupted);
+  bool compact();
+  using Record = std::pair<RecordType, std::string>;
+
+  bool append(const RecordType type, const std::string &payload);
+  // Append records with a single wait for the writer.
+  bool append(const std::vector<Record> &records);
+  // Queue records to the writer, which calls the callback once the last one
+  // is durable or failed. Returns false if there is no writer.
+  bool queue(const std::vector<Record> &records,
+             std::function<void(bool)> callback);
+  // Encode consecutive logs, followed by the commit size if they are
+  // committed.
+  bool encode_logs(const std::vector<LogEntry::SharedPtr> &logs,
+                   const bool committed, std::vector<Record> &records);
+  // Encode a log against the last stored one, guarded by mutex_.
+  Record encode_next_log(const LogEntry::SharedPtr &log);
+  // Apply a record at the offset to the replayed state.
+  bool apply_record(const RecordType type, const char *payload,
+                    const uint32_t size, const uint64_t offset);
+  std::string encode_record(const RecordType type,
+                            const std::string &payload) const;
+  std::string encode_hard_state(const HardState &state) const;
+  std::string encode_size(const uint64_t size) const;
+  std::string encode_log(const uint64_t id, const uint64_t term,
+                         const uint8_t encoding, const CommandHeader &header,
+                         const uint8_t *data, const std::size_t size) const;
+  bool verify_record(const char *record) const;
+  bool decode_log(const uint64_t id, const char *record,
+                  std::vector<uint8_t> &base) const;
+  // Create the command of a log from its record and decoded data.
+  Command::SharedPtr make_command(const uint64_t id, const char *record,
+                                  const std::vector<uint8_t> &data) const;
+  bool read(const uint64_t offset, const std::size_t size, char *buffer) const;
+
+  const std::string path_;
+  const std::string file_;
+  rclcpp::Logger logger_;
+  const EntryCodec codec_;
+
+  int fd_;
+  std::unique_ptr<LogWriter> writer_;
+
+  // replayed and appended state, guarded by mutex_
+  std::mutex mutex_;
+  uint64_t end_offset_;
+  HardState hard_state_;
+  uint64_t applied_size_;
+  // kNoCommitSize until a commit size is stored
+  uint64_t commit_size_;
+  std::vector<LogLocation> logs_;
+  TermIndex term_index_;
+  // last stored log, the base of the next delta
+  LogEntry::SharedPtr last_log_;
+  uint32_t last_log_depth_;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_STORAGE_WAL_STORAGE_HPP_
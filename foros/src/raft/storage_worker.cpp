@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "raft/storage_worker.hpp"
+
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+StorageWorker::StorageWorker() : stopped_(false) {
+  thread_ = std::thread(&StorageWorker::loop, this);
+}
+
+StorageWorker::~StorageWorker() { stop(); }
+
+void StorageWorker::post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped_ == false) {
+      tasks_.push_back(std::move(task));
+      condition_.notify_one();
+      return;
+    }
+  }
+  task();
+}
+
+bool StorageWorker::run(std::function<bool()> task) {
+  // a task posting another one must not wait for itself
+  if (std::this_thread::get_id() == thread_.get_id()) {
+    return task();
+  }
+
+  std::promise<bool> promise;
+  auto future = promise.get_future();
+  post([&]() { promise.set_value(task()); });
+  return future.get();
+}
+
+void StorageWorker::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped_ == true) {
+      return;
+    }
+    stopped_ = true;
+    condition_.notify_one();
+  }
+
+  if (thread_.joinable() == true) {
+    thread_.join();
+  }
+}
+
+void StorageWorker::loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    condition_.wait(lock,
+                    [this]() { return stopped_ == true || !tasks_.empty(); });
+    if (tasks_.empty() == true) {
+      return;
+    }
+
+    auto task = std::move(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_STORAGE_WORKER_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_STORAGE_WORKER_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// Thread running storage operations in the order they are posted, so that
+// disk writes do not block the executor.
+class StorageWorker final {
+ public:
+  StorageWorker();
+  ~StorageWorker();
+
+  // Run a task on the worker thread.
+  // Once stopped, tasks are run on the calling thread.
+  void post(std::function<void()> task);
+
+  // Run a task on the worker thread after the posted ones and wait for it.
+  bool run(std::function<bool()> task);
+
+  // Run the remaining tasks and stop the thread.
+  void stop();
+
+ private:
+  void loop();
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopped_;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_STORAGE_WORKER_HPP_
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AKIT_FAILOVER_FOROS_RAFT_TERM_INDEX_HPP_
+#define AKIT_FAILOVER_FOROS_RAFT_TERM_INDEX_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace akit {
+namespace failover {
+namespace foros {
+namespace raft {
+
+// First log id of a term. Consecutive logs of the same term share a run.
+class TermRun {
+ public:
+  TermRun() : term_(0), first_id_(0) {}
+  TermRun(uint64_t term, uint64_t first_id)
+      : term_(term), first_id_(first_id) {}
+
+  bool operator==(const TermRun &other) const {
+    return term_ == other.term_ && first_id_ == other.first_id_;
+  }
+
+  bool operator!=(const TermRun &other) const { return !(*this == other); }
+
+  uint64_t term_;
+  uint64_t first_id_;
+};
+
+// Run-length index of the terms of logs.
+// Terms only change on elections, so the index stays a few runs long even
+// for a long log and answers term lookups without touching the logs.
+class TermIndex {
+ public:
+  TermIndex() : size_(0) {}
+
+  // Rebuild the index from runs, keeping only the logs below the size.
+  void reset(const std::vector<TermRun> &runs, const uint64_t size) {
+    runs_ = runs;
+    size_ = size;
+    truncate(size);
+  }
+
+  // Append a log, returns true if a new run is started.
+  bool append(const uint64_t id, const uint64_t term) {
+    size_ = id + 1;
+    if (runs_.empty() == false && runs_.back().term_ == term) {
+      return false;
+    }
+    runs_.emplace_back(term, id);
+    return true;
+  }
+
+  // Discard the logs whose id is equal or greater than the given size,
+  // returns true if any run is removed.
+  bool truncate(const uint64_t size) {
+    auto it = std::lower_bound(runs_.begin(), runs_.end(), size,
+                               [](const TermRun &run, const uint64_t id) {
+                                 return run.first_id_ < id;
+                               });
+    auto removed = it != runs_.end();
+    runs_.erase(it, runs_.end());
+    size_ = std::min(size_, size);
+    return removed;
+  }
+
+  // Term of a log, or 0 if there is no such log.
+  uint64_t term(const uint64_t id) const {
+    if (id >= size_) {
+      return 0;
+    }
+    auto it = std::upper_bound(runs_.begin(), runs_.end(), id,
+                               [](const uint64_t id, const TermRun &run) {
+                                 return id < run.first_id_;
+                               });
+    return it == runs_.begin() ? 0 : std::prev(it)->term_;
+  }
+
+  // Term of the last log, or 0 if there is no log.
+  uint64_t last_term() const {
+    return runs_.empty() ? 0 : runs_.back().term_;
+  }
+
+  // First log id of a term. Returns false if no log has the term.
+  bool first_id(const uint64_t term, uint64_t &id) const {
+    auto it = std::lower_bound(runs_.begin(), runs_.end(), term,
+                               [](const TermRun &run, const uint64_t term) {
+                                 return run.term_ < term;
+                               });
+    if (it == runs_.end() || it->term_ != term) {
+      return false;
+    }
+    id = it->first_id_;
+    return true;
+  }
+
+  const std::vector<TermRun> &runs() const { return runs_; }
+
+  uint64_t size() const { return size_; }
+
+ private:
+  std::vector<TermRun> runs_;
+  uint64_t size_;
+};
+
+}  // namespace raft
+}  // namespace foros
+}  // namespace failover
+}  // namespace akit
+
+#endif  // AKIT_FAILOVER_FOROS_RAFT_TERM_INDEX_HPP_
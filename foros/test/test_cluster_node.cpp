@@ -18,10 +18,13 @@
 #include <gtest/gtest.h>
 #include <rclcpp/rclcpp.hpp>
 
+#include <foros_msgs/msg/inspector.hpp>
+
 #include <chrono>
 #include <filesystem>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "akit/failover/foros/cluster_node.hpp"
@@ -78,6 +81,36 @@ TEST_F(TestClusterNode, TestClusterNodeOptions) {
   std::string kTempDirectory = "/tmp";
   options.temp_directory(kTempDirectory);
   EXPECT_EQ(kTempDirectory, options.temp_directory());
+
+  EXPECT_EQ(akit::failover::foros::StorageType::kLevelDB,
+            options.storage_type());
+  options.storage_type(akit::failover::foros::StorageType::kMemory);
+  EXPECT_EQ(akit::failover::foros::StorageType::kMemory,
+            options.storage_type());
+
+  EXPECT_EQ(false, options.delta_encoding());
+  options.delta_encoding(true);
+  EXPECT_EQ(true, options.delta_encoding());
+
+  EXPECT_EQ((uint32_t)0, options.compression_threshold());
+  options.compression_threshold(512);
+  EXPECT_EQ((uint32_t)512, options.compression_threshold());
+
+  EXPECT_EQ((std::size_t)0, options.callback_queue_size());
+  options.callback_queue_size(64);
+  EXPECT_EQ((std::size_t)64, options.callback_queue_size());
+
+  EXPECT_EQ(false, options.kv_store());
+  options.kv_store(true);
+  EXPECT_EQ(true, options.kv_store());
+
+  EXPECT_EQ((uint64_t)1024, options.kv_snapshot_interval());
+  options.kv_snapshot_interval(16);
+  EXPECT_EQ((uint64_t)16, options.kv_snapshot_interval());
+
+  EXPECT_EQ(false, options.commit_forwarding());
+  options.commit_forwarding(true);
+  EXPECT_EQ(true, options.commit_forwarding());
 }
 
 TEST_F(TestClusterNode, TestGetNodeInfo) {
@@ -192,6 +225,219 @@ TEST_F(TestClusterNode, TestCommandCommit) {
   EXPECT_EQ(cluster_node->get_commands_size(), (uint64_t)1);
 }
 
+TEST_F(TestClusterNode, TestMessageCommit) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error &err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  auto cluster_node = std::make_shared<akit::failover::foros::ClusterNode>(
+      kClusterName, kNodeId, kClusterIds, kNamespace);
+
+  rclcpp::WallRate loop_rate(100ms);
+  while (!cluster_node->is_activated() && rclcpp::ok()) {
+    rclcpp::spin_some(cluster_node->get_node_base_interface());
+    loop_rate.sleep();
+  }
+
+  std::vector<foros_msgs::msg::Inspector::SharedPtr> messages;
+  cluster_node->register_on_committed_message<foros_msgs::msg::Inspector>(
+      [&](const uint64_t, foros_msgs::msg::Inspector::SharedPtr message) {
+        messages.push_back(message);
+      });
+
+  foros_msgs::msg::Inspector message;
+  message.cluster_name = kClusterName;
+  message.term = 42;
+  auto response = cluster_node->commit_message(message, nullptr).get();
+  EXPECT_EQ(response->result(), true);
+
+  ASSERT_EQ(messages.size(), (std::size_t)1);
+  EXPECT_EQ(messages[0]->cluster_name, kClusterName);
+  EXPECT_EQ(messages[0]->term, (uint64_t)42);
+
+  foros_msgs::msg::Inspector committed;
+  ASSERT_EQ(akit::failover::foros::deserialize_command(
+                *cluster_node->get_command(response->id()), committed),
+            true);
+  EXPECT_EQ(committed, message);
+}
+
+TEST_F(TestClusterNode, TestCommandCommitAwaitable) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error &err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  auto cluster_node = std::make_shared<akit::failover::foros::ClusterNode>(
+      kClusterName, kNodeId, kClusterIds, kNamespace);
+
+  rclcpp::WallRate loop_rate(100ms);
+  while (!cluster_node->is_activated() && rclcpp::ok()) {
+    rclcpp::spin_some(cluster_node->get_node_base_interface());
+    loop_rate.sleep();
+  }
+
+  // the tests are built as C++17, so a coroutine handle is emulated
+  struct Handle {
+    bool *resumed;
+    std::thread::id *thread_id;
+    void resume() {
+      *resumed = true;
+      *thread_id = std::this_thread::get_id();
+    }
+  };
+
+  bool resumed = false;
+  std::thread::id resumed_thread_id;
+  auto awaitable =
+      cluster_node->commit(akit::failover::foros::Command::make_shared(
+          std::initializer_list<uint8_t>{kTestData}));
+  EXPECT_EQ(awaitable.await_ready(), false);
+  // the commit completes on the thread awaiting it, as it would on a raft
+  // thread, but the coroutine is resumed by the executor
+  std::thread([&]() {
+    awaitable.await_suspend(Handle{&resumed, &resumed_thread_id});
+  }).join();
+
+  EXPECT_EQ(resumed, false);
+  for (int i = 0; i < 10 && !resumed && rclcpp::ok(); i++) {
+    rclcpp::spin_some(cluster_node->get_node_base_interface());
+    loop_rate.sleep();
+  }
+  ASSERT_EQ(resumed, true);
+  EXPECT_EQ(resumed_thread_id, std::this_thread::get_id());
+
+  auto response = awaitable.await_resume();
+  ASSERT_NE(response, nullptr);
+  EXPECT_EQ(response->id(), (uint64_t)0);
+  EXPECT_EQ(response->result(), true);
+  EXPECT_EQ(cluster_node->get_commands_size(), (uint64_t)1);
+
+  // a coroutine waiting for the executor is completed as failed on shutdown
+  resumed = false;
+  auto pending =
+      cluster_node->commit(akit::failover::foros::Command::make_shared(
+          std::initializer_list<uint8_t>{kTestData}));
+  pending.await_suspend(Handle{&resumed, &resumed_thread_id});
+  EXPECT_EQ(resumed, false);
+  cluster_node.reset();
+  ASSERT_EQ(resumed, true);
+  response = pending.await_resume();
+  ASSERT_NE(response, nullptr);
+  EXPECT_EQ(response->result(), false);
+}
+
+TEST_F(TestClusterNode, TestKVStore) {
+  auto options = akit::failover::foros::ClusterNodeOptions();
+  options.storage_type(akit::failover::foros::StorageType::kMemory);
+  options.kv_store(true);
+  auto cluster_node = std::make_shared<akit::failover::foros::ClusterNode>(
+      kClusterName, kNodeId, kClusterIds, kNamespace, options);
+
+  rclcpp::WallRate loop_rate(100ms);
+  while (!cluster_node->is_activated() && rclcpp::ok()) {
+    rclcpp::spin_some(cluster_node->get_node_base_interface());
+    loop_rate.sleep();
+  }
+
+  const std::vector<uint8_t> kValue = {1, 2, 3};
+  const std::vector<uint8_t> kNewValue = {4, 5};
+  std::vector<uint8_t> value;
+  EXPECT_EQ(cluster_node->kv_get("key", value), false);
+
+  auto response = cluster_node->kv_set("key", kValue, nullptr).get();
+  EXPECT_EQ(response->id(), (uint64_t)0);
+  EXPECT_EQ(response->committed(), true);
+  EXPECT_EQ(response->result(), true);
+  EXPECT_EQ(cluster_node->kv_get("key", value), true);
+  EXPECT_EQ(value, kValue);
+
+  // compare-and-set is decided by the value when the command is applied
+  response =
+      cluster_node->kv_compare_and_set("key", kNewValue, kNewValue, nullptr)
+          .get();
+  EXPECT_EQ(response->committed(), true);
+  EXPECT_EQ(response->result(), false);
+  response =
+      cluster_node->kv_compare_and_set("key", kValue, kNewValue, nullptr).get();
+  EXPECT_EQ(response->result(), true);
+  EXPECT_EQ(cluster_node->kv_get("key", value), true);
+  EXPECT_EQ(value, kNewValue);
+
+  response = cluster_node->kv_delete("key", nullptr).get();
+  EXPECT_EQ(response->result(), true);
+  EXPECT_EQ(cluster_node->kv_get("key", value), false);
+  response = cluster_node->kv_delete("key", nullptr).get();
+  EXPECT_EQ(response->committed(), true);
+  EXPECT_EQ(response->result(), false);
+
+  // the requests are commands of the log as well
+  EXPECT_EQ(cluster_node->get_commands_size(), (uint64_t)5);
+}
+
+TEST_F(TestClusterNode, TestKVWatch) {
+  auto options = akit::failover::foros::ClusterNodeOptions();
+  options.storage_type(akit::failover::foros::StorageType::kMemory);
+  options.kv_store(true);
+  auto cluster_node = std::make_shared<akit::failover::foros::ClusterNode>(
+      kClusterName, kNodeId, kClusterIds, kNamespace, options);
+
+  rclcpp::WallRate loop_rate(100ms);
+  while (!cluster_node->is_activated() && rclcpp::ok()) {
+    rclcpp::spin_some(cluster_node->get_node_base_interface());
+    loop_rate.sleep();
+  }
+
+  std::vector<akit::failover::foros::KVChange> changes;
+  auto watch_id = cluster_node->kv_watch(
+      "sensor/", true, 0ms,
+      [&](const std::vector<akit::failover::foros::KVChange> &batch) {
+        changes.insert(changes.end(), batch.begin(), batch.end());
+      });
+  EXPECT_NE(watch_id, (uint64_t)0);
+
+  // a burst is coalesced into the latest value of each key
+  cluster_node->kv_set("sensor/a", {1}, nullptr);
+  cluster_node->kv_set("other", {2}, nullptr);
+  cluster_node->kv_set("sensor/a", {3}, nullptr);
+  cluster_node->kv_delete("sensor/b", nullptr);
+  cluster_node->kv_set("sensor/b", {4}, nullptr);
+  EXPECT_EQ(changes.size(), (std::size_t)0);
+
+  rclcpp::spin_some(cluster_node->get_node_base_interface());
+  ASSERT_EQ(changes.size(), (std::size_t)2);
+  EXPECT_EQ(changes[0].key, "sensor/a");
+  EXPECT_EQ(changes[0].value, std::vector<uint8_t>({3}));
+  EXPECT_EQ(changes[0].id, (uint64_t)2);
+  EXPECT_EQ(changes[1].key, "sensor/b");
+  EXPECT_EQ(changes[1].deleted, false);
+  EXPECT_EQ(changes[1].value, std::vector<uint8_t>({4}));
+
+  cluster_node->kv_unwatch(watch_id);
+  cluster_node->kv_delete("sensor/a", nullptr);
+  rclcpp::spin_some(cluster_node->get_node_base_interface());
+  EXPECT_EQ(changes.size(), (std::size_t)2);
+}
+
+TEST_F(TestClusterNode, TestPost) {
+  auto cluster_node = std::make_shared<akit::failover::foros::ClusterNode>(
+      kClusterName, kNodeId, kClusterIds, kNamespace);
+
+  std::vector<int> tasks;
+  std::thread thread([&]() {
+    cluster_node->post([&]() { tasks.push_back(0); });
+    cluster_node->post([&]() { tasks.push_back(1); });
+  });
+  thread.join();
+  EXPECT_EQ(tasks.empty(), true);
+
+  rclcpp::spin_some(cluster_node->get_node_base_interface());
+  EXPECT_EQ(tasks, std::vector<int>({0, 1}));
+}
+
 TEST_F(TestClusterNode, TestParameter) {
   auto cluster_node = std::make_shared<akit::failover::foros::ClusterNode>(
       kClusterName, kNodeId, kClusterIds, kNamespace);
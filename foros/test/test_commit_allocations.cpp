@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <rclcpp/logger.hpp>
+#include <rclcpp/rclcpp.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "akit/failover/foros/command.hpp"
+#include "akit/failover/foros/commit_completion_queue.hpp"
+#include "akit/failover/foros/pool_allocator.hpp"
+#include "raft/context.hpp"
+#include "raft/state_machine_interface.hpp"
+
+// Counts every allocation made by the process, including the library.
+static std::atomic<uint64_t> allocation_count(0);
+
+void *operator new(std::size_t size) {
+  allocation_count++;
+  if (size == 0) {
+    size = 1;
+  }
+  if (auto block = std::malloc(size)) {
+    return block;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *block) noexcept { std::free(block); }
+
+void operator delete(void *block, std::size_t) noexcept { std::free(block); }
+
+class LeaderStateMachineInterface
+    : public akit::failover::foros::raft::StateMachineInterface {
+ public:
+  void on_election_timedout() override {}
+  void on_new_term_received() override {}
+  void on_elected() override {}
+  void on_broadcast_timedout() override {}
+  void on_leader_discovered() override {}
+  bool is_leader() override { return true; }
+  akit::failover::foros::raft::StateType get_current_state() override {
+    return akit::failover::foros::raft::StateType::kLeader;
+  }
+};
+
+class TestCommitAllocations : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() { rclcpp::init(0, nullptr); }
+  static void TearDownTestCase() { rclcpp::shutdown(); }
+
+  const char *kClusterName = "test_cluster";
+  const uint32_t kNodeId = 0;
+  const std::vector<uint32_t> kClusterIds =
+      std::initializer_list<uint32_t>{0};
+  const uint64_t kWarmUpCommits = 1000;
+  const uint64_t kCommits = 10000;
+  static constexpr std::size_t kCommandSize = 32;
+  const char kCommandData[kCommandSize] = {'a'};
+  const uint64_t kDrainInterval = 100;
+  const double kMaxAllocationsPerCommit = 2.0;
+  // the pool must save at least this ratio of the allocations
+  const double kMinAllocationReduction = 2.0;
+  const unsigned int kElectionTimeoutMin = 15000;
+  const unsigned int kElectionTimeoutMax = 20000;
+  rclcpp::Logger logger_ = rclcpp::get_logger("test_commit_allocations");
+
+  // Average allocations of commits made with the block pool enabled or not.
+  double measure_allocations(std::function<void(uint64_t)> commit,
+                             const bool pool_enabled) {
+    akit::failover::foros::BlockPool::set_enabled(pool_enabled);
+    for (uint64_t i = 0; i < kWarmUpCommits; i++) {
+      commit(i);
+    }
+
+    auto start_count = allocation_count.load();
+    for (uint64_t i = 0; i < kCommits; i++) {
+      commit(i);
+    }
+    auto allocations = allocation_count.load() - start_count;
+    akit::failover::foros::BlockPool::set_enabled(true);
+
+    return static_cast<double>(allocations) / static_cast<double>(kCommits);
+  }
+};
+
+TEST_F(TestCommitAllocations, TestLeaderCommitAllocations) {
+  auto node = rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId));
+  akit::failover::foros::raft::Context context(
+      kClusterName, kNodeId, node->get_node_base_interface(),
+      node->get_node_graph_interface(), node->get_node_services_interface(),
+      node->get_node_topics_interface(), node->get_node_timers_interface(),
+      node->get_node_clock_interface(), node->get_node_waitables_interface(),
+      kElectionTimeoutMin, kElectionTimeoutMax, "/tmp", logger_,
+      akit::failover::foros::StorageType::kMemory);
+
+  LeaderStateMachineInterface state_machine;
+  context.initialize(kClusterIds, &state_machine);
+
+  uint64_t committed = 0;
+  context.register_on_committed(
+      [&](const uint64_t, akit::failover::foros::Command::SharedPtr) {
+        committed++;
+      });
+
+  auto commit = [&](uint64_t) {
+    auto future = context.commit_command(
+        akit::failover::foros::Command::make_shared(kCommandData,
+                                                    kCommandSize),
+        nullptr);
+    EXPECT_EQ(future.get()->result(), true);
+  };
+
+  auto baseline = measure_allocations(commit, false);
+  auto pooled = measure_allocations(commit, true);
+  RecordProperty("baseline_allocations_per_commit", std::to_string(baseline));
+  RecordProperty("allocations_per_commit", std::to_string(pooled));
+
+  EXPECT_EQ(committed, 2 * (kWarmUpCommits + kCommits));
+  EXPECT_LE(pooled, kMaxAllocationsPerCommit);
+  EXPECT_GE(baseline, pooled * kMinAllocationReduction);
+}
+
+TEST_F(TestCommitAllocations, TestLeaderQueuedCommitAllocations) {
+  auto node = rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId));
+  akit::failover::foros::raft::Context context(
+      kClusterName, kNodeId, node->get_node_base_interface(),
+      node->get_node_graph_interface(), node->get_node_services_interface(),
+      node->get_node_topics_interface(), node->get_node_timers_interface(),
+      node->get_node_clock_interface(), node->get_node_waitables_interface(),
+      kElectionTimeoutMin, kElectionTimeoutMax, "/tmp", logger_,
+      akit::failover::foros::StorageType::kMemory);
+
+  LeaderStateMachineInterface state_machine;
+  context.initialize(kClusterIds, &state_machine);
+
+  auto queue = akit::failover::foros::CommitCompletionQueue::make_shared();
+  std::vector<akit::failover::foros::CommitCompletion> completions;
+  uint64_t completed = 0;
+
+  // completions are drained in batches like an application would do
+  auto commit = [&](uint64_t tag) {
+    context.commit_command(akit::failover::foros::Command::make_shared(
+                               kCommandData, kCommandSize),
+                           tag, queue);
+    if (tag % kDrainInterval == 0) {
+      queue->drain(completions);
+      for (auto &completion : completions) {
+        EXPECT_EQ(completion.result, true);
+      }
+      completed += completions.size();
+    }
+  };
+
+  auto baseline = measure_allocations(commit, false);
+  auto pooled = measure_allocations(commit, true);
+  RecordProperty("baseline_allocations_per_commit", std::to_string(baseline));
+  RecordProperty("allocations_per_commit", std::to_string(pooled));
+
+  completed += queue->drain(completions);
+  EXPECT_EQ(completed, 2 * (kWarmUpCommits + kCommits));
+  EXPECT_LE(pooled, kMaxAllocationsPerCommit);
+  EXPECT_GE(baseline, pooled * kMinAllocationReduction);
+}
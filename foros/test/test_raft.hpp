@@ -16,21 +16,38 @@
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <leveldb/db.h>
 #include <rclcpp/logger.hpp>
 #include <rclcpp/rclcpp.hpp>
 
+#include <atomic>
 #include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <future>
 #include <memory>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "akit/failover/foros/cluster_node.hpp"
+#include "common/byte_order.hpp"
+#include "common/crc32c.hpp"
+#include "common/delta_codec.hpp"
 #include "common/node_util.hpp"
+#include "kv_store.hpp"
 #include "raft/context.hpp"
 #include "raft/context_store.hpp"
+#include "raft/entry_codec.hpp"
+#include "raft/session_table.hpp"
 #include "raft/state_machine.hpp"
 #include "raft/state_machine_interface.hpp"
+#include "raft/storage/leveldb_storage.hpp"
+#include "raft/storage/memory_storage.hpp"
+#include "raft/storage/wal_storage.hpp"
+#include "raft/storage_worker.hpp"
+#include "raft/term_index.hpp"
 
 class TestRaft : public ::testing::Test {
  protected:
@@ -77,14 +94,18 @@ class TestContext : public akit::failover::foros::raft::Context {
               rclcpp::Node::SharedPtr node,
               const unsigned int election_timeout_min,
               const unsigned int election_timeout_max,
-              const std::string& temp_directory, rclcpp::Logger& logger)
+              const std::string& temp_directory, rclcpp::Logger& logger,
+              const bool commit_forwarding = false)
       : akit::failover::foros::raft::Context(
             cluster_name, node_id, node->get_node_base_interface(),
             node->get_node_graph_interface(),
             node->get_node_services_interface(),
             node->get_node_topics_interface(),
             node->get_node_timers_interface(), node->get_node_clock_interface(),
-            election_timeout_min, election_timeout_max, temp_directory, logger),
+            node->get_node_waitables_interface(), election_timeout_min,
+            election_timeout_max, temp_directory, logger,
+            akit::failover::foros::StorageType::kLevelDB,
+            akit::failover::foros::raft::EntryCodec(), 0, commit_forwarding),
         cluster_name_(cluster_name),
         node_id_(node_id) {
     rcl_client_options_t client_options = rcl_client_get_default_options();
@@ -100,11 +121,11 @@ class TestContext : public akit::failover::foros::raft::Context {
             client_options);
   }
 
-  rclcpp::Client<foros_msgs::srv::AppendEntries>::SharedFuture
-  send_append_entries_to_me(uint64_t term, uint32_t leader_id,
-                            uint64_t leader_commit, uint64_t prev_log_index,
-                            uint64_t prev_log_term,
-                            std::vector<uint8_t> entries) {
+  foros_msgs::srv::AppendEntries::Request::SharedPtr
+  make_append_entries_request(uint64_t term, uint32_t leader_id,
+                              uint64_t leader_commit, uint64_t prev_log_index,
+                              uint64_t prev_log_term,
+                              std::vector<uint8_t> entries) {
     auto request = std::make_shared<foros_msgs::srv::AppendEntries::Request>();
     request->term = term;
     request->leader_id = leader_id;
@@ -112,9 +133,41 @@ class TestContext : public akit::failover::foros::raft::Context {
     request->prev_log_index = prev_log_index;
     request->prev_log_term = prev_log_term;
     request->entries = entries;
+    request->entries_crc =
+        akit::failover::foros::CRC32C::value(entries.data(), entries.size());
+    return request;
+  }
+
+  // Split the entries of the request into a batch of entries of the sizes.
+  static void set_entries_sizes(
+      foros_msgs::srv::AppendEntries::Request::SharedPtr request,
+      const std::vector<uint32_t>& sizes) {
+    request->entries_sizes = sizes;
+    request->entries_crcs.clear();
+    auto data = request->entries.data();
+    for (auto size : sizes) {
+      request->entries_crcs.push_back(
+          akit::failover::foros::CRC32C::value(data, size));
+      data += size;
+    }
+  }
+
+  rclcpp::Client<foros_msgs::srv::AppendEntries>::SharedFuture
+  send_append_entries_to_me(
+      foros_msgs::srv::AppendEntries::Request::SharedPtr request) {
     return append_entries_->async_send_request(request).future.share();
   }
 
+  rclcpp::Client<foros_msgs::srv::AppendEntries>::SharedFuture
+  send_append_entries_to_me(uint64_t term, uint32_t leader_id,
+                            uint64_t leader_commit, uint64_t prev_log_index,
+                            uint64_t prev_log_term,
+                            std::vector<uint8_t> entries) {
+    return send_append_entries_to_me(make_append_entries_request(
+        term, leader_id, leader_commit, prev_log_index, prev_log_term,
+        entries));
+  }
+
  private:
   rclcpp::Client<foros_msgs::srv::AppendEntries>::SharedPtr append_entries_;
   std::string cluster_name_;
@@ -194,6 +247,1268 @@ TEST_F(TestRaft, TestContextStoreWithInitialData) {
   EXPECT_EQ(log->command_->data().size(), sizeof(kTestData));
 }
 
+TEST_F(TestRaft, TestContextStoreHardState) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  {
+    auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+    EXPECT_EQ(store.hard_state(kCurrentTerm, kVotedFor, true), true);
+  }
+
+  auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+  auto hard_state = store.hard_state();
+  EXPECT_EQ(hard_state.term_, kCurrentTerm);
+  EXPECT_EQ(hard_state.voted_for_, kVotedFor);
+  EXPECT_EQ(hard_state.voted_, true);
+
+  EXPECT_EQ(store.reset_vote(), true);
+  EXPECT_EQ(store.current_term(), kCurrentTerm);
+  EXPECT_EQ(store.voted_for(), (uint32_t)0);
+  EXPECT_EQ(store.voted(), false);
+
+  EXPECT_EQ(store.vote(kVotedFor), true);
+  EXPECT_EQ(store.voted_for(), kVotedFor);
+  EXPECT_EQ(store.voted(), true);
+
+  // only one candidate is granted a vote in a term
+  EXPECT_EQ(store.reset_vote(), true);
+  uint64_t term = kCurrentTerm - 1;
+  EXPECT_EQ(store.grant_vote(kVotedFor, term), false);
+  EXPECT_EQ(term, kCurrentTerm);
+  EXPECT_EQ(store.voted(), false);
+
+  std::atomic<int> granted(0);
+  std::vector<std::thread> candidates;
+  for (uint32_t id = 1; id <= 4; id++) {
+    candidates.emplace_back([&store, &granted, id, this]() {
+      uint64_t term = kCurrentTerm;
+      if (store.grant_vote(id, term) == true) {
+        granted++;
+      }
+    });
+  }
+  for (auto &candidate : candidates) {
+    candidate.join();
+  }
+  EXPECT_EQ(granted, 1);
+  EXPECT_EQ(store.voted(), true);
+}
+
+TEST_F(TestRaft, TestContextStoreAppliedSize) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  {
+    auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+    for (uint64_t i = 0; i < kMaxCommitSize; i++) {
+      auto log = akit::failover::foros::raft::LogEntry::make_shared(
+          i, kCurrentTerm + i,
+          akit::failover::foros::Command::make_shared(
+              std::initializer_list<uint8_t>{static_cast<uint8_t>(i)}));
+      EXPECT_EQ(store.push_log(log), true);
+    }
+    EXPECT_EQ(store.applied_size(kMaxCommitSize + 1), false);
+    EXPECT_EQ(store.applied_size(kMaxCommitSize - 1), true);
+    // the applied size never goes back on acknowledgements
+    EXPECT_EQ(store.applied_size(1), true);
+    EXPECT_EQ(store.applied_size(), kMaxCommitSize - 1);
+  }
+
+  // the applied logs are read from the storage after a restart
+  auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+  EXPECT_EQ(store.applied_size(), kMaxCommitSize - 1);
+  EXPECT_EQ(store.logs_size(), kMaxCommitSize);
+  for (uint64_t i = 0; i < kMaxCommitSize; i++) {
+    auto log = store.log(i);
+    ASSERT_NE(log, nullptr);
+    EXPECT_EQ(log->term_, kCurrentTerm + i);
+    EXPECT_EQ(log->command_->data()[0], i);
+    EXPECT_EQ(store.log_term(i), kCurrentTerm + i);
+  }
+
+  // reverted logs are not applied anymore
+  EXPECT_EQ(store.revert_log(1), true);
+  EXPECT_EQ(store.applied_size(), (uint64_t)1);
+}
+
+TEST_F(TestRaft, TestContextStoreSnapshotSize) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  {
+    auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+    for (uint64_t i = 0; i < kMaxCommitSize; i++) {
+      auto log = akit::failover::foros::raft::LogEntry::make_shared(
+          i, kCurrentTerm,
+          akit::failover::foros::Command::make_shared(
+              std::initializer_list<uint8_t>{static_cast<uint8_t>(i)}));
+      EXPECT_EQ(store.push_log(log), true);
+    }
+    EXPECT_EQ(store.snapshot_size(kMaxCommitSize + 1), false);
+    EXPECT_EQ(store.snapshot_size(1), true);
+    EXPECT_EQ(store.snapshot_size(0), true);
+    // the snapshot does not change the applied size of the application
+    EXPECT_EQ(store.applied_size(kMaxCommitSize), true);
+    EXPECT_EQ(store.applied_size(), kMaxCommitSize);
+  }
+
+  // the logs after the snapshot are loaded again
+  {
+    auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+    EXPECT_EQ(store.applied_size(), (uint64_t)1);
+    EXPECT_EQ(store.snapshot_size(kMaxCommitSize), true);
+  }
+
+  // and so are the logs after the applied size
+  auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+  EXPECT_EQ(store.applied_size(), (uint64_t)1);
+  EXPECT_EQ(store.logs_size(), kMaxCommitSize);
+}
+
+TEST_F(TestRaft, TestContextStoreUncommittedLogs) {
+  const std::string kWALPath = "/tmp/foros_test_wal";
+  std::function<std::unique_ptr<akit::failover::foros::raft::Storage>()>
+      storages[] = {
+          [&]() {
+            return std::make_unique<
+                akit::failover::foros::raft::LevelDBStorage>(kStorePath,
+                                                            logger_);
+          },
+          [&]() {
+            return std::make_unique<akit::failover::foros::raft::WALStorage>(
+                kWALPath, logger_);
+          }};
+
+  for (auto &create_storage : storages) {
+    try {
+      std::filesystem::remove_all(kStorePath);
+      std::filesystem::remove_all(kWALPath);
+    } catch (const std::filesystem::filesystem_error& err) {
+      RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+    }
+
+    std::vector<akit::failover::foros::raft::LogEntry::SharedPtr> logs;
+    for (uint64_t i = 0; i < 4; i++) {
+      logs.push_back(akit::failover::foros::raft::LogEntry::make_shared(
+          i, kCurrentTerm,
+          akit::failover::foros::Command::make_shared(
+              std::initializer_list<uint8_t>{static_cast<uint8_t>(i)})));
+    }
+
+    {
+      auto store =
+          akit::failover::foros::raft::ContextStore(create_storage(), logger_);
+      EXPECT_EQ(store.push_logs({logs[0], logs[1]}), true);
+      // a leader persists a log before it is agreed
+      std::promise<bool> persisted;
+      store.persist_log(logs[2],
+                        [&](bool result) { persisted.set_value(result); });
+      EXPECT_EQ(persisted.get_future().get(), true);
+    }
+
+    // the log which was never appended is discarded on load
+    {
+      auto store =
+          akit::failover::foros::raft::ContextStore(create_storage(), logger_);
+      EXPECT_EQ(store.logs_size(), (uint64_t)2);
+      EXPECT_EQ(store.log(2), nullptr);
+
+      std::promise<bool> persisted;
+      store.persist_log(logs[2],
+                        [&](bool result) { persisted.set_value(result); });
+      EXPECT_EQ(persisted.get_future().get(), true);
+      EXPECT_EQ(store.append_log(logs[2]), true);
+      store.store_commit_size();
+    }
+
+    // the appended log is kept, and so are the logs persisted by a follower
+    {
+      auto store =
+          akit::failover::foros::raft::ContextStore(create_storage(), logger_);
+      EXPECT_EQ(store.logs_size(), (uint64_t)3);
+      ASSERT_NE(store.log(2), nullptr);
+      EXPECT_EQ(store.log(2)->command_->data()[0], 2);
+
+      std::promise<bool> persisted;
+      store.persist_committed_logs(
+          {logs[3]}, [&](bool result) { persisted.set_value(result); });
+      EXPECT_EQ(persisted.get_future().get(), true);
+    }
+
+    {
+      auto store =
+          akit::failover::foros::raft::ContextStore(create_storage(), logger_);
+      EXPECT_EQ(store.logs_size(), (uint64_t)4);
+
+      // the logs written again after a revert are not committed
+      EXPECT_EQ(store.revert_log(1), true);
+      std::promise<bool> persisted;
+      store.persist_logs({logs[1], logs[2]},
+                         [&](bool result) { persisted.set_value(result); });
+      EXPECT_EQ(persisted.get_future().get(), true);
+    }
+
+    auto store =
+        akit::failover::foros::raft::ContextStore(create_storage(), logger_);
+    EXPECT_EQ(store.logs_size(), (uint64_t)1);
+  }
+}
+
+TEST_F(TestRaft, TestContextStoreLogOrder) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  // more than 10 logs to check the ids are not sorted lexicographically
+  const uint64_t kLogSize = 12;
+  {
+    auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+    for (uint64_t i = 0; i < kLogSize; i++) {
+      auto command = akit::failover::foros::Command::make_shared(
+          std::initializer_list<uint8_t>{static_cast<uint8_t>(i)});
+      auto log = akit::failover::foros::raft::LogEntry::make_shared(
+          i, kCurrentTerm + i, command);
+      EXPECT_EQ(store.push_log(log), true);
+    }
+  }
+
+  auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+  EXPECT_EQ(store.logs_size(), kLogSize);
+  for (uint64_t i = 0; i < kLogSize; i++) {
+    auto log = store.log(i);
+    ASSERT_NE(log, nullptr);
+    EXPECT_EQ(log->id_, i);
+    EXPECT_EQ(log->term_, kCurrentTerm + i);
+    EXPECT_EQ(log->command_->data()[0], static_cast<uint8_t>(i));
+  }
+}
+
+TEST_F(TestRaft, TestContextStoreGarbageCollection) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  const uint64_t kLogSize = 12;
+  const uint64_t kRevertedSize = 4;
+  {
+    auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+    for (uint64_t i = 0; i < kLogSize; i++) {
+      auto command = akit::failover::foros::Command::make_shared(
+          std::initializer_list<uint8_t>{static_cast<uint8_t>(i)});
+      auto log = akit::failover::foros::raft::LogEntry::make_shared(
+          i, kCurrentTerm, command);
+      EXPECT_EQ(store.push_log(log), true);
+    }
+    // the collection requested by the revert finishes before it is closed
+    EXPECT_EQ(store.revert_log(kRevertedSize), true);
+  }
+
+  // only the records of the live logs are left
+  {
+    leveldb::DB* db;
+    leveldb::Options options;
+    ASSERT_TRUE(leveldb::DB::Open(options, kStorePath, &db).ok());
+    std::vector<uint64_t> ids;
+    std::unique_ptr<leveldb::Iterator> it(
+        db->NewIterator(leveldb::ReadOptions()));
+    for (it->Seek("log/"); it->Valid() && it->key().starts_with("log/");
+         it->Next()) {
+      ASSERT_EQ(it->key().size(), (std::size_t)12);
+      ids.push_back(akit::failover::foros::ByteOrder::decode_big_endian64(
+          it->key().data() + 4));
+    }
+    it.reset();
+    delete db;
+    EXPECT_EQ(ids, std::vector<uint64_t>({0, 1, 2, 3}));
+  }
+
+  auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+  EXPECT_EQ(store.logs_size(), kRevertedSize);
+  for (uint64_t i = 0; i < kRevertedSize; i++) {
+    auto log = store.log(i);
+    ASSERT_NE(log, nullptr);
+    EXPECT_EQ(log->command_->data()[0], static_cast<uint8_t>(i));
+  }
+}
+
+TEST_F(TestRaft, TestContextStoreLegacyMigration) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  // write logs in the unversioned format
+  {
+    leveldb::DB* db;
+    leveldb::Options options;
+    options.create_if_missing = true;
+    ASSERT_TRUE(leveldb::DB::Open(options, kStorePath, &db).ok());
+
+    for (uint64_t i = 0; i < kMaxCommitSize; i++) {
+      auto prefix = "log/" + std::to_string(i);
+      db->Put(leveldb::WriteOptions(), prefix + "/term",
+              leveldb::Slice(reinterpret_cast<const char*>(&kCurrentTerm),
+                             sizeof(uint64_t)));
+      db->Put(leveldb::WriteOptions(), prefix + "/data",
+              leveldb::Slice(reinterpret_cast<const char*>(&kTestData),
+                             sizeof(uint8_t)));
+    }
+    db->Put(leveldb::WriteOptions(), "log_size",
+            leveldb::Slice(reinterpret_cast<const char*>(&kMaxCommitSize),
+                           sizeof(uint64_t)));
+    delete db;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+    EXPECT_EQ(store.logs_size(), kMaxCommitSize);
+    auto log = store.log(kMaxCommitSize - 1);
+    ASSERT_NE(log, nullptr);
+    EXPECT_EQ(log->id_, kMaxCommitSize - 1);
+    EXPECT_EQ(log->term_, kCurrentTerm);
+    EXPECT_EQ(log->command_->data()[0], kTestData);
+  }
+
+  // the log size and the version are migrated to big-endian
+  {
+    leveldb::DB* db;
+    ASSERT_TRUE(leveldb::DB::Open(leveldb::Options(), kStorePath, &db).ok());
+    std::string value;
+    ASSERT_TRUE(db->Get(leveldb::ReadOptions(), "log_size", &value).ok());
+    ASSERT_EQ(value.size(), sizeof(uint64_t));
+    EXPECT_EQ(akit::failover::foros::ByteOrder::decode_big_endian64(
+                  value.data()),
+              kMaxCommitSize);
+    ASSERT_TRUE(
+        db->Get(leveldb::ReadOptions(), "format_version", &value).ok());
+    ASSERT_EQ(value.size(), sizeof(uint32_t));
+    EXPECT_EQ(akit::failover::foros::ByteOrder::decode_big_endian32(
+                  value.data()),
+              (uint32_t)4);
+    delete db;
+  }
+}
+
+TEST_F(TestRaft, TestContextStoreCorruptedLog) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  {
+    auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+    auto command = akit::failover::foros::Command::make_shared(
+        std::initializer_list<uint8_t>{kTestData});
+    for (uint64_t i = 0; i < kMaxCommitSize; i++) {
+      auto log = akit::failover::foros::raft::LogEntry::make_shared(
+          i, kCurrentTerm, command);
+      EXPECT_EQ(store.push_log(log), true);
+    }
+  }
+
+  // flip the data of the second log
+  {
+    leveldb::DB* db;
+    ASSERT_TRUE(leveldb::DB::Open(leveldb::Options(), kStorePath, &db).ok());
+    std::string key("log/");
+    key.append(7, '\0');
+    key.push_back(1);
+    std::string value;
+    ASSERT_TRUE(db->Get(leveldb::ReadOptions(), key, &value).ok());
+    value.back() = ~value.back();
+    db->Put(leveldb::WriteOptions(), key, value);
+    delete db;
+  }
+
+  // the logs from the corrupted one are dropped
+  auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+  EXPECT_EQ(store.logs_size(), (uint64_t)1);
+}
+
+TEST_F(TestRaft, TestContextStoreCommandType) {
+  const std::string kWALPath = "/tmp/foros_test_wal";
+  for (auto& path : {kStorePath, kWALPath}) {
+    try {
+      std::filesystem::remove_all(path);
+    } catch (const std::filesystem::filesystem_error& err) {
+      RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+    }
+  }
+
+  auto create_storage = [&](const bool wal) {
+    std::unique_ptr<akit::failover::foros::raft::Storage> storage;
+    if (wal == true) {
+      storage = std::make_unique<akit::failover::foros::raft::WALStorage>(
+          kWALPath, logger_,
+          akit::failover::foros::raft::EntryCodec(true, 0));
+    } else {
+      storage = std::make_unique<akit::failover::foros::raft::LevelDBStorage>(
+          kStorePath, logger_);
+    }
+    return storage;
+  };
+
+  // the type is stored next to the data, which is the same for every log
+  for (auto wal : {false, true}) {
+    {
+      auto store = akit::failover::foros::raft::ContextStore(
+          create_storage(wal), logger_);
+      for (uint64_t i = 0; i < kMaxCommitSize; i++) {
+        auto command = akit::failover::foros::Command::make_shared(
+            std::initializer_list<uint8_t>{kTestData});
+        if (i % 2 == 1) {
+          command->set_type(akit::failover::foros::CommandType::kKeyValue);
+        }
+        auto log = akit::failover::foros::raft::LogEntry::make_shared(
+            i, kCurrentTerm, command);
+        EXPECT_EQ(store.push_log(log), true);
+      }
+    }
+
+    auto store = akit::failover::foros::raft::ContextStore(create_storage(wal),
+                                                           logger_);
+    ASSERT_EQ(store.logs_size(), kMaxCommitSize);
+    for (uint64_t i = 0; i < kMaxCommitSize; i++) {
+      auto log = store.log(i);
+      ASSERT_NE(log, nullptr);
+      ASSERT_EQ(log->command_->data().size(), (std::size_t)1);
+      EXPECT_EQ(log->command_->data()[0], kTestData);
+      EXPECT_EQ(log->command_->type(),
+                i % 2 == 1 ? akit::failover::foros::CommandType::kKeyValue
+                           : akit::failover::foros::CommandType::kApplication);
+    }
+  }
+
+  // logs of format version 2 have no header and are application commands
+  std::filesystem::remove_all(kStorePath);
+  {
+    leveldb::DB* db;
+    leveldb::Options options;
+    options.create_if_missing = true;
+    ASSERT_TRUE(leveldb::DB::Open(options, kStorePath, &db).ok());
+    uint32_t version = 2;
+    uint64_t size = 1;
+    db->Put(leveldb::WriteOptions(), "log_size",
+            leveldb::Slice(reinterpret_cast<const char*>(&size),
+                           sizeof(uint64_t)));
+    db->Put(leveldb::WriteOptions(), "format_version",
+            leveldb::Slice(reinterpret_cast<const char*>(&version),
+                           sizeof(uint32_t)));
+    std::string key("log/");
+    key.append(8, '\0');
+    std::string value(12, '\0');
+    akit::failover::foros::ByteOrder::encode_big_endian64(&value[0],
+                                                          kCurrentTerm);
+    value.push_back(static_cast<char>(kTestData));
+    akit::failover::foros::ByteOrder::encode_big_endian32(
+        &value[8], akit::failover::foros::CRC32C::extend(
+                       akit::failover::foros::CRC32C::value(value.data(), 8),
+                       value.data() + 12, 1));
+    db->Put(leveldb::WriteOptions(), key, value);
+    delete db;
+  }
+
+  auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+  auto log = store.log(0);
+  ASSERT_NE(log, nullptr);
+  EXPECT_EQ(log->term_, kCurrentTerm);
+  ASSERT_EQ(log->command_->data().size(), (std::size_t)1);
+  EXPECT_EQ(log->command_->data()[0], kTestData);
+  EXPECT_EQ(log->command_->type(),
+            akit::failover::foros::CommandType::kApplication);
+}
+
+TEST_F(TestRaft, TestContextStoreWithMemoryStorage) {
+  auto store = akit::failover::foros::raft::ContextStore(
+      std::make_unique<akit::failover::foros::raft::MemoryStorage>(), logger_);
+
+  EXPECT_EQ(store.current_term(), (uint64_t)0);
+  EXPECT_EQ(store.hard_state(kCurrentTerm, kVotedFor, true), true);
+  EXPECT_EQ(store.current_term(), kCurrentTerm);
+
+  auto command = akit::failover::foros::Command::make_shared(
+      std::initializer_list<uint8_t>{kTestData});
+  for (uint64_t i = 0; i < kMaxCommitSize; i++) {
+    auto log = akit::failover::foros::raft::LogEntry::make_shared(
+        i, kCurrentTerm, command);
+    EXPECT_EQ(store.push_log(log), true);
+  }
+  EXPECT_EQ(store.logs_size(), kMaxCommitSize);
+  EXPECT_EQ(store.revert_log(1), true);
+  EXPECT_EQ(store.logs_size(), (uint64_t)1);
+}
+
+TEST_F(TestRaft, TestContextStoreWithWALStorage) {
+  const std::string kWALPath = "/tmp/foros_test_wal";
+  try {
+    std::filesystem::remove_all(kWALPath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  {
+    auto store = akit::failover::foros::raft::ContextStore(
+        std::make_unique<akit::failover::foros::raft::WALStorage>(kWALPath,
+                                                                  logger_),
+        logger_);
+    EXPECT_EQ(store.hard_state(kCurrentTerm, kVotedFor, true), true);
+    for (uint64_t i = 0; i < kMaxCommitSize; i++) {
+      auto command = akit::failover::foros::Command::make_shared(
+          std::initializer_list<uint8_t>{static_cast<uint8_t>(i)});
+      auto log = akit::failover::foros::raft::LogEntry::make_shared(
+          i, kCurrentTerm + i, command);
+      EXPECT_EQ(store.push_log(log), true);
+    }
+    EXPECT_EQ(store.revert_log(kMaxCommitSize - 1), true);
+  }
+
+  // a record cut by a crash is dropped on open
+  {
+    std::ofstream wal(kWALPath + "/wal", std::ios::binary | std::ios::app);
+    wal.put(1);
+  }
+
+  auto store = akit::failover::foros::raft::ContextStore(
+      std::make_unique<akit::failover::foros::raft::WALStorage>(kWALPath,
+                                                                logger_),
+      logger_);
+  EXPECT_EQ(store.current_term(), kCurrentTerm);
+  EXPECT_EQ(store.voted_for(), kVotedFor);
+  EXPECT_EQ(store.voted(), true);
+  ASSERT_EQ(store.logs_size(), kMaxCommitSize - 1);
+  for (uint64_t i = 0; i < kMaxCommitSize - 1; i++) {
+    auto log = store.log(i);
+    ASSERT_NE(log, nullptr);
+    EXPECT_EQ(log->term_, kCurrentTerm + i);
+    EXPECT_EQ(log->command_->data()[0], static_cast<uint8_t>(i));
+  }
+  EXPECT_EQ(store.log_term(kMaxCommitSize - 2),
+            kCurrentTerm + kMaxCommitSize - 2);
+
+  auto log = akit::failover::foros::raft::LogEntry::make_shared(
+      kMaxCommitSize - 1, kCurrentTerm,
+      akit::failover::foros::Command::make_shared(
+          std::initializer_list<uint8_t>{kTestData}));
+  EXPECT_EQ(store.push_log(log), true);
+}
+
+TEST_F(TestRaft, TestCommandSharedBuffer) {
+  auto buffer = std::make_shared<const std::vector<uint8_t>>(
+      akit::failover::foros::Command::kSmallDataSize * 2, kTestData);
+  auto command = akit::failover::foros::Command::make_shared(buffer);
+
+  // the buffer is shared by the command and its copies, not copied
+  EXPECT_EQ(command->buffer(), buffer);
+  EXPECT_EQ(&command->data(), buffer.get());
+  EXPECT_EQ(command->view().data(), buffer->data());
+  auto copy = akit::failover::foros::Command::make_shared(*command);
+  EXPECT_EQ(copy->buffer(), buffer);
+  EXPECT_EQ(copy->view().data(), buffer->data());
+
+  // small data is kept inline, and copied once for a vector
+  auto small = akit::failover::foros::Command::make_shared(
+      std::initializer_list<uint8_t>{kTestData});
+  ASSERT_EQ(small->view().size(), (std::size_t)1);
+  EXPECT_EQ(small->view()[0], kTestData);
+  auto& data = small->data();
+  ASSERT_EQ(data.size(), (std::size_t)1);
+  EXPECT_EQ(data[0], kTestData);
+  EXPECT_EQ(&small->data(), &data);
+  EXPECT_NE(small->view().data(), data.data());
+}
+
+TEST_F(TestRaft, TestDeltaCodec) {
+  const std::vector<uint8_t> kBase = {'{', 'x', ':', '1', '0', '}'};
+  const std::vector<uint8_t> kData = {'{', 'x', ':', '1', '1', '}'};
+
+  std::vector<uint8_t> delta;
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(akit::failover::foros::DeltaCodec::encode(kBase, kData, delta));
+  EXPECT_LT(delta.size(), kData.size());
+  ASSERT_TRUE(akit::failover::foros::DeltaCodec::decode(
+      kBase, delta.data(), delta.size(), data));
+  EXPECT_EQ(data, kData);
+
+  // a delta larger than the data is not used
+  EXPECT_FALSE(akit::failover::foros::DeltaCodec::encode(
+      std::vector<uint8_t>(), kData, delta));
+  // a delta referring beyond the base is rejected
+  ASSERT_TRUE(akit::failover::foros::DeltaCodec::encode(kBase, kData, delta));
+  EXPECT_FALSE(akit::failover::foros::DeltaCodec::decode(
+      std::vector<uint8_t>({'{'}), delta.data(), delta.size(), data));
+}
+
+TEST_F(TestRaft, TestEntryCodec) {
+  const uint32_t kThreshold = 64;
+  const std::vector<uint8_t> kSmall(kThreshold - 1, kTestData);
+  const std::vector<uint8_t> kLarge(kThreshold * 16, kTestData);
+  auto base_data = kLarge;
+  base_data[0] = 0;
+  const akit::failover::foros::CommandData base(base_data);
+
+  akit::failover::foros::raft::EntryCodec codec(false, kThreshold);
+  std::vector<uint8_t> encoded;
+  std::vector<uint8_t> decoded;
+  EXPECT_EQ(codec.encode(nullptr, kSmall, encoded),
+            akit::failover::foros::raft::EntryCodec::kRaw);
+  auto encoding = codec.encode(nullptr, kLarge, encoded);
+  ASSERT_EQ(encoding, akit::failover::foros::raft::EntryCodec::kCompressed);
+  EXPECT_LT(encoded.size(), kLarge.size());
+  ASSERT_TRUE(akit::failover::foros::raft::EntryCodec::decode(
+      encoding, nullptr, encoded.data(), encoded.size(), decoded));
+  EXPECT_EQ(decoded, kLarge);
+
+  // a delta smaller than the threshold is not compressed
+  akit::failover::foros::raft::EntryCodec delta_codec(true, kThreshold);
+  encoding = delta_codec.encode(&base, kLarge, encoded);
+  ASSERT_EQ(encoding, akit::failover::foros::raft::EntryCodec::kDelta);
+  ASSERT_TRUE(akit::failover::foros::raft::EntryCodec::decode(
+      encoding, &base, encoded.data(), encoded.size(), decoded));
+  EXPECT_EQ(decoded, kLarge);
+
+  // a corrupted block is rejected
+  encoding = codec.encode(nullptr, kLarge, encoded);
+  encoded.resize(encoded.size() / 2);
+  EXPECT_FALSE(akit::failover::foros::raft::EntryCodec::decode(
+      encoding, nullptr, encoded.data(), encoded.size(), decoded));
+}
+
+TEST_F(TestRaft, TestWALStorageSharedSync) {
+  const std::string kWALPath = "/tmp/foros_test_wal";
+  const uint64_t kCommitCount = 16;
+  try {
+    std::filesystem::remove_all(kWALPath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  std::vector<akit::failover::foros::raft::LogEntry::SharedPtr> logs;
+  for (uint64_t i = 0; i < kCommitCount; i++) {
+    logs.push_back(akit::failover::foros::raft::LogEntry::make_shared(
+        i, kCurrentTerm,
+        akit::failover::foros::Command::make_shared(
+            std::initializer_list<uint8_t>{static_cast<uint8_t>(i)})));
+  }
+
+  {
+    auto storage =
+        std::make_unique<akit::failover::foros::raft::WALStorage>(kWALPath,
+                                                                  logger_);
+    auto wal = storage.get();
+    auto store =
+        akit::failover::foros::raft::ContextStore(std::move(storage), logger_);
+    auto syncs = wal->syncs();
+
+    // The writer is held in the callback of the first log, while the storage
+    // worker goes on to queue the other ones without waiting for it.
+    std::promise<void> release;
+    auto released = release.get_future();
+    std::vector<std::promise<bool>> persisted(kCommitCount);
+    store.persist_committed_logs({logs[0]}, [&](bool result) {
+      released.wait();
+      persisted[0].set_value(result);
+    });
+    for (uint64_t i = 1; i < kCommitCount; i++) {
+      store.persist_committed_logs(
+          {logs[i]}, [&, i](bool result) { persisted[i].set_value(result); });
+    }
+    for (int i = 0; i < 1000 && wal->load_logs_size() < kCommitCount; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(wal->load_logs_size(), kCommitCount);
+    release.set_value();
+
+    for (uint64_t i = 0; i < kCommitCount; i++) {
+      EXPECT_EQ(persisted[i].get_future().get(), true);
+      EXPECT_EQ(store.append_log(logs[i]), true);
+    }
+    // the logs queued behind the first batch share a single sync
+    EXPECT_LE(wal->syncs() - syncs, (uint64_t)2);
+  }
+
+  auto store = akit::failover::foros::raft::ContextStore(
+      std::make_unique<akit::failover::foros::raft::WALStorage>(kWALPath,
+                                                                logger_),
+      logger_);
+  EXPECT_EQ(store.logs_size(), kCommitCount);
+  for (uint64_t i = 0; i < kCommitCount; i++) {
+    ASSERT_NE(store.log(i), nullptr);
+    EXPECT_EQ(store.log(i)->command_->data()[0], i);
+  }
+}
+
+TEST_F(TestRaft, TestWALStorageDeltaEncoding) {
+  const std::string kWALPath = "/tmp/foros_test_wal_delta";
+  const std::string kRawWALPath = "/tmp/foros_test_wal_raw";
+  const uint64_t kLogsSize = 200;
+  try {
+    std::filesystem::remove_all(kWALPath);
+    std::filesystem::remove_all(kRawWALPath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  auto get_data = [](uint64_t i) {
+    auto text = "{\"seq\":" + std::to_string(i) + ",\"status\":\"ok\"}";
+    return std::vector<uint8_t>(text.begin(), text.end());
+  };
+
+  auto store_logs = [&](const std::string& path, const bool delta_encoding) {
+    akit::failover::foros::raft::WALStorage storage(
+        path, logger_,
+        akit::failover::foros::raft::EntryCodec(delta_encoding));
+    for (uint64_t i = 0; i < kLogsSize; i++) {
+      EXPECT_TRUE(
+          storage.store_log(akit::failover::foros::raft::LogEntry::make_shared(
+              i, kCurrentTerm,
+              akit::failover::foros::Command::make_shared(get_data(i)))));
+    }
+  };
+  store_logs(kWALPath, true);
+  store_logs(kRawWALPath, false);
+
+  // the records of both files have the same headers, so the saving is the
+  // data of the commands that deltas leave out
+  EXPECT_LT(std::filesystem::file_size(kWALPath + "/wal"),
+            std::filesystem::file_size(kRawWALPath + "/wal") -
+                kLogsSize * get_data(0).size() / 2);
+
+  akit::failover::foros::raft::WALStorage storage(
+      kWALPath, logger_, akit::failover::foros::raft::EntryCodec(true));
+  auto logs = storage.load_logs(0);
+  ASSERT_EQ(logs.size(), kLogsSize);
+  for (uint64_t i = 0; i < kLogsSize; i++) {
+    EXPECT_EQ(logs[i]->command_->data(), get_data(i));
+  }
+  auto log = storage.load_log(kLogsSize - 1);
+  ASSERT_NE(log, nullptr);
+  EXPECT_EQ(log->command_->data(), get_data(kLogsSize - 1));
+}
+
+TEST_F(TestRaft, TestCRC32C) {
+  const std::string kCheckValue = "123456789";
+  const std::vector<uint8_t> kZeros(32, 0);
+
+  EXPECT_EQ(akit::failover::foros::CRC32C::value(kCheckValue.data(),
+                                                 kCheckValue.size()),
+            (uint32_t)0xE3069283);
+  EXPECT_EQ(akit::failover::foros::CRC32C::value(kZeros.data(), kZeros.size()),
+            (uint32_t)0x8A9136AA);
+  auto crc = akit::failover::foros::CRC32C::value(kCheckValue.data(), 4);
+  EXPECT_EQ(akit::failover::foros::CRC32C::extend(
+                crc, kCheckValue.data() + 4, kCheckValue.size() - 4),
+            (uint32_t)0xE3069283);
+}
+
+TEST_F(TestRaft, TestWALStorageCorruptedRecord) {
+  const std::string kWALPath = "/tmp/foros_test_wal_corrupted";
+  try {
+    std::filesystem::remove_all(kWALPath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  akit::failover::foros::raft::HardState state;
+  state.term_ = kCurrentTerm;
+  std::vector<uint64_t> offsets;
+  {
+    akit::failover::foros::raft::WALStorage storage(kWALPath, logger_);
+    for (uint64_t i = 0; i < kMaxCommitSize; i++) {
+      offsets.push_back(std::filesystem::file_size(kWALPath + "/wal"));
+      EXPECT_TRUE(
+          storage.store_log(akit::failover::foros::raft::LogEntry::make_shared(
+              i, kCurrentTerm,
+              akit::failover::foros::Command::make_shared(
+                  std::initializer_list<uint8_t>{kTestData}))));
+    }
+    EXPECT_TRUE(storage.store_hard_state(state));
+  }
+
+  // flip the last byte of the second log record
+  {
+    std::fstream file(kWALPath + "/wal",
+                      std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offsets[2] - 1);
+    file.put(~kTestData);
+  }
+
+  // the logs from the corrupted one are dropped, but later records are kept
+  akit::failover::foros::raft::WALStorage storage(kWALPath, logger_);
+  EXPECT_EQ(storage.load_logs(0).size(), (uint64_t)1);
+  EXPECT_EQ(storage.load_hard_state().term_, kCurrentTerm);
+}
+
+TEST_F(TestRaft, TestContextStoreConcurrentRead) {
+  const uint64_t kLogsSize = 5000;
+  auto store = akit::failover::foros::raft::ContextStore(
+      std::make_unique<akit::failover::foros::raft::MemoryStorage>(), logger_);
+
+  std::atomic<bool> done(false);
+  std::thread reader([&]() {
+    while (done == false) {
+      auto size = store.logs_size();
+      if (size > 0) {
+        auto log = store.log(size - 1);
+        EXPECT_NE(log, nullptr);
+        EXPECT_EQ(log->id_, size - 1);
+      }
+    }
+  });
+
+  auto command = akit::failover::foros::Command::make_shared(
+      std::initializer_list<uint8_t>{kTestData});
+  for (uint64_t i = 0; i < kLogsSize; i++) {
+    auto log = akit::failover::foros::raft::LogEntry::make_shared(
+        i, kCurrentTerm, command);
+    EXPECT_EQ(store.push_log(log), true);
+  }
+  done = true;
+  reader.join();
+
+  EXPECT_EQ(store.logs_size(), kLogsSize);
+  EXPECT_EQ(store.log()->id_, kLogsSize - 1);
+}
+
+TEST_F(TestRaft, TestContextStoreRevertAcrossBlocks) {
+  const uint64_t kLogsSize = 3000;
+  const uint64_t kRevertId = 1500;
+  auto store = akit::failover::foros::raft::ContextStore(
+      std::make_unique<akit::failover::foros::raft::MemoryStorage>(), logger_);
+
+  auto command = akit::failover::foros::Command::make_shared(
+      std::initializer_list<uint8_t>{kTestData});
+  for (uint64_t i = 0; i < kLogsSize; i++) {
+    auto log = akit::failover::foros::raft::LogEntry::make_shared(
+        i, kCurrentTerm, command);
+    EXPECT_EQ(store.push_log(log), true);
+  }
+
+  // reverted logs are released once no reader holds them
+  std::weak_ptr<akit::failover::foros::raft::LogEntry> reverted =
+      store.log(kRevertId);
+  EXPECT_EQ(store.revert_log(kRevertId), true);
+  EXPECT_EQ(reverted.expired(), true);
+  EXPECT_EQ(store.logs_size(), kRevertId);
+  EXPECT_EQ(store.log(kRevertId), nullptr);
+  EXPECT_EQ(store.log(kRevertId - 1)->term_, kCurrentTerm);
+
+  for (uint64_t i = kRevertId; i < kLogsSize; i++) {
+    auto log = akit::failover::foros::raft::LogEntry::make_shared(
+        i, kCurrentTerm + 1, command);
+    EXPECT_EQ(store.push_log(log), true);
+  }
+  EXPECT_EQ(store.logs_size(), kLogsSize);
+  EXPECT_EQ(store.log(kRevertId - 1)->term_, kCurrentTerm);
+  EXPECT_EQ(store.log(kRevertId)->term_, kCurrentTerm + 1);
+  EXPECT_EQ(store.log()->id_, kLogsSize - 1);
+}
+
+TEST_F(TestRaft, TestContextStoreConcurrentRevert) {
+  const uint64_t kLogsSize = 3000;
+  const uint64_t kRevertInterval = 700;
+  auto store = akit::failover::foros::raft::ContextStore(
+      std::make_unique<akit::failover::foros::raft::MemoryStorage>(), logger_);
+
+  // readers keep reading while reverts replace the directory and blocks
+  std::atomic<bool> done(false);
+  std::thread reader([&]() {
+    while (done == false) {
+      auto size = store.logs_size();
+      if (size > 0) {
+        auto log = store.log(size - 1);
+        if (log != nullptr) {
+          EXPECT_LT(log->id_, kLogsSize);
+        }
+      }
+    }
+  });
+
+  auto command = akit::failover::foros::Command::make_shared(
+      std::initializer_list<uint8_t>{kTestData});
+  for (uint64_t i = 0; i < kLogsSize; i++) {
+    if (i > 0 && i % kRevertInterval == 0) {
+      EXPECT_EQ(store.revert_log(i - kRevertInterval / 2), true);
+      for (auto id = i - kRevertInterval / 2; id < i; id++) {
+        auto log = akit::failover::foros::raft::LogEntry::make_shared(
+            id, kCurrentTerm, command);
+        EXPECT_EQ(store.push_log(log), true);
+      }
+    }
+    auto log = akit::failover::foros::raft::LogEntry::make_shared(
+        i, kCurrentTerm, command);
+    EXPECT_EQ(store.push_log(log), true);
+  }
+  done = true;
+  reader.join();
+
+  EXPECT_EQ(store.logs_size(), kLogsSize);
+  EXPECT_EQ(store.log()->id_, kLogsSize - 1);
+}
+
+TEST_F(TestRaft, TestContextStoreReclaimWithActiveReaders) {
+  const uint64_t kLogsSize = 5000;
+  const uint64_t kRevertInterval = 500;
+  const int kReaders = 4;
+  auto store = akit::failover::foros::raft::ContextStore(
+      std::make_unique<akit::failover::foros::raft::MemoryStorage>(), logger_);
+
+  // some reader is active at almost any moment
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < kReaders; i++) {
+    readers.emplace_back([&]() {
+      while (done == false) {
+        auto size = store.logs_size();
+        if (size > 0) {
+          store.log(size - 1);
+        }
+      }
+    });
+  }
+
+  auto command = akit::failover::foros::Command::make_shared(
+      std::initializer_list<uint8_t>{kTestData});
+  uint64_t id = 0;
+  auto push = [&]() {
+    auto log = akit::failover::foros::raft::LogEntry::make_shared(
+        id++, kCurrentTerm, command);
+    EXPECT_EQ(store.push_log(log), true);
+  };
+  for (uint64_t i = 0; i < kLogsSize; i++) {
+    // each revert retires the directory and the blocks from the reverted id
+    if (i > 0 && i % kRevertInterval == 0) {
+      id = i - kRevertInterval / 2;
+      EXPECT_EQ(store.revert_log(id), true);
+      while (id < i) {
+        push();
+      }
+    }
+    push();
+  }
+
+  // the retired ones are freed while the readers are still active
+  for (uint64_t i = 0; i < kLogsSize &&
+                       store.retired_log_blocks_size() > 0;
+       i++) {
+    push();
+  }
+  EXPECT_EQ(store.retired_log_blocks_size(), (std::size_t)0);
+
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+}
+
+TEST_F(TestRaft, TestTermIndex) {
+  akit::failover::foros::raft::TermIndex index;
+  EXPECT_EQ(index.last_term(), (uint64_t)0);
+  EXPECT_EQ(index.append(0, 1), true);
+  EXPECT_EQ(index.append(1, 1), false);
+  EXPECT_EQ(index.append(2, 3), true);
+  EXPECT_EQ(index.append(3, 3), false);
+  EXPECT_EQ(index.append(4, 4), true);
+  EXPECT_EQ(index.runs().size(), (std::size_t)3);
+
+  EXPECT_EQ(index.term(0), (uint64_t)1);
+  EXPECT_EQ(index.term(1), (uint64_t)1);
+  EXPECT_EQ(index.term(3), (uint64_t)3);
+  EXPECT_EQ(index.term(4), (uint64_t)4);
+  EXPECT_EQ(index.term(5), (uint64_t)0);
+  EXPECT_EQ(index.last_term(), (uint64_t)4);
+
+  uint64_t id = 0;
+  EXPECT_EQ(index.first_id(3, id), true);
+  EXPECT_EQ(id, (uint64_t)2);
+  EXPECT_EQ(index.first_id(2, id), false);
+
+  EXPECT_EQ(index.truncate(3), true);
+  EXPECT_EQ(index.size(), (uint64_t)3);
+  EXPECT_EQ(index.term(3), (uint64_t)0);
+  EXPECT_EQ(index.last_term(), (uint64_t)3);
+  EXPECT_EQ(index.truncate(2), true);
+  EXPECT_EQ(index.last_term(), (uint64_t)1);
+}
+
+TEST_F(TestRaft, TestContextStoreTermIndex) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  auto command = akit::failover::foros::Command::make_shared(
+      std::initializer_list<uint8_t>{kTestData});
+  {
+    auto store =
+        akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+    for (uint64_t i = 0; i < kMaxCommitSize * 2; i++) {
+      auto log = akit::failover::foros::raft::LogEntry::make_shared(
+          i, kCurrentTerm + i / kMaxCommitSize, command);
+      EXPECT_EQ(store.push_log(log), true);
+    }
+    EXPECT_EQ(store.revert_log(kMaxCommitSize + 1), true);
+  }
+
+  auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+  EXPECT_EQ(store.logs_size(), kMaxCommitSize + 1);
+  EXPECT_EQ(store.log_term(0), kCurrentTerm);
+  EXPECT_EQ(store.log_term(kMaxCommitSize), kCurrentTerm + 1);
+  EXPECT_EQ(store.log_term(kMaxCommitSize + 1), (uint64_t)0);
+  EXPECT_EQ(store.last_log_term(), kCurrentTerm + 1);
+
+  uint64_t id = 0;
+  EXPECT_EQ(store.first_log_id(kCurrentTerm + 1, id), true);
+  EXPECT_EQ(id, kMaxCommitSize);
+}
+
+TEST_F(TestRaft, TestStorageWorker) {
+  const uint64_t kTasks = 100;
+  std::vector<uint64_t> order;
+  {
+    akit::failover::foros::raft::StorageWorker worker;
+    for (uint64_t i = 0; i < kTasks; i++) {
+      worker.post([&order, i]() { order.push_back(i); });
+    }
+    // a task waiting for another one on the worker thread runs it inline
+    EXPECT_EQ(worker.run([&]() {
+      return worker.run([&]() { return order.size() == kTasks; });
+    }),
+              true);
+    worker.post([&order, kTasks]() { order.push_back(kTasks); });
+  }
+
+  ASSERT_EQ(order.size(), kTasks + 1);
+  for (uint64_t i = 0; i <= kTasks; i++) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST_F(TestRaft, TestSessionTable) {
+  using akit::failover::foros::raft::SessionTable;
+  SessionTable table;
+  auto make_command = [&](const uint64_t session_id, const uint64_t sequence) {
+    auto command = akit::failover::foros::Command::make_shared(
+        std::initializer_list<uint8_t>{kTestData});
+    command->set_session(session_id, sequence);
+    return command;
+  };
+
+  uint64_t id = 0;
+  EXPECT_EQ(table.find(1, 1, id), SessionTable::SequenceState::kNew);
+  EXPECT_EQ(table.apply(0, make_command(1, 1)), true);
+  EXPECT_EQ(table.apply(1, make_command(1, 2)), true);
+  // a command not of a session is never a duplicate
+  EXPECT_EQ(table.apply(2, make_command(0, 0)), true);
+  // the same sequence committed again by another leader is a duplicate
+  EXPECT_EQ(table.apply(3, make_command(1, 2)), false);
+  // applying a log again is not a duplicate of itself
+  EXPECT_EQ(table.apply(1, make_command(1, 2)), true);
+
+  EXPECT_EQ(table.find(1, 2, id), SessionTable::SequenceState::kCommitted);
+  EXPECT_EQ(id, (uint64_t)1);
+  EXPECT_EQ(table.find(1, 1, id), SessionTable::SequenceState::kStale);
+  EXPECT_EQ(table.find(1, 3, id), SessionTable::SequenceState::kNew);
+
+  EXPECT_EQ(table.is_duplicate(1), false);
+  EXPECT_EQ(table.is_duplicate(3), true);
+  table.forget_duplicates(4);
+  EXPECT_EQ(table.is_duplicate(3), false);
+
+  // reverting the logs restores the sequence before them
+  table.revert(1);
+  EXPECT_EQ(table.find(1, 1, id), SessionTable::SequenceState::kCommitted);
+  EXPECT_EQ(id, (uint64_t)0);
+}
+
+TEST_F(TestRaft, TestKVStoreSnapshot) {
+  const std::string kSnapshotFile = "/tmp/foros_test_kv_snapshot";
+  const uint64_t kInterval = 2;
+  std::filesystem::remove(kSnapshotFile);
+
+  std::vector<uint64_t> acknowledged;
+  std::mutex acknowledged_mutex;
+  auto acknowledge = [&](uint64_t id) {
+    std::lock_guard<std::mutex> lock(acknowledged_mutex);
+    acknowledged.push_back(id);
+    return true;
+  };
+
+  {
+    akit::failover::foros::KVStore store(kNodeId, kSnapshotFile, kInterval,
+                                         acknowledge, logger_);
+    uint64_t request_id;
+    akit::failover::foros::KVResponseSharedFuture future;
+    for (uint64_t i = 0; i < kInterval * 2; i++) {
+      auto command = store.make_request(
+          akit::failover::foros::KVStore::Operation::kSet,
+          "key" + std::to_string(i), {}, {static_cast<uint8_t>(i)}, nullptr,
+          request_id, future);
+      EXPECT_EQ(command->type(),
+                akit::failover::foros::CommandType::kKeyValue);
+      store.apply(i, command);
+      EXPECT_EQ(future.get()->result(), true);
+
+      // an interval is skipped while the previous snapshot is written
+      while ((i + 1) % kInterval == 0 && store.snapshot_size() < i + 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+
+    // the same data committed by the application is not a request
+    auto command = store.make_request(
+        akit::failover::foros::KVStore::Operation::kSet, "other", {}, {1},
+        nullptr, request_id, future);
+    store.apply(kInterval * 2,
+                akit::failover::foros::Command::make_shared(command->buffer()));
+    std::vector<uint8_t> value;
+    EXPECT_EQ(store.get("other", value), false);
+    store.cancel_request(request_id, kInterval * 2);
+  }
+
+  // the snapshots are written by the worker before the store is destroyed
+  {
+    std::lock_guard<std::mutex> lock(acknowledged_mutex);
+    ASSERT_FALSE(acknowledged.empty());
+    EXPECT_EQ(acknowledged.back(), kInterval * 2);
+  }
+
+  akit::failover::foros::KVStore store(kNodeId, kSnapshotFile, kInterval,
+                                       acknowledge, logger_);
+  EXPECT_EQ(store.snapshot_size(), kInterval * 2);
+  for (uint64_t i = 0; i < kInterval * 2; i++) {
+    std::vector<uint8_t> value;
+    EXPECT_EQ(store.get("key" + std::to_string(i), value), true);
+    EXPECT_EQ(value, std::vector<uint8_t>({static_cast<uint8_t>(i)}));
+  }
+}
+
+TEST_F(TestRaft, TestKVStoreRevertBelowSnapshot) {
+  const std::string kSnapshotFile = "/tmp/foros_test_kv_snapshot";
+  const uint64_t kInterval = 2;
+  const uint64_t kRevertId = kInterval + 1;
+  std::filesystem::remove(kSnapshotFile);
+
+  akit::failover::foros::KVStore store(kNodeId, kSnapshotFile, kInterval,
+                                       nullptr, logger_);
+  std::vector<akit::failover::foros::KVChange> changes;
+  auto watch_id = store.add_watch(
+      "key", true,
+      [&](const std::vector<akit::failover::foros::KVChange> &watched) {
+        changes = watched;
+      },
+      nullptr);
+
+  std::vector<akit::failover::foros::Command::SharedPtr> commands;
+  for (uint64_t i = 0; i < kInterval * 4; i++) {
+    uint64_t request_id;
+    akit::failover::foros::KVResponseSharedFuture future;
+    commands.push_back(store.make_request(
+        akit::failover::foros::KVStore::Operation::kSet,
+        "key" + std::to_string(i), {}, {static_cast<uint8_t>(i)}, nullptr,
+        request_id, future));
+    store.apply(i, commands.back());
+    while ((i + 1) % kInterval == 0 && store.snapshot_size() < i + 1) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  store.flush_watch(watch_id);
+
+  // The changes of the earlier intervals are trimmed, so the map is rebuilt
+  // and the logs before the id are applied again, as the context does.
+  store.revert(kRevertId);
+  EXPECT_LT(store.applied_size(), kRevertId);
+  // the stored snapshot holds the reverted logs
+  EXPECT_EQ(store.snapshot_size(), (uint64_t)0);
+  EXPECT_EQ(std::filesystem::exists(kSnapshotFile), false);
+  for (auto id = store.applied_size(); id < kRevertId; id++) {
+    store.apply(id, commands[id]);
+  }
+  EXPECT_EQ(store.applied_size(), kRevertId);
+
+  for (uint64_t i = 0; i < kInterval * 4; i++) {
+    std::vector<uint8_t> value;
+    EXPECT_EQ(store.get("key" + std::to_string(i), value), i < kRevertId);
+    if (i < kRevertId) {
+      EXPECT_EQ(value, std::vector<uint8_t>({static_cast<uint8_t>(i)}));
+    }
+  }
+
+  // the watch ends up with the reverted keys deleted
+  store.flush_watch(watch_id);
+  EXPECT_EQ(changes.size(), kInterval * 4);
+  for (auto &change : changes) {
+    auto deleted = change.key >= "key" + std::to_string(kRevertId);
+    EXPECT_EQ(change.deleted, deleted);
+  }
+}
+
+TEST_F(TestRaft, TestContextStorePersistLog) {
+  auto store = akit::failover::foros::raft::ContextStore(
+      std::make_unique<akit::failover::foros::raft::MemoryStorage>(), logger_);
+
+  auto log = akit::failover::foros::raft::LogEntry::make_shared(
+      0, kCurrentTerm,
+      akit::failover::foros::Command::make_shared(
+          std::initializer_list<uint8_t>{kTestData}));
+  std::promise<bool> persisted;
+  store.persist_log(log, [&](bool result) { persisted.set_value(result); });
+  EXPECT_EQ(persisted.get_future().get(), true);
+
+  // a persisted log is not visible until it is appended
+  EXPECT_EQ(store.logs_size(), (uint64_t)0);
+  EXPECT_EQ(store.append_log(log), true);
+  EXPECT_EQ(store.logs_size(), (uint64_t)1);
+  EXPECT_EQ(store.append_log(log), false);
+}
+
+TEST_F(TestRaft, TestContextStorePushLogs) {
+  auto store = akit::failover::foros::raft::ContextStore(
+      std::make_unique<akit::failover::foros::raft::MemoryStorage>(), logger_);
+
+  std::vector<akit::failover::foros::raft::LogEntry::SharedPtr> logs;
+  for (uint64_t i = 0; i < 3; i++) {
+    logs.push_back(akit::failover::foros::raft::LogEntry::make_shared(
+        i, kCurrentTerm,
+        akit::failover::foros::Command::make_shared(
+            std::initializer_list<uint8_t>{kTestData})));
+  }
+
+  // logs of a batch must be consecutive
+  EXPECT_EQ(store.push_logs({}), false);
+  EXPECT_EQ(store.push_logs({logs[0], logs[2]}), false);
+  EXPECT_EQ(store.push_logs({logs[1], logs[2]}), false);
+  EXPECT_EQ(store.logs_size(), (uint64_t)0);
+
+  EXPECT_EQ(store.push_logs({logs[0], logs[1]}), true);
+  EXPECT_EQ(store.logs_size(), (uint64_t)2);
+  EXPECT_EQ(store.log(1), logs[1]);
+
+  std::promise<bool> persisted;
+  store.persist_logs({logs[2]},
+                     [&](bool result) { persisted.set_value(result); });
+  EXPECT_EQ(persisted.get_future().get(), true);
+  EXPECT_EQ(store.logs_size(), (uint64_t)2);
+  EXPECT_EQ(store.append_log(logs[2]), true);
+  EXPECT_EQ(store.logs_size(), (uint64_t)3);
+}
+
 TEST_F(TestRaft, TestContextStoreWithInvalidPath) {
   auto store =
       akit::failover::foros::raft::ContextStore(kInvalidStorePath, logger_);
@@ -226,8 +1541,8 @@ TEST_F(TestRaft, TestContextTermMethods) {
       kClusterName, kNodeId, node.get_node_base_interface(),
       node.get_node_graph_interface(), node.get_node_services_interface(),
       node.get_node_topics_interface(), node.get_node_timers_interface(),
-      node.get_node_clock_interface(), kElectionTimeoutMin, kElectionTimeoutMax,
-      kTempPath, logger_);
+      node.get_node_clock_interface(), node.get_node_waitables_interface(),
+      kElectionTimeoutMin, kElectionTimeoutMax, kTempPath, logger_);
 
   MockStateMachineInterface state_machine;
   ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(true));
@@ -289,6 +1604,253 @@ TEST_F(TestRaft, TestContextLeaderCommandCommit) {
   EXPECT_EQ(command->data()[0], kTestData);
 }
 
+TEST_F(TestRaft, TestContextLeaderCommandsCommit) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  auto context = TestContext(
+      kClusterName, kNodeId,
+      rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId)),
+      kElectionTimeoutMin, kElectionTimeoutMax, kTempPath, logger_);
+
+  MockStateMachineInterface state_machine;
+  ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(true));
+  context.initialize(kClusterIds, &state_machine);
+
+  testing::MockFunction<void(
+      akit::failover::foros::CommandCommitResponseSharedFuture)>
+      on_commit_response;
+  EXPECT_CALL(on_commit_response, Call(testing::_)).Times(3);
+
+  std::vector<akit::failover::foros::Command::SharedPtr> commands;
+  for (uint8_t i = 0; i < 3; i++) {
+    commands.push_back(akit::failover::foros::Command::make_shared(
+        std::initializer_list<uint8_t>{i}));
+  }
+
+  EXPECT_EQ(context.commit_commands({}, on_commit_response.AsStdFunction())
+                .empty(),
+            true);
+
+  auto futures =
+      context.commit_commands(commands, on_commit_response.AsStdFunction());
+  ASSERT_EQ(futures.size(), commands.size());
+  EXPECT_EQ(context.get_commands_size(), (uint64_t)3);
+
+  for (uint64_t i = 0; i < futures.size(); i++) {
+    auto response = futures[i].get();
+    EXPECT_EQ(response->result(), true);
+    EXPECT_EQ(response->id(), i);
+    EXPECT_EQ(context.get_command(i)->data()[0], i);
+  }
+}
+
+TEST_F(TestRaft, TestContextQueuedCommandCommit) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  auto context = TestContext(
+      kClusterName, kNodeId,
+      rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId)),
+      kElectionTimeoutMin, kElectionTimeoutMax, kTempPath, logger_);
+
+  MockStateMachineInterface state_machine;
+  ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(true));
+  context.initialize(kClusterIds, &state_machine);
+
+  auto queue = akit::failover::foros::CommitCompletionQueue::make_shared();
+  for (uint64_t tag = 10; tag < 13; tag++) {
+    if (tag == 12) {
+      ON_CALL(state_machine, is_leader())
+          .WillByDefault(testing::Return(false));
+    }
+    context.commit_command(akit::failover::foros::Command::make_shared(
+                               std::initializer_list<uint8_t>{kTestData}),
+                           tag, queue);
+  }
+
+  std::vector<akit::failover::foros::CommitCompletion> completions;
+  ASSERT_EQ(queue->drain(completions), (std::size_t)3);
+  for (uint64_t i = 0; i < completions.size(); i++) {
+    EXPECT_EQ(completions[i].tag, i + 10);
+    EXPECT_EQ(completions[i].id, i);
+    // the last one is committed after this node is no longer the leader
+    EXPECT_EQ(completions[i].result, i < 2);
+  }
+  EXPECT_EQ(context.get_commands_size(), (uint64_t)2);
+  EXPECT_EQ(queue->drain(completions), (std::size_t)0);
+}
+
+TEST_F(TestRaft, TestContextSessionCommandCommit) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  auto context = TestContext(
+      kClusterName, kNodeId,
+      rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId)),
+      kElectionTimeoutMin, kElectionTimeoutMax, kTempPath, logger_);
+
+  MockStateMachineInterface state_machine;
+  ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(true));
+  context.initialize(kClusterIds, &state_machine);
+
+  std::vector<uint64_t> committed_ids;
+  context.register_on_committed(
+      [&](const uint64_t id,
+          akit::failover::foros::Command::SharedPtr command) {
+        committed_ids.push_back(id);
+        // the session is carried beside the data of the command
+        EXPECT_NE(command->session_id(), (uint64_t)0);
+        ASSERT_FALSE(command->data().empty());
+        EXPECT_EQ(command->data()[0], kTestData);
+      });
+
+  const uint64_t kSessionId = 7;
+  auto commit = [&](const uint64_t session_id, const uint64_t sequence) {
+    return context
+        .commit_command(session_id, sequence,
+                        akit::failover::foros::Command::make_shared(
+                            std::initializer_list<uint8_t>{kTestData}),
+                        nullptr)
+        .get();
+  };
+
+  auto response = commit(kSessionId, 1);
+  EXPECT_EQ(response->result(), true);
+  EXPECT_EQ(response->id(), (uint64_t)0);
+  EXPECT_EQ(response->command()->data().size(), (std::size_t)1);
+
+  // a retry is answered without committing it again
+  response = commit(kSessionId, 1);
+  EXPECT_EQ(response->result(), true);
+  EXPECT_EQ(response->id(), (uint64_t)0);
+  EXPECT_EQ(context.get_commands_size(), (uint64_t)1);
+
+  response = commit(kSessionId, 2);
+  EXPECT_EQ(response->id(), (uint64_t)1);
+  response = commit(kSessionId + 1, 1);
+  EXPECT_EQ(response->id(), (uint64_t)2);
+  EXPECT_EQ(context.get_commands_size(), (uint64_t)3);
+  EXPECT_EQ(context.get_command(1)->data().size(), (std::size_t)1);
+  EXPECT_EQ(context.get_command(1)->session_id(), kSessionId);
+  EXPECT_EQ(context.get_command(1)->sequence(), (uint64_t)2);
+  EXPECT_EQ(committed_ids, std::vector<uint64_t>({0, 1, 2}));
+
+  // an older sequence than the latest one of the session is stale
+  response = commit(kSessionId, 1);
+  EXPECT_EQ(response->result(), false);
+  EXPECT_EQ(context.get_commands_size(), (uint64_t)3);
+
+  // the data of a large command is committed without copying it
+  auto buffer = std::make_shared<const std::vector<uint8_t>>(
+      akit::failover::foros::Command::kSmallDataSize * 2, kTestData);
+  response = context
+                 .commit_command(kSessionId, 3,
+                                 akit::failover::foros::Command::make_shared(
+                                     buffer),
+                                 nullptr)
+                 .get();
+  ASSERT_EQ(response->result(), true);
+  EXPECT_EQ(response->command()->view().data(), buffer->data());
+  EXPECT_EQ(context.get_command(response->id())->buffer(), buffer);
+
+  // not a leader, so the retry is not answered
+  ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(false));
+  EXPECT_EQ(commit(kSessionId, 2)->result(), false);
+}
+
+TEST_F(TestRaft, TestContextCommitForwarding) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  // the leader is a cluster of its own, so it commits without replication
+  auto leader_node =
+      rclcpp::Node::make_shared(kClusterName + std::to_string(kOtherNodeId));
+  akit::failover::foros::raft::Context leader(
+      kClusterName, kOtherNodeId, leader_node->get_node_base_interface(),
+      leader_node->get_node_graph_interface(),
+      leader_node->get_node_services_interface(),
+      leader_node->get_node_topics_interface(),
+      leader_node->get_node_timers_interface(),
+      leader_node->get_node_clock_interface(), kElectionTimeoutMin,
+      kElectionTimeoutMax, kTempPath, logger_,
+      akit::failover::foros::StorageType::kMemory,
+      akit::failover::foros::raft::EntryCodec(), 0, true);
+  MockStateMachineInterface leader_state_machine;
+  ON_CALL(leader_state_machine, is_leader())
+      .WillByDefault(testing::Return(true));
+  leader.initialize({kOtherNodeId}, &leader_state_machine);
+
+  auto node = rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId));
+  auto context = TestContext(kClusterName, kNodeId, node, kElectionTimeoutMin,
+                             kElectionTimeoutMax, kTempPath, logger_, true);
+  MockStateMachineInterface state_machine;
+  ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(false));
+  EXPECT_CALL(state_machine, on_leader_discovered()).Times(2);
+  context.initialize(kClusterIds2, &state_machine);
+
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(leader_node);
+  executor.add_node(node);
+
+  auto commit = [&]() {
+    auto future = context.commit_command(
+        akit::failover::foros::Command::make_shared(
+            std::initializer_list<uint8_t>{kTestData}),
+        nullptr);
+    executor.spin_until_future_complete(future, std::chrono::seconds(1));
+    return future.get();
+  };
+
+  // no leader is known yet
+  EXPECT_EQ(commit()->result(), false);
+
+  auto heartbeat = context.send_append_entries_to_me(
+      kCurrentTerm, kOtherNodeId, 0, 0, 0, std::vector<uint8_t>());
+  executor.spin_until_future_complete(heartbeat, std::chrono::seconds(1));
+
+  auto client = node->create_client<foros_msgs::srv::CommitCommand>(
+      akit::failover::foros::NodeUtil::get_service_name(
+          kClusterName, kOtherNodeId,
+          akit::failover::foros::NodeUtil::kCommitCommandServiceName));
+  ASSERT_EQ(client->wait_for_service(std::chrono::seconds(1)), true);
+
+  auto response = commit();
+  EXPECT_EQ(response->result(), true);
+  EXPECT_EQ(response->id(), (uint64_t)0);
+  ASSERT_NE(response->command(), nullptr);
+  EXPECT_EQ(response->command()->data()[0], kTestData);
+  EXPECT_EQ(leader.get_commands_size(), (uint64_t)1);
+  // the follower gets the command through the replication
+  EXPECT_EQ(context.get_commands_size(), (uint64_t)0);
+
+  // the term changes before the leader responds, which still commits it
+  auto future = context.commit_command(
+      akit::failover::foros::Command::make_shared(
+          std::initializer_list<uint8_t>{kTestData}),
+      nullptr);
+  heartbeat = context.send_append_entries_to_me(
+      kCurrentTerm + 1, kOtherNodeId, 0, 0, 0, std::vector<uint8_t>());
+  executor.spin_until_future_complete(heartbeat, std::chrono::seconds(1));
+  executor.spin_until_future_complete(future, std::chrono::seconds(1));
+  response = future.get();
+  EXPECT_EQ(response->result(), true);
+  EXPECT_EQ(response->id(), (uint64_t)1);
+  EXPECT_EQ(leader.get_commands_size(), (uint64_t)2);
+}
+
 TEST_F(TestRaft, TestContextNonLeaderCommandCommit) {
   try {
     std::filesystem::remove_all(kStorePath);
@@ -407,6 +1969,339 @@ TEST_F(TestRaft, TestContextAppendEntriesReceived) {
   }
 }
 
+TEST_F(TestRaft, TestContextBatchAppendEntriesReceived) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+  auto node = rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId));
+  auto context = TestContext(kClusterName, kNodeId, node, kElectionTimeoutMin,
+                             kElectionTimeoutMax, kTempPath, logger_);
+
+  MockStateMachineInterface state_machine;
+  ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(true));
+  context.initialize(kClusterIds2, &state_machine);
+
+  // three entries of 1, 2 and 1 bytes end at the leader commit
+  auto request = context.make_append_entries_request(
+      kCurrentTerm, kOtherNodeId, 2, 0, 0, {kTestData, 1, 2, kTestData});
+  context.set_entries_sizes(request, {1, 2, 1});
+  // the second entry is a key-value command
+  request->entries_headers = {0, 1, 0};
+  auto future = context.send_append_entries_to_me(request);
+  rclcpp::spin_until_future_complete(node, future, std::chrono::seconds(1));
+  EXPECT_EQ(future.get()->success, true);
+
+  ASSERT_EQ(context.get_commands_size(), (uint64_t)3);
+  EXPECT_EQ(context.get_command(0)->data(),
+            std::vector<uint8_t>({kTestData}));
+  EXPECT_EQ(context.get_command(1)->data(), std::vector<uint8_t>({1, 2}));
+  EXPECT_EQ(context.get_command(2)->data(),
+            std::vector<uint8_t>({kTestData}));
+  EXPECT_EQ(context.get_command(0)->type(),
+            akit::failover::foros::CommandType::kApplication);
+  EXPECT_EQ(context.get_command(1)->type(),
+            akit::failover::foros::CommandType::kKeyValue);
+
+  // headers which do not match the entries are rejected
+  request = context.make_append_entries_request(kCurrentTerm, kOtherNodeId, 4,
+                                                2, kCurrentTerm, {1, 2});
+  context.set_entries_sizes(request, {1, 1});
+  request->entries_headers = {1};
+  future = context.send_append_entries_to_me(request);
+  rclcpp::spin_until_future_complete(node, future, std::chrono::seconds(1));
+  EXPECT_EQ(future.get()->success, false);
+  EXPECT_EQ(context.get_commands_size(), (uint64_t)3);
+
+  // sizes which do not match the entries are rejected
+  request = context.make_append_entries_request(kCurrentTerm, kOtherNodeId, 4,
+                                                2, kCurrentTerm, {1, 2, 3});
+  context.set_entries_sizes(request, {1, 1});
+  future = context.send_append_entries_to_me(request);
+  rclcpp::spin_until_future_complete(node, future, std::chrono::seconds(1));
+  EXPECT_EQ(future.get()->success, false);
+  EXPECT_EQ(context.get_commands_size(), (uint64_t)3);
+}
+
+TEST_F(TestRaft, TestContextConflictingAppendEntriesInFlight) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+
+  {
+    auto node =
+        rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId));
+    auto context = TestContext(kClusterName, kNodeId, node,
+                               kElectionTimeoutMin, kElectionTimeoutMax,
+                               kTempPath, logger_);
+
+    MockStateMachineInterface state_machine;
+    ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(false));
+    context.initialize(kClusterIds2, &state_machine);
+
+    // the commit callback is called on the executor, not the storage thread
+    const auto executor_thread_id = std::this_thread::get_id();
+    context.register_on_committed(
+        [&](const uint64_t, akit::failover::foros::Command::SharedPtr) {
+          EXPECT_EQ(std::this_thread::get_id(), executor_thread_id);
+        });
+
+    // a new leader replaces the entry while the old one is being persisted
+    auto old_entry = context.send_append_entries_to_me(
+        kCurrentTerm, kOtherNodeId, 0, 0, 0, std::initializer_list<uint8_t>{1});
+    auto new_entry = context.send_append_entries_to_me(
+        kCurrentTerm + 1, kOtherNodeId, 0, 0, 0,
+        std::initializer_list<uint8_t>{2});
+    rclcpp::spin_until_future_complete(node, old_entry,
+                                       std::chrono::seconds(1));
+    rclcpp::spin_until_future_complete(node, new_entry,
+                                       std::chrono::seconds(1));
+    EXPECT_EQ(new_entry.get()->success, true);
+
+    ASSERT_EQ(context.get_commands_size(), (uint64_t)1);
+    EXPECT_EQ(context.get_command(0)->data()[0], 2);
+  }
+
+  // the storage holds the same entry as the memory did
+  auto store = akit::failover::foros::raft::ContextStore(kStorePath, logger_);
+  ASSERT_EQ(store.logs_size(), (uint64_t)1);
+  EXPECT_EQ(store.log(0)->term_, kCurrentTerm + 1);
+  EXPECT_EQ(store.log(0)->command_->data()[0], 2);
+}
+
+TEST_F(TestRaft, TestContextCommittedBatch) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+  auto node = rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId));
+  auto context = TestContext(kClusterName, kNodeId, node, kElectionTimeoutMin,
+                             kElectionTimeoutMax, kTempPath, logger_);
+
+  MockStateMachineInterface state_machine;
+  ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(true));
+  context.initialize(kClusterIds2, &state_machine);
+
+  // the entries of one request are passed to the callback at once
+  std::vector<std::pair<uint64_t, std::size_t>> batches;
+  context.register_on_committed_batch(
+      [&](const uint64_t first_id,
+          const std::vector<akit::failover::foros::Command::SharedPtr>&
+              commands) { batches.emplace_back(first_id, commands.size()); });
+  EXPECT_EQ(batches.size(), (std::size_t)0);
+
+  auto request = context.make_append_entries_request(
+      kCurrentTerm, kOtherNodeId, 2, 0, 0, {kTestData, 1, 2, kTestData});
+  context.set_entries_sizes(request, {1, 2, 1});
+  auto future = context.send_append_entries_to_me(request);
+  rclcpp::spin_until_future_complete(node, future, std::chrono::seconds(1));
+  EXPECT_EQ(future.get()->success, true);
+
+  ASSERT_EQ(batches.size(), (std::size_t)1);
+  EXPECT_EQ(batches[0], std::make_pair((uint64_t)0, (std::size_t)3));
+
+  // the commands which are not applied are replayed as one range
+  EXPECT_EQ(context.acknowledge_applied(0), true);
+  batches.clear();
+  context.register_on_committed_batch(
+      [&](const uint64_t first_id,
+          const std::vector<akit::failover::foros::Command::SharedPtr>&
+              commands) { batches.emplace_back(first_id, commands.size()); });
+  ASSERT_EQ(batches.size(), (std::size_t)1);
+  EXPECT_EQ(batches[0], std::make_pair((uint64_t)1, (std::size_t)2));
+}
+
+TEST_F(TestRaft, TestContextCallbackQueue) {
+  const std::size_t kCallbackQueueSize = 2;
+  const uint64_t kCommits = 5;
+
+  auto node = rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId));
+  akit::failover::foros::raft::Context context(
+      kClusterName, kNodeId, node->get_node_base_interface(),
+      node->get_node_graph_interface(), node->get_node_services_interface(),
+      node->get_node_topics_interface(), node->get_node_timers_interface(),
+      node->get_node_clock_interface(), node->get_node_waitables_interface(),
+      kElectionTimeoutMin, kElectionTimeoutMax, kTempPath, logger_,
+      akit::failover::foros::StorageType::kMemory,
+      akit::failover::foros::raft::EntryCodec(), kCallbackQueueSize);
+
+  MockStateMachineInterface state_machine;
+  ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(true));
+  context.initialize(kClusterIds, &state_machine);
+
+  // a slow callback is called in order on its own thread
+  std::vector<uint64_t> ids;
+  std::thread::id callback_thread;
+  std::promise<void> delivered;
+  context.register_on_committed(
+      [&](const uint64_t id, akit::failover::foros::Command::SharedPtr) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        callback_thread = std::this_thread::get_id();
+        ids.push_back(id);
+        if (id == kCommits - 1) {
+          delivered.set_value();
+        }
+      });
+
+  for (uint64_t i = 0; i < kCommits; i++) {
+    auto future =
+        context.commit_command(akit::failover::foros::Command::make_shared(
+                                   std::initializer_list<uint8_t>{kTestData}),
+                               nullptr);
+    EXPECT_EQ(future.get()->result(), true);
+  }
+
+  ASSERT_EQ(delivered.get_future().wait_for(std::chrono::seconds(1)),
+            std::future_status::ready);
+  EXPECT_EQ(ids, std::vector<uint64_t>({0, 1, 2, 3, 4}));
+  EXPECT_NE(callback_thread, std::this_thread::get_id());
+}
+
+TEST_F(TestRaft, TestContextCommittedReplay) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+  auto node = rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId));
+  auto context = TestContext(kClusterName, kNodeId, node, kElectionTimeoutMin,
+                             kElectionTimeoutMax, kTempPath, logger_);
+
+  MockStateMachineInterface state_machine;
+  ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(true));
+  EXPECT_CALL(state_machine, on_leader_discovered()).Times(3);
+  context.initialize(kClusterIds2, &state_machine);
+
+  for (uint64_t i = 0; i < 3; i++) {
+    auto future = context.send_append_entries_to_me(
+        kCurrentTerm, kOtherNodeId, i, i > 0 ? i - 1 : 0, kCurrentTerm,
+        std::initializer_list<uint8_t>{kTestData});
+    rclcpp::spin_until_future_complete(node, future, std::chrono::seconds(1));
+  }
+  ASSERT_EQ(context.get_commands_size(), (uint64_t)3);
+  EXPECT_EQ(context.acknowledge_applied(3), false);
+  EXPECT_EQ(context.acknowledge_applied(0), true);
+  EXPECT_EQ(context.get_applied_commands_size(), (uint64_t)1);
+
+  // only the commands which are not applied are replayed
+  testing::MockFunction<void(const uint64_t,
+                             akit::failover::foros::Command::SharedPtr)>
+      on_committed_callback;
+  EXPECT_CALL(on_committed_callback, Call(0, testing::_)).Times(0);
+  EXPECT_CALL(on_committed_callback, Call(1, testing::_)).Times(1);
+  EXPECT_CALL(on_committed_callback, Call(2, testing::_)).Times(1);
+  context.register_on_committed(on_committed_callback.AsStdFunction());
+}
+
+TEST_F(TestRaft, TestContextDeltaAppendEntriesReceived) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+  auto node = rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId));
+  auto context = TestContext(kClusterName, kNodeId, node, kElectionTimeoutMin,
+                             kElectionTimeoutMax, kTempPath, logger_);
+
+  MockStateMachineInterface state_machine;
+  ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(true));
+  EXPECT_CALL(state_machine, on_leader_discovered()).Times(3);
+  context.initialize(kClusterIds2, &state_machine);
+
+  const std::vector<uint8_t> kBase = {'s', 'e', 'q', '=', '1', ';', 'o', 'k'};
+  const std::vector<uint8_t> kData = {'s', 'e', 'q', '=', '2', ';', 'o', 'k'};
+  auto future = context.send_append_entries_to_me(
+      kCurrentTerm, kOtherNodeId, 0, 0, kCurrentTerm, kBase);
+  rclcpp::spin_until_future_complete(node, future, std::chrono::seconds(1));
+
+  // the checksum covers the entries before encoding
+  auto request = context.make_append_entries_request(kCurrentTerm, kOtherNodeId,
+                                                     1, 0, kCurrentTerm, kData);
+  request->entries.clear();
+  ASSERT_TRUE(akit::failover::foros::DeltaCodec::encode(kBase, kData,
+                                                        request->entries));
+  request->entries_encoding =
+      foros_msgs::srv::AppendEntries::Request::ENCODING_DELTA;
+  future = context.send_append_entries_to_me(request);
+  rclcpp::spin_until_future_complete(node, future, std::chrono::seconds(1));
+
+  EXPECT_EQ(future.get()->success, true);
+  auto command = context.get_command(1);
+  ASSERT_NE(command, nullptr);
+  EXPECT_EQ(command->data(), kData);
+
+  // each entry of a batch is a delta against the previous one
+  const std::vector<uint8_t> kNextData = {'s', 'e', 'q', '=',
+                                          '3', ';', 'o', 'k'};
+  std::vector<uint8_t> entries = kData;
+  entries.insert(entries.end(), kNextData.begin(), kNextData.end());
+  request = context.make_append_entries_request(kCurrentTerm, kOtherNodeId, 3,
+                                                1, kCurrentTerm, entries);
+  request->entries.clear();
+  std::vector<uint8_t> delta;
+  for (auto [base, data] : {std::make_pair(kData, kData),
+                            std::make_pair(kData, kNextData)}) {
+    ASSERT_TRUE(akit::failover::foros::DeltaCodec::encode(base, data, delta));
+    request->entries.insert(request->entries.end(), delta.begin(),
+                            delta.end());
+    request->entries_sizes.push_back(delta.size());
+    request->entries_crcs.push_back(
+        akit::failover::foros::CRC32C::value(data.data(), data.size()));
+    request->entries_encodings.push_back(
+        foros_msgs::srv::AppendEntries::Request::ENCODING_DELTA);
+  }
+  future = context.send_append_entries_to_me(request);
+  rclcpp::spin_until_future_complete(node, future, std::chrono::seconds(1));
+
+  EXPECT_EQ(future.get()->success, true);
+  ASSERT_EQ(context.get_commands_size(), (uint64_t)4);
+  EXPECT_EQ(context.get_command(2)->data(), kData);
+  EXPECT_EQ(context.get_command(3)->data(), kNextData);
+}
+
+TEST_F(TestRaft, TestContextCorruptedAppendEntriesReceived) {
+  try {
+    std::filesystem::remove_all(kStorePath);
+  } catch (const std::filesystem::filesystem_error& err) {
+    RCLCPP_ERROR(logger_, "failed to remove file %s", err.what());
+  }
+  auto node = rclcpp::Node::make_shared(kClusterName + std::to_string(kNodeId));
+  auto context = TestContext(kClusterName, kNodeId, node, kElectionTimeoutMin,
+                             kElectionTimeoutMax, kTempPath, logger_);
+
+  MockStateMachineInterface state_machine;
+  ON_CALL(state_machine, is_leader()).WillByDefault(testing::Return(true));
+  EXPECT_CALL(state_machine, on_leader_discovered()).Times(2);
+  context.initialize(kClusterIds2, &state_machine);
+
+  auto request = context.make_append_entries_request(
+      kCurrentTerm, kOtherNodeId, 0, 0, kCurrentTerm,
+      std::initializer_list<uint8_t>{kTestData});
+  request->entries[0] = ~kTestData;
+  auto future = context.send_append_entries_to_me(request);
+  rclcpp::spin_until_future_complete(node, future, std::chrono::seconds(1));
+
+  EXPECT_EQ(future.get()->success, false);
+  EXPECT_EQ(future.get()->corrupted, true);
+  EXPECT_EQ(context.get_command(0), nullptr);
+
+  // each entry of a batch has its own checksum
+  request = context.make_append_entries_request(
+      kCurrentTerm, kOtherNodeId, 1, 0, kCurrentTerm, {kTestData, kTestData});
+  context.set_entries_sizes(request, {1, 1});
+  request->entries_crcs[1] = ~request->entries_crcs[1];
+  future = context.send_append_entries_to_me(request);
+  rclcpp::spin_until_future_complete(node, future, std::chrono::seconds(1));
+
+  EXPECT_EQ(future.get()->success, false);
+  EXPECT_EQ(future.get()->corrupted, true);
+  EXPECT_EQ(context.get_command(0), nullptr);
+}
+
 TEST_F(TestRaft, TestContextInvalidAppendEntriesReceived) {
   try {
     std::filesystem::remove_all(kStorePath);
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2021 42dot All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <coroutine>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "akit/failover/foros/cluster_node.hpp"
+#include "akit/failover/foros/cluster_node_options.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+// A coroutine which starts at once and is not awaited by anyone.
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+DetachedTask commit_commands(akit::failover::foros::ClusterNode::SharedPtr node,
+                             rclcpp::Logger logger) {
+  for (unsigned char ch = 'a'; ch <= 'z'; ch++) {
+    // each commit waits for the previous one without blocking the executor
+    auto response = co_await node->commit(
+        akit::failover::foros::Command::make_shared(
+            std::initializer_list<uint8_t>{ch}));
+    if (response->result() == false) {
+      RCLCPP_ERROR(logger, "commit failed: %lu %c", response->id(), ch);
+      co_return;
+    }
+    RCLCPP_INFO(logger, "commit completed: %lu %c", response->id(), ch);
+  }
+}
+
+int main(int argc, char **argv) {
+  const std::string kClusterName = "test_cluster_log";
+
+  rclcpp::Logger logger = rclcpp::get_logger(argv[0]);
+  logger.set_level(rclcpp::Logger::Level::Info);
+
+  if (argc < 3) {
+    RCLCPP_ERROR(logger, "Usage : %s {node ID} {size of cluster}", argv[0]);
+    return -1;
+  }
+
+  uint32_t id = std::stoul(argv[1]);
+  uint32_t cluster_size = std::stoul(argv[2]);
+  std::vector<uint32_t> cluster_node_ids;
+
+  if (id >= cluster_size) {
+    RCLCPP_ERROR(logger, "ID must be less than cluster size");
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < cluster_size; i++) {
+    cluster_node_ids.push_back(i);
+  }
+
+  rclcpp::init(argc, argv);
+
+  auto options = akit::failover::foros::ClusterNodeOptions();
+  options.election_timeout_max(2000);
+  options.election_timeout_min(1500);
+
+  auto node = akit::failover::foros::ClusterNode::make_shared(
+      kClusterName, id, cluster_node_ids, options);
+
+  node->register_on_activated([&]() {
+    RCLCPP_INFO(logger, "activated");
+    commit_commands(node, logger);
+  });
+  node->register_on_deactivated([&]() { RCLCPP_INFO(logger, "deactivated"); });
+  node->register_on_standby([&]() { RCLCPP_INFO(logger, "standby"); });
+
+  rclcpp::spin(node->get_node_base_interface());
+  rclcpp::shutdown();
+
+  return 0;
+}